@@ -18,7 +18,7 @@
 /* Do not hardcode the library location */
 #cmakedefine ENABLE_RELOCATABLE 1
 
-/* Use zlib instead of builtin zlib decoder. */
+/* Build the zlib based Flate decoder. */
 #cmakedefine ENABLE_ZLIB 1
 
 /* Use cairo for rendering. */
@@ -76,6 +76,9 @@
 /* Define to 1 if you have the `mkstemps' function. */
 #cmakedefine HAVE_MKSTEMPS 1
 
+/* Define to 1 if you have the `mmap' function. */
+#cmakedefine HAVE_MMAP 1
+
 /* Define to 1 if you have the <ndir.h> header file, and it defines `DIR'. */
 #cmakedefine HAVE_NDIR_H 1
 
@@ -85,6 +88,9 @@
 /* Define to 1 if you have the `popen' function. */
 #cmakedefine HAVE_POPEN 1
 
+/* Define to 1 if you have the `pread' function. */
+#cmakedefine HAVE_PREAD 1
+
 /* Define if you have POSIX threads libraries and header files. */
 #cmakedefine HAVE_PTHREAD 1
 
@@ -0,0 +1,96 @@
+//========================================================================
+//
+// GooArena.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "gmem.h"
+#include "GooArena.h"
+
+// block header size, rounded up to keep allocations aligned
+#define blockHeaderSize ((sizeof(Block) + 7) & ~(size_t)7)
+
+GooArena::GooArena(int blockSizeA) {
+  blockSize = blockSizeA;
+  blocks = cur = bigBlocks = NULL;
+  next = end = NULL;
+}
+
+GooArena::~GooArena() {
+  Block *b;
+
+  reset();
+  while ((b = blocks)) {
+    blocks = b->next;
+    gfree(b);
+  }
+}
+
+void *GooArena::allocSlow(size_t size) {
+  Block *b;
+  char *p;
+
+  // requests bigger than a quarter block get their own block
+  if (size > (size_t)blockSize / 4) {
+    b = (Block *)gmalloc(blockHeaderSize + size);
+    b->size = size;
+    b->next = bigBlocks;
+    bigBlocks = b;
+    return (char *)b + blockHeaderSize;
+  }
+
+  // move on to the next block, allocating one if needed; blocks kept
+  // by reset() are reused in order
+  if (cur && cur->next) {
+    cur = cur->next;
+  } else {
+    b = (Block *)gmalloc(blockHeaderSize + blockSize);
+    b->size = blockSize;
+    b->next = NULL;
+    if (cur) {
+      cur->next = b;
+    } else {
+      blocks = b;
+    }
+    cur = b;
+  }
+  p = (char *)cur + blockHeaderSize;
+  next = p + size;
+  end = p + cur->size;
+  return p;
+}
+
+char *GooArena::copyString(const char *s) {
+  size_t n;
+  char *p;
+
+  n = strlen(s) + 1;
+  p = (char *)alloc(n);
+  memcpy(p, s, n);
+  return p;
+}
+
+void GooArena::reset() {
+  Block *b;
+
+  while ((b = bigBlocks)) {
+    bigBlocks = b->next;
+    gfree(b);
+  }
+  cur = blocks;
+  if (cur) {
+    next = (char *)cur + blockHeaderSize;
+    end = next + cur->size;
+  } else {
+    next = end = NULL;
+  }
+}
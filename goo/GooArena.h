@@ -0,0 +1,71 @@
+//========================================================================
+//
+// GooArena.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef GOOARENA_H
+#define GOOARENA_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+#include "gtypes.h"
+
+//------------------------------------------------------------------------
+// GooArena
+//
+// A bump allocator for short-lived data.  Memory is handed out from
+// large blocks and is only given back all at once, by reset(), which
+// keeps the blocks for reuse.  Nothing allocated from an arena may be
+// passed to gfree() or delete.
+//------------------------------------------------------------------------
+
+class GooArena {
+public:
+
+  GooArena(int blockSizeA = 4096);
+  ~GooArena();
+
+  // Allocate <size> bytes, aligned for any basic type.
+  void *alloc(size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (size <= (size_t)(end - next)) {
+      void *p = next;
+      next += size;
+      return p;
+    }
+    return allocSlow(size);
+  }
+
+  // Copy a NUL-terminated string into the arena.
+  char *copyString(const char *s);
+
+  // Release everything allocated so far.
+  void reset();
+
+private:
+
+  GooArena(const GooArena &);	// not allowed
+  GooArena &operator=(const GooArena &);
+
+  struct Block {
+    Block *next;
+    size_t size;		// usable bytes after the header
+  };
+
+  void *allocSlow(size_t size);
+
+  Block *blocks;		// blocks of blockSize, the current one first
+  Block *cur;			// block that <next> points into
+  Block *bigBlocks;		// oversized allocations, freed by reset()
+  char *next;			// next free byte in cur
+  char *end;			// end of cur
+  int blockSize;
+};
+
+#endif
@@ -35,6 +35,10 @@
 // gUnlockMutex(&m);
 // ...
 // gDestroyMutex(&m);
+//
+// Mutexes are recursive: a thread that already owns <m> may lock it
+// again (it must unlock it the same number of times).  MutexLocker
+// locks a mutex for the lifetime of a scope.
 
 #ifdef _WIN32
 
@@ -53,11 +57,29 @@ typedef CRITICAL_SECTION GooMutex;
 
 typedef pthread_mutex_t GooMutex;
 
-#define gInitMutex(m) pthread_mutex_init(m, NULL)
+#define gInitMutex(m) { \
+    pthread_mutexattr_t mutexattr; \
+    pthread_mutexattr_init(&mutexattr); \
+    pthread_mutexattr_settype(&mutexattr, PTHREAD_MUTEX_RECURSIVE); \
+    pthread_mutex_init(m, &mutexattr); \
+    pthread_mutexattr_destroy(&mutexattr); \
+  }
 #define gDestroyMutex(m) pthread_mutex_destroy(m)
 #define gLockMutex(m) pthread_mutex_lock(m)
 #define gUnlockMutex(m) pthread_mutex_unlock(m)
 
 #endif
 
+class MutexLocker {
+public:
+  MutexLocker(GooMutex *mutexA) : mutex(mutexA) { gLockMutex(mutex); }
+  ~MutexLocker() { gUnlockMutex(mutex); }
+
+private:
+  MutexLocker(const MutexLocker &);
+  MutexLocker &operator=(const MutexLocker &);
+
+  GooMutex *mutex;
+};
+
 #endif
@@ -0,0 +1,96 @@
+//========================================================================
+//
+// GooThread.h
+//
+// Portable thread macros.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef GOOTHREAD_H
+#define GOOTHREAD_H
+
+// Usage:
+//
+// static GooThreadResult GOO_THREAD_CALL run(void *data) {
+//   ...
+//   return 0;
+// }
+// ...
+// GooThread t;
+// if (gCreateThread(&t, &run, data)) {
+//   ...
+//   gJoinThread(t);
+// }
+//
+// gGetNumProcessors() returns the number of processors that are
+// online (at least 1).
+//
+// GooCond is a condition variable, used with a GooMutex that is locked
+// once: gWaitCond(c, m) unlocks <m>, waits until the condition is
+// signaled, and locks <m> again.
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+typedef HANDLE GooThread;
+typedef DWORD GooThreadResult;
+
+#define GOO_THREAD_CALL WINAPI
+
+#define gCreateThread(t, func, data) \
+  ((*(t) = CreateThread(NULL, 0, func, data, 0, NULL)) != NULL)
+#define gJoinThread(t) \
+  { WaitForSingleObject(t, INFINITE); CloseHandle(t); }
+
+typedef CONDITION_VARIABLE GooCond;
+
+#define gInitCond(c) InitializeConditionVariable(c)
+#define gDestroyCond(c)
+#define gWaitCond(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define gSignalCond(c) WakeConditionVariable(c)
+#define gBroadcastCond(c) WakeAllConditionVariable(c)
+
+static inline int gGetNumProcessors() {
+  SYSTEM_INFO info;
+
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+#else // assume pthreads
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t GooThread;
+typedef void *GooThreadResult;
+
+#define GOO_THREAD_CALL
+
+#define gCreateThread(t, func, data) \
+  (pthread_create(t, NULL, func, data) == 0)
+#define gJoinThread(t) pthread_join(t, NULL)
+
+typedef pthread_cond_t GooCond;
+
+#define gInitCond(c) pthread_cond_init(c, NULL)
+#define gDestroyCond(c) pthread_cond_destroy(c)
+#define gWaitCond(c, m) pthread_cond_wait(c, m)
+#define gSignalCond(c) pthread_cond_signal(c)
+#define gBroadcastCond(c) pthread_cond_broadcast(c)
+
+static inline int gGetNumProcessors() {
+#ifdef _SC_NPROCESSORS_ONLN
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#else
+  return 1;
+#endif
+}
+
+#endif
+
+#endif
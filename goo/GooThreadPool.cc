@@ -0,0 +1,162 @@
+//========================================================================
+//
+// GooThreadPool.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#if MULTITHREADED
+
+#include "gmem.h"
+#include "GooThreadPool.h"
+
+//------------------------------------------------------------------------
+
+struct GooThreadPoolJob {
+  void (*func)(void *data, int task);
+  void *data;
+  int nTasks;
+  int nextTask;			// next task to start
+  int nDone;			// number of tasks finished
+  int maxWorkers;		// most workers that may help
+  int nWorkers;			// workers currently helping
+  GooThreadPoolJob *next;
+};
+
+//------------------------------------------------------------------------
+// GooThreadPool
+//------------------------------------------------------------------------
+
+GooThreadPool::GooThreadPool(int maxThreadsA) {
+  maxThreads = maxThreadsA > 1 ? maxThreadsA : 1;
+  threads = (GooThread *)gmallocn(maxThreads, sizeof(GooThread));
+  nThreads = 0;
+  jobs = NULL;
+  shutdown = gFalse;
+  gInitMutex(&mutex);
+  gInitCond(&workCond);
+  gInitCond(&doneCond);
+}
+
+GooThreadPool::~GooThreadPool() {
+  int i;
+
+  gLockMutex(&mutex);
+  shutdown = gTrue;
+  gBroadcastCond(&workCond);
+  gUnlockMutex(&mutex);
+  for (i = 0; i < nThreads; ++i) {
+    gJoinThread(threads[i]);
+  }
+  gfree(threads);
+  gDestroyCond(&doneCond);
+  gDestroyCond(&workCond);
+  gDestroyMutex(&mutex);
+}
+
+void GooThreadPool::run(void (*func)(void *data, int task), void *data,
+			int nTasks, int nThreadsA) {
+  GooThreadPoolJob job, **p;
+
+  if (nTasks <= 0) {
+    return;
+  }
+  if (nThreadsA > maxThreads) {
+    nThreadsA = maxThreads;
+  }
+  if (nThreadsA > nTasks) {
+    nThreadsA = nTasks;
+  }
+  job.func = func;
+  job.data = data;
+  job.nTasks = nTasks;
+  job.nextTask = 0;
+  job.nDone = 0;
+  job.maxWorkers = nThreadsA - 1;
+  job.nWorkers = 0;
+  job.next = NULL;
+
+  gLockMutex(&mutex);
+
+  // start the workers this job can use, if they aren't running yet
+  while (nThreads < job.maxWorkers &&
+	 gCreateThread(&threads[nThreads], &workerMain, this)) {
+    ++nThreads;
+  }
+
+  // queue the job, and work on it
+  if (job.maxWorkers > 0) {
+    for (p = &jobs; *p; p = &(*p)->next) ;
+    *p = &job;
+    gBroadcastCond(&workCond);
+  }
+  runTasks(&job);
+
+  // wait for the workers still running tasks of the job
+  while (job.nDone < job.nTasks || job.nWorkers > 0) {
+    gWaitCond(&doneCond, &mutex);
+  }
+  if (job.maxWorkers > 0) {
+    for (p = &jobs; *p != &job; p = &(*p)->next) ;
+    *p = job.next;
+  }
+
+  gUnlockMutex(&mutex);
+}
+
+// Return the oldest job that has tasks left to start and can take one
+// more worker, or NULL.  Callers must hold the lock.
+GooThreadPoolJob *GooThreadPool::findJob() {
+  GooThreadPoolJob *job;
+
+  for (job = jobs; job; job = job->next) {
+    if (job->nextTask < job->nTasks && job->nWorkers < job->maxWorkers) {
+      return job;
+    }
+  }
+  return NULL;
+}
+
+// Run tasks of <job> until none is left to start.  Callers must hold
+// the lock, which is released while the tasks run.
+void GooThreadPool::runTasks(GooThreadPoolJob *job) {
+  int i;
+
+  while (job->nextTask < job->nTasks) {
+    i = job->nextTask++;
+    gUnlockMutex(&mutex);
+    (*job->func)(job->data, i);
+    gLockMutex(&mutex);
+    ++job->nDone;
+  }
+}
+
+GooThreadResult GOO_THREAD_CALL GooThreadPool::workerMain(void *data) {
+  GooThreadPool *pool;
+  GooThreadPoolJob *job;
+
+  pool = (GooThreadPool *)data;
+  gLockMutex(&pool->mutex);
+  while (!pool->shutdown) {
+    if (!(job = pool->findJob())) {
+      gWaitCond(&pool->workCond, &pool->mutex);
+      continue;
+    }
+    ++job->nWorkers;
+    pool->runTasks(job);
+    if (--job->nWorkers == 0 && job->nDone == job->nTasks) {
+      gBroadcastCond(&pool->doneCond);
+    }
+  }
+  gUnlockMutex(&pool->mutex);
+  return 0;
+}
+
+#endif
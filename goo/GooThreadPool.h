@@ -0,0 +1,63 @@
+//========================================================================
+//
+// GooThreadPool.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef GOOTHREADPOOL_H
+#define GOOTHREADPOOL_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "gtypes.h"
+#include "GooMutex.h"
+#include "GooThread.h"
+
+struct GooThreadPoolJob;
+
+//------------------------------------------------------------------------
+// GooThreadPool
+//
+// A set of worker threads shared by the jobs of several callers.  A job
+// is a number of independent tasks; the thread that runs it works on
+// its tasks too, helped by up to <maxThreads> - 1 workers.  Workers are
+// started when first needed, wait for work between jobs, and are only
+// stopped when the pool is deleted.
+//------------------------------------------------------------------------
+
+class GooThreadPool {
+public:
+
+  GooThreadPool(int maxThreadsA);
+  ~GooThreadPool();
+
+  // Call func(data, i) for each i in [0, nTasks), in any order and
+  // from up to <nThreads> threads (including the calling one, and at
+  // most maxThreads), and return when all the calls have returned.
+  void run(void (*func)(void *data, int task), void *data, int nTasks,
+	   int nThreads);
+
+  int getMaxThreads() { return maxThreads; }
+
+private:
+
+  GooThreadPoolJob *findJob();
+  void runTasks(GooThreadPoolJob *job);
+  static GooThreadResult GOO_THREAD_CALL workerMain(void *data);
+
+  int maxThreads;
+  GooThread *threads;		// workers
+  int nThreads;			// number of workers started
+  GooThreadPoolJob *jobs;	// running jobs
+  GBool shutdown;
+  GooMutex mutex;
+  GooCond workCond;		// signaled when a job is added, or when
+				//   the pool is deleted
+  GooCond doneCond;		// signaled when a job is finished
+};
+
+#endif
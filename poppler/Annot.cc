@@ -65,6 +65,12 @@
 #include "Link.h"
 #include <string.h>
 
+#if MULTITHREADED
+#  define annotLocker()   MutexLocker locker(&mutex)
+#else
+#  define annotLocker()
+#endif
+
 #define fieldFlagReadOnly           0x00000001
 #define fieldFlagRequired           0x00000002
 #define fieldFlagNoExport           0x00000004
@@ -1135,6 +1141,9 @@ Annot::Annot(PDFDoc *docA, Dict *dict, Object *obj) {
 void Annot::initialize(PDFDoc *docA, Dict *dict) {
   Object apObj, asObj, obj1, obj2;
 
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
   ok = gTrue;
   doc = docA;
   xref = doc->getXRef();
@@ -1500,11 +1509,21 @@ void Annot::removeReferencedObjects() {
 }
 
 void Annot::incRefCnt() {
+  annotLocker();
   refCnt++;
 }
 
 void Annot::decRefCnt() {
-  if (--refCnt == 0)
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done)
     delete this;
 }
 
@@ -1536,6 +1555,9 @@ Annot::~Annot() {
     delete color;
 
   oc.free();
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
 }
 
 void Annot::setColor(AnnotColor *color, GBool fill) {
@@ -1728,6 +1750,7 @@ GBool Annot::isVisible(GBool printing) {
 void Annot::draw(Gfx *gfx, GBool printing) {
   Object obj;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -2342,6 +2365,7 @@ void AnnotText::draw(Gfx *gfx, GBool printing) {
   Object obj;
   double ca = 1;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -2491,6 +2515,7 @@ void AnnotLink::initialize(PDFDoc *docA, Dict *dict) {
 void AnnotLink::draw(Gfx *gfx, GBool printing) {
   Object obj;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -2920,6 +2945,7 @@ void AnnotFreeText::generateFreeTextAppearance()
 void AnnotFreeText::draw(Gfx *gfx, GBool printing) {
   Object obj;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -3392,6 +3418,7 @@ void AnnotLine::generateLineAppearance()
 void AnnotLine::draw(Gfx *gfx, GBool printing) {
   Object obj;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -3557,6 +3584,7 @@ void AnnotTextMarkup::draw(Gfx *gfx, GBool printing) {
   int i;
   Object obj1, obj2;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -4886,6 +4914,7 @@ void AnnotWidget::generateFieldAppearance() {
 void AnnotWidget::draw(Gfx *gfx, GBool printing) {
   Object obj;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -5002,6 +5031,7 @@ void AnnotMovie::initialize(PDFDoc *docA, Dict* dict) {
 void AnnotMovie::draw(Gfx *gfx, GBool printing) {
   Object obj;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -5303,6 +5333,7 @@ void AnnotGeometry::draw(Gfx *gfx, GBool printing) {
   Object obj;
   double ca = 1;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -5624,6 +5655,7 @@ void AnnotPolygon::draw(Gfx *gfx, GBool printing) {
   Object obj;
   double ca = 1;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -5861,6 +5893,7 @@ void AnnotInk::draw(Gfx *gfx, GBool printing) {
   Object obj;
   double ca = 1;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -6093,6 +6126,7 @@ void AnnotFileAttachment::draw(Gfx *gfx, GBool printing) {
   Object obj;
   double ca = 1;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
@@ -6259,6 +6293,7 @@ void AnnotSound::draw(Gfx *gfx, GBool printing) {
   Object obj;
   double ca = 1;
 
+  annotLocker();
   if (!isVisible (printing))
     return;
 
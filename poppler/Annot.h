@@ -36,8 +36,13 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
 #include "Object.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class XRef;
 class Gfx;
 class CharCodeToUnicode;
@@ -643,6 +648,9 @@ protected:
   GBool ok;
 
   bool hasRef;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
 };
 
 //------------------------------------------------------------------------
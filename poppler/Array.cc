@@ -29,7 +29,9 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include "goo/gmem.h"
+#include "goo/GooArena.h"
 #include "Object.h"
 #include "Array.h"
 
@@ -37,11 +39,25 @@
 // Array
 //------------------------------------------------------------------------
 
-Array::Array(XRef *xrefA) {
+#if MULTITHREADED
+#  define arrayLocker()   MutexLocker locker(&mutex)
+#else
+#  define arrayLocker()
+#endif
+
+// arrays stored in an arena move to the heap when they grow bigger
+// than this
+#define maxArenaElems 1024
+
+Array::Array(XRef *xrefA, GooArena *arenaA) {
   xref = xrefA;
+  arena = arenaA;
   elems = NULL;
   size = length = 0;
   ref = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 }
 
 Array::~Array() {
@@ -49,23 +65,69 @@ Array::~Array() {
 
   for (i = 0; i < length; ++i)
     elems[i].free();
-  gfree(elems);
+  if (!arena) {
+    gfree(elems);
+  }
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+int Array::incRef() {
+  arrayLocker();
+  return ++ref;
+}
+
+int Array::decRef() {
+  arrayLocker();
+  return --ref;
+}
+
+Array *Array::copy() {
+  Array *a;
+  Object obj;
+  int i;
+
+  a = new Array(xref);
+  for (i = 0; i < length; ++i) {
+    a->add(elems[i].copy(&obj));
+  }
+  return a;
 }
 
 void Array::add(Object *elem) {
+  Object *newElems;
+
+  arrayLocker();
   if (length == size) {
     if (length == 0) {
       size = 8;
     } else {
       size *= 2;
     }
-    elems = (Object *)greallocn(elems, size, sizeof(Object));
+    if (arena) {
+      // the old elements are left behind in the arena; large arrays
+      // move to the heap
+      if (size <= maxArenaElems) {
+	newElems = (Object *)arena->alloc(size * sizeof(Object));
+      } else {
+	newElems = (Object *)gmallocn(size, sizeof(Object));
+	arena = NULL;
+      }
+      if (length > 0) {
+	memcpy(newElems, elems, length * sizeof(Object));
+      }
+      elems = newElems;
+    } else {
+      elems = (Object *)greallocn(elems, size, sizeof(Object));
+    }
   }
   elems[length] = *elem;
   ++length;
 }
 
 void Array::remove(int i) {
+  arrayLocker();
   if (i < 0 || i >= length) {
 #ifdef DEBUG_MEM
     abort();
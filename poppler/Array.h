@@ -28,9 +28,15 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
 #include "Object.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class XRef;
+class GooArena;
 
 //------------------------------------------------------------------------
 // Array
@@ -39,15 +45,19 @@ class XRef;
 class Array {
 public:
 
-  // Constructor.
-  Array(XRef *xrefA);
+  // Constructor.  If <arenaA> is set, the elements are stored in
+  // the arena (see Object::initArenaArray).
+  Array(XRef *xrefA, GooArena *arenaA = NULL);
 
   // Destructor.
   ~Array();
 
   // Reference counting.
-  int incRef() { return ++ref; }
-  int decRef() { return --ref; }
+  int incRef();
+  int decRef();
+
+  // Make a copy on the heap, with a reference count of 1.
+  Array *copy();
 
   // Get number of elements.
   int getLength() { return length; }
@@ -67,9 +77,13 @@ private:
 
   XRef *xref;			// the xref table for this PDF file
   Object *elems;		// array of elements
+  GooArena *arena;		// arena holding <elems>, or NULL
   int size;			// size of <elems> array
   int length;			// number of elements in array
   int ref;			// reference count
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
 };
 
 #endif
@@ -0,0 +1,214 @@
+//========================================================================
+//
+// Atom.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/gtypes.h"
+#include "Atom.h"
+
+//------------------------------------------------------------------------
+
+// The atoms, one after the other, each followed by a NUL.  Names
+// equal to one of these are represented by a pointer into this block.
+// The content stream operators come first, one per
+// atomOperatorSlotSize-byte slot (padded with NULs), in the same order
+// as Gfx::opTab.
+const char atomData[] =
+  // content stream operators
+  "\"\0\0\0" "'\0\0\0" "B\0\0\0" "B*\0\0" "BDC\0" "BI\0\0" "BMC\0"
+  "BT\0\0" "BX\0\0" "CS\0\0" "DP\0\0" "Do\0\0" "EI\0\0" "EMC\0"
+  "ET\0\0" "EX\0\0" "F\0\0\0" "G\0\0\0" "ID\0\0" "J\0\0\0" "K\0\0\0"
+  "M\0\0\0" "MP\0\0" "Q\0\0\0" "RG\0\0" "S\0\0\0" "SC\0\0" "SCN\0"
+  "T*\0\0" "TD\0\0" "TJ\0\0" "TL\0\0" "Tc\0\0" "Td\0\0" "Tf\0\0"
+  "Tj\0\0" "Tm\0\0" "Tr\0\0" "Ts\0\0" "Tw\0\0" "Tz\0\0" "W\0\0\0"
+  "W*\0\0" "b\0\0\0" "b*\0\0" "c\0\0\0" "cm\0\0" "cs\0\0" "d\0\0\0"
+  "d0\0\0" "d1\0\0" "f\0\0\0" "f*\0\0" "g\0\0\0" "gs\0\0" "h\0\0\0"
+  "i\0\0\0" "j\0\0\0" "k\0\0\0" "l\0\0\0" "m\0\0\0" "n\0\0\0" "q\0\0\0"
+  "re\0\0" "rg\0\0" "ri\0\0" "s\0\0\0" "sc\0\0" "scn\0" "sh\0\0"
+  "v\0\0\0" "w\0\0\0" "y\0\0\0"
+  // file structure
+  "[\0" "]\0" "<<\0" ">>\0" "{\0" "}\0" "obj\0" "endobj\0" "R\0"
+  "stream\0" "endstream\0" "xref\0" "trailer\0"
+  "startxref\0" "Type\0" "Subtype\0" "Filter\0" "DecodeParms\0"
+  "Length\0" "Length1\0" "Length2\0" "Length3\0" "Root\0" "Info\0"
+  "Size\0" "Prev\0" "XRefStm\0" "Encrypt\0" "Index\0" "First\0"
+  "Extends\0" "ObjStm\0" "XRef\0" "Linearized\0"
+  // document and pages
+  "Catalog\0" "Pages\0" "Page\0" "Kids\0" "Count\0" "Parent\0"
+  "Resources\0" "Contents\0" "MediaBox\0" "CropBox\0" "BleedBox\0"
+  "TrimBox\0" "ArtBox\0" "Rotate\0" "Annots\0" "Group\0" "Metadata\0"
+  "StructParents\0" "Thumb\0" "Dur\0" "Trans\0" "AA\0" "PieceInfo\0"
+  "LastModified\0" "UserUnit\0" "VP\0" "Tabs\0" "Outlines\0" "Dests\0"
+  "Names\0" "AcroForm\0" "PageLabels\0" "PageMode\0" "PageLayout\0"
+  "ViewerPreferences\0" "OpenAction\0" "StructTreeRoot\0" "MarkInfo\0"
+  "Lang\0" "OCProperties\0" "Version\0" "URI\0" "Threads\0" "Perms\0"
+  "Legal\0" "Collection\0" "Producer\0" "Creator\0" "CreationDate\0"
+  "ModDate\0" "Author\0" "Title\0" "Subject\0" "Keywords\0" "Trapped\0"
+  "EmbeddedFiles\0" "EmbeddedFile\0" "Filespec\0" "UF\0" "EF\0"
+  "Params\0" "Nums\0" "Limits\0"
+  // resources
+  "Font\0" "XObject\0" "ExtGState\0" "ColorSpace\0" "Pattern\0"
+  "Shading\0" "Properties\0" "ProcSet\0" "PDF\0" "Text\0" "ImageB\0"
+  "ImageC\0" "ImageI\0"
+  // fonts
+  "BaseFont\0" "FirstChar\0" "LastChar\0" "Widths\0" "FontDescriptor\0"
+  "Encoding\0" "ToUnicode\0" "DescendantFonts\0" "CIDSystemInfo\0"
+  "CIDToGIDMap\0" "DW\0" "W2\0" "DW2\0" "Registry\0" "Ordering\0"
+  "Supplement\0" "FontName\0" "FontFamily\0" "FontStretch\0"
+  "FontWeight\0" "Flags\0" "FontBBox\0" "ItalicAngle\0" "Ascent\0"
+  "Descent\0" "Leading\0" "CapHeight\0" "XHeight\0" "StemV\0" "StemH\0"
+  "AvgWidth\0" "MaxWidth\0" "MissingWidth\0" "FontFile\0" "FontFile2\0"
+  "FontFile3\0" "CharSet\0" "CIDSet\0" "Style\0" "Differences\0"
+  "BaseEncoding\0" "CharProcs\0" "FontMatrix\0" "Type0\0" "Type1\0"
+  "Type3\0" "MMType1\0" "TrueType\0" "CIDFontType0\0" "CIDFontType2\0"
+  "CIDFontType0C\0" "Type1C\0" "OpenType\0" "WinAnsiEncoding\0"
+  "MacRomanEncoding\0" "MacExpertEncoding\0" "StandardEncoding\0"
+  "Identity\0" "Identity-H\0" "Identity-V\0" "Adobe\0" "Japan1\0" "GB1\0"
+  "CNS1\0" "Korea1\0" "Helvetica\0" "Helvetica-Bold\0" "Times-Roman\0"
+  "Times-Bold\0" "Courier\0" "Symbol\0" "ZapfDingbats\0"
+  // glyph names
+  "space\0" "exclam\0" "quotedbl\0" "numbersign\0" "dollar\0" "percent\0"
+  "ampersand\0" "quoteright\0" "quotesingle\0" "parenleft\0"
+  "parenright\0" "asterisk\0" "plus\0" "comma\0" "hyphen\0" "period\0"
+  "slash\0" "zero\0" "one\0" "two\0" "three\0" "four\0" "five\0" "six\0"
+  "seven\0" "eight\0" "nine\0" "colon\0" "semicolon\0" "less\0" "equal\0"
+  "greater\0" "question\0" "at\0" "bracketleft\0" "backslash\0"
+  "bracketright\0" "asciicircum\0" "underscore\0" "quoteleft\0" "grave\0"
+  "braceleft\0" "bar\0" "braceright\0" "asciitilde\0" "bullet\0"
+  "endash\0" "emdash\0" "quotedblleft\0" "quotedblright\0" "fi\0" "fl\0"
+  "A\0" "C\0" "D\0" "E\0" "H\0" "I\0" "L\0" "N\0" "O\0" "P\0" "U\0" "V\0"
+  "X\0" "Y\0" "Z\0" "a\0" "e\0" "o\0" "p\0" "r\0" "t\0" "u\0" "x\0" "z\0"
+  // images and XObjects
+  "Image\0" "Form\0" "Width\0" "Height\0" "BitsPerComponent\0"
+  "ImageMask\0" "Mask\0" "SMask\0" "Decode\0" "Interpolate\0" "Intent\0"
+  "Alternates\0" "Name\0" "OPI\0" "SMaskInData\0" "Matte\0" "BBox\0"
+  "Matrix\0" "FormType\0" "Ref\0" "BPC\0" "IM\0" "DeviceGray\0"
+  "DeviceRGB\0" "DeviceCMYK\0" "CalGray\0" "CalRGB\0" "Lab\0"
+  "ICCBased\0" "Indexed\0" "Separation\0" "DeviceN\0" "Alternate\0"
+  "Range\0" "WhitePoint\0" "BlackPoint\0" "Gamma\0" "Colorants\0"
+  "Process\0" "Components\0" "RGB\0" "CMYK\0" "All\0" "None\0"
+  // filters
+  "ASCIIHexDecode\0" "ASCII85Decode\0" "LZWDecode\0" "FlateDecode\0"
+  "RunLengthDecode\0" "CCITTFaxDecode\0" "JBIG2Decode\0" "DCTDecode\0"
+  "JPXDecode\0" "Crypt\0" "AHx\0" "A85\0" "LZW\0" "Fl\0" "RL\0" "CCF\0"
+  "DCT\0" "Predictor\0" "Colors\0" "Columns\0" "EarlyChange\0"
+  "EncodedByteAlign\0" "Rows\0" "EndOfLine\0" "EndOfBlock\0" "BlackIs1\0"
+  "DamagedRowsBeforeError\0" "JBIG2Globals\0" "ColorTransform\0"
+  // graphics state
+  "LW\0" "LC\0" "LJ\0" "ML\0" "RI\0" "OP\0" "op\0" "OPM\0" "BG\0" "BG2\0"
+  "UCR\0" "UCR2\0" "TR\0" "TR2\0" "HT\0" "FL\0" "SM\0" "SA\0" "BM\0"
+  "CA\0" "ca\0" "AIS\0" "TK\0" "Normal\0" "Compatible\0" "Multiply\0"
+  "Screen\0" "Overlay\0" "Darken\0" "Lighten\0" "ColorDodge\0"
+  "ColorBurn\0" "HardLight\0" "SoftLight\0" "Difference\0" "Exclusion\0"
+  "Hue\0" "Saturation\0" "Color\0" "Luminosity\0" "Alpha\0" "BC\0"
+  "Transparency\0" "Isolated\0" "Knockout\0"
+  // shadings and functions
+  "ShadingType\0" "Coords\0" "Domain\0" "Function\0" "Functions\0"
+  "Extend\0" "Background\0" "AntiAlias\0" "FunctionType\0" "C0\0" "C1\0"
+  "Bounds\0" "Encode\0" "Order\0" "BitsPerSample\0" "BitsPerCoordinate\0"
+  "BitsPerFlag\0" "VerticesPerRow\0" "PatternType\0" "PaintType\0"
+  "TilingType\0" "XStep\0" "YStep\0"
+  // annotations and forms
+  "Annot\0" "Rect\0" "Border\0" "BS\0" "AP\0" "AS\0" "NM\0" "RC\0"
+  "Popup\0" "Open\0" "Subj\0" "IRT\0" "RT\0" "IC\0" "QuadPoints\0"
+  "Link\0" "Widget\0" "FreeText\0" "Line\0" "Square\0" "Circle\0"
+  "Polygon\0" "PolyLine\0" "Highlight\0" "Underline\0" "Squiggly\0"
+  "StrikeOut\0" "Stamp\0" "Caret\0" "Ink\0" "FileAttachment\0" "Sound\0"
+  "Movie\0" "PrinterMark\0" "TrapNet\0" "Watermark\0" "3D\0" "Action\0"
+  "Dest\0" "MK\0" "DA\0" "DR\0" "Off\0" "On\0" "Yes\0" "FT\0" "Ff\0"
+  "Fields\0" "DV\0" "Opt\0" "TU\0" "TM\0" "Btn\0" "Tx\0" "Ch\0" "Sig\0"
+  "GoTo\0" "GoToR\0" "Launch\0" "Named\0" "JavaScript\0" "JS\0" "Next\0"
+  "XYZ\0" "Fit\0" "FitH\0" "FitV\0" "FitR\0" "FitB\0" "FitBH\0" "FitBV\0"
+  "Last\0"
+  // optional and marked content
+  "OC\0" "OCG\0" "OCGs\0" "OCMD\0" "Usage\0" "ON\0" "OFF\0" "RBGroups\0"
+  "Configs\0" "MCID\0" "Span\0" "Artifact\0" "ActualText\0" "Alt\0"
+  "StructParent\0" "Pg\0" "Obj\0"
+  // encryption
+  "Standard\0" "StmF\0" "StrF\0" "CF\0" "CFM\0" "AESV2\0" "AESV3\0"
+  "V2\0" "StdCF\0" "EncryptMetadata\0" "OE\0" "UE\0";
+
+// the terminating NUL of the literal is not part of any atom
+const size_t atomDataSize = sizeof(atomData) - 1;
+
+#define atomHashSize 2048	// must be a power of 2, well above the
+				//   number of atoms
+
+// Open addressing hash table over atomData: each slot holds the offset
+// of an atom plus one, or zero if it is empty.
+class AtomHash {
+public:
+
+  AtomHash();
+
+  const char *lookup(const char *s);
+
+private:
+
+  static Guint hash(const char *s);
+
+  Gushort tab[atomHashSize];
+};
+
+AtomHash::AtomHash() {
+  const char *p;
+  Guint h;
+
+  memset(tab, 0, sizeof(tab));
+  for (p = atomData; p < atomData + atomDataSize; p += strlen(p) + 1) {
+    if (!*p) {			// operator slot padding
+      continue;
+    }
+    for (h = hash(p); tab[h]; h = (h + 1) & (atomHashSize - 1)) ;
+    tab[h] = (Gushort)(p - atomData + 1);
+  }
+}
+
+inline Guint AtomHash::hash(const char *s) {
+  Guint h;
+
+  // FNV-1a
+  h = 2166136261U;
+  for (; *s; ++s) {
+    h = (h ^ (Guchar)*s) * 16777619U;
+  }
+  return (h ^ (h >> 16)) & (atomHashSize - 1);
+}
+
+const char *AtomHash::lookup(const char *s) {
+  const char *atom;
+  Guint h;
+
+  for (h = hash(s); tab[h]; h = (h + 1) & (atomHashSize - 1)) {
+    atom = atomData + tab[h] - 1;
+    if (atom[0] == s[0] && !strcmp(atom, s)) {
+      return atom;
+    }
+  }
+  return NULL;
+}
+
+const char *atomLookup(const char *s) {
+  static AtomHash atomHash;
+
+  return atomHash.lookup(s);
+}
+
+char *copyName(const char *s) {
+  const char *atom;
+
+  if (isAtom(s)) {
+    return (char *)s;
+  }
+  if ((atom = atomLookup(s))) {
+    return (char *)atom;
+  }
+  return copyString(s);
+}
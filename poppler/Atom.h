@@ -0,0 +1,66 @@
+//========================================================================
+//
+// Atom.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef ATOM_H
+#define ATOM_H
+
+#include <stddef.h>
+#include "goo/gmem.h"
+
+//------------------------------------------------------------------------
+// Atoms
+//
+// Well-known PDF names (dictionary keys, common name values and the
+// content stream operators) are interned: one copy of each lives in a
+// static table, and names, commands and dictionary keys that match
+// one of them point into that table instead of being allocated.  Two
+// atoms are equal if and only if they are the same pointer.
+//------------------------------------------------------------------------
+
+extern const char atomData[];
+extern const size_t atomDataSize;
+
+// Return true if <s> points into the atom table.
+static inline bool isAtom(const char *s) {
+  return (size_t)(s - atomData) < atomDataSize;
+}
+
+// The content stream operators are the first atomNumOperators atoms,
+// each one in its own atomOperatorSlotSize-byte slot, sorted as in
+// Gfx::opTab.
+#define atomNumOperators     73
+#define atomOperatorSlotSize 4
+
+// If <s> is the atom of a content stream operator, return the index
+// of that operator (see above), otherwise return -1.
+static inline int atomOperatorIndex(const char *s) {
+  size_t offset = (size_t)(s - atomData);
+
+  if (offset >= atomNumOperators * atomOperatorSlotSize) {
+    return -1;
+  }
+  return (int)(offset / atomOperatorSlotSize);
+}
+
+// Return the atom equal to <s>, or NULL if <s> is not a well-known
+// name.
+const char *atomLookup(const char *s);
+
+// Return the atom equal to <s> if there is one, otherwise a copy of
+// <s> allocated with gmalloc.  The result must be released with
+// freeName().
+char *copyName(const char *s);
+
+// Free a string returned by copyName().
+static inline void freeName(char *s) {
+  if (!isAtom(s)) {
+    gfree(s);
+  }
+}
+
+#endif
@@ -13,6 +13,12 @@
 #include <config.h>
 #include "CachedFile.h"
 
+#if MULTITHREADED
+#  define cachedFileLocker()   MutexLocker locker(&mutex)
+#else
+#  define cachedFileLocker()
+#endif
+
 //------------------------------------------------------------------------
 // CachedFile
 //------------------------------------------------------------------------
@@ -21,6 +27,9 @@ CachedFile::CachedFile(CachedFileLoader *cachedFileLoaderA, GooString *uriA)
 {
   uri = uriA;
   loader = cachedFileLoaderA;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 
   streamPos = 0;
   chunks = new std::vector<Chunk>();
@@ -43,23 +52,38 @@ CachedFile::~CachedFile()
   delete uri;
   delete loader;
   delete chunks;
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
 }
 
 void CachedFile::incRefCnt() {
+  cachedFileLocker();
   refCnt++;
 }
 
 void CachedFile::decRefCnt() {
-  if (--refCnt == 0)
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done)
     delete this;
 }
 
 long int CachedFile::tell() {
+  cachedFileLocker();
   return streamPos;
 }
 
 int CachedFile::seek(long int offset, int origin)
 {
+  cachedFileLocker();
   if (origin == SEEK_SET) {
     streamPos = offset;
   } else if (origin == SEEK_CUR) {
@@ -78,6 +102,7 @@ int CachedFile::seek(long int offset, int origin)
 
 int CachedFile::cache(const std::vector<ByteRange> &origRanges)
 {
+  cachedFileLocker();
   std::vector<int> loadChunks;
   int numChunks = length/CachedFileChunkSize + 1;
   std::vector<bool> chunkNeeded(numChunks);
@@ -142,28 +167,39 @@ int CachedFile::cache(const std::vector<ByteRange> &origRanges)
 
 size_t CachedFile::read(void *ptr, size_t unitsize, size_t count)
 {
+  cachedFileLocker();
+  size_t bytes = read(ptr, unitsize, count, streamPos);
+  streamPos += bytes;
+  return bytes;
+}
+
+size_t CachedFile::read(void *ptr, size_t unitsize, size_t count, Guint offset)
+{
+  cachedFileLocker();
+  size_t pos = offset;
   size_t bytes = unitsize*count;
-  if (length < (streamPos + bytes)) {
-    bytes = length - streamPos;
+  if (pos >= length) return 0;
+  if (length < (pos + bytes)) {
+    bytes = length - pos;
   }
 
   if (bytes == 0) return 0;
 
   // Load data
-  if (cache(streamPos, bytes) != 0) return 0;
+  if (cache(pos, bytes) != 0) return 0;
 
   // Copy data to buffer
   size_t toCopy = bytes;
   while (toCopy) {
-    int chunk = streamPos / CachedFileChunkSize;
-    int offset = streamPos % CachedFileChunkSize;
-    size_t len = CachedFileChunkSize-offset;
+    int chunk = pos / CachedFileChunkSize;
+    int chunkOffset = pos % CachedFileChunkSize;
+    size_t len = CachedFileChunkSize-chunkOffset;
 
     if (len > toCopy)
       len = toCopy;
 
-    memcpy(ptr, (*chunks)[chunk].data + offset, len);
-    streamPos += len;
+    memcpy(ptr, (*chunks)[chunk].data + chunkOffset, len);
+    pos += len;
     toCopy -= len;
     ptr = (char*)ptr + len;
   }
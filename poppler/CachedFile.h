@@ -21,6 +21,10 @@
 #include "Object.h"
 #include "Stream.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 #include <vector>
 
 //------------------------------------------------------------------------
@@ -51,6 +55,8 @@ public:
   long int tell();
   int seek(long int offset, int origin);
   size_t read(void * ptr, size_t unitsize, size_t count);
+  // Read from <offset> without using or moving the current position.
+  size_t read(void * ptr, size_t unitsize, size_t count, Guint offset);
   size_t write(const char *ptr, size_t size, size_t fromByte);
   int cache(const std::vector<ByteRange> &ranges);
 
@@ -84,6 +90,9 @@ private:
 
   int refCnt;  // reference count
 
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
 };
 
 //------------------------------------------------------------------------
@@ -53,6 +53,8 @@
 #include "GfxState.h"
 #include "GfxFont.h"
 #include "Page.h"
+#include "PDFDoc.h"
+#include "ImageCache.h"
 #include "Link.h"
 #include "FontEncodingTables.h"
 #include "PDFDocEncoding.h"
@@ -2734,14 +2736,21 @@ void CairoOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   cairo_surface_t *image;
   cairo_pattern_t *pattern, *maskPattern;
   ImageStream *imgStr;
+  Stream *cachedStr;
   cairo_matrix_t matrix;
   unsigned char *buffer;
   int stride, i;
   GfxRGB *lookup = NULL;
   cairo_filter_t filter = CAIRO_FILTER_BILINEAR;
 
-  /* TODO: Do we want to cache these? */
-  imgStr = new ImageStream(str, width,
+  // read the decoded data from the document's image cache if it's there
+  cachedStr = NULL;
+  if (!inlineImg && ref && ref->isRef() && doc) {
+    cachedStr = doc->getXRef()->getImageCache()->getImageStream(
+		    ref->getRef(), str, width, height,
+		    colorMap->getNumPixelComps(), colorMap->getBits());
+  }
+  imgStr = new ImageStream(cachedStr ? cachedStr : str, width,
 			   colorMap->getNumPixelComps(),
 			   colorMap->getBits());
   imgStr->reset();
@@ -2903,6 +2912,7 @@ void CairoOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
 cleanup:
   imgStr->close();
   delete imgStr;
+  delete cachedStr;
 }
 
 
@@ -54,6 +54,12 @@
 #include "ViewerPreferences.h"
 #include "FileSpec.h"
 
+#if MULTITHREADED
+#  define catalogLocker()   MutexLocker locker(&mutex)
+#else
+#  define catalogLocker()
+#endif
+
 //------------------------------------------------------------------------
 // Catalog
 //------------------------------------------------------------------------
@@ -63,6 +69,9 @@ Catalog::Catalog(PDFDoc *docA) {
   Object obj, obj2;
   Object optContentProps;
 
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
   ok = gTrue;
   doc = docA;
   xref = doc->getXRef();
@@ -169,6 +178,9 @@ Catalog::~Catalog() {
   outline.free();
   acroForm.free();
   viewerPreferences.free();
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
 }
 
 GooString *Catalog::readMetadata() {
@@ -206,6 +218,7 @@ GooString *Catalog::readMetadata() {
 
 Page *Catalog::getPage(int i)
 {
+  catalogLocker();
   if (i < 1) return NULL;
 
   if (i > lastCachedPage) {
@@ -216,6 +229,7 @@ Page *Catalog::getPage(int i)
 
 Ref *Catalog::getPageRef(int i)
 {
+  catalogLocker();
   if (i < 1) return NULL;
 
   if (i > lastCachedPage) {
@@ -398,6 +412,7 @@ GBool Catalog::cachePageTree(int page)
 }
 
 int Catalog::findPage(int num, int gen) {
+  catalogLocker();
   int i;
 
   for (i = 0; i < getNumPages(); ++i) {
@@ -508,6 +523,7 @@ GooString *Catalog::getJS(int i)
 }
 
 Catalog::PageMode Catalog::getPageMode() {
+  catalogLocker();
 
   if (pageMode == pageModeNull) {
 
@@ -543,6 +559,7 @@ Catalog::PageMode Catalog::getPageMode() {
 }
 
 Catalog::PageLayout Catalog::getPageLayout() {
+  catalogLocker();
 
   if (pageLayout == pageLayoutNull) {
 
@@ -743,6 +760,7 @@ GBool Catalog::indexToLabel(int index, GooString *label)
 
 int Catalog::getNumPages()
 {
+  catalogLocker();
   if (numPages == -1)
   {
     Object catDict, pagesDict, obj;
@@ -784,6 +802,7 @@ int Catalog::getNumPages()
 
 PageLabelInfo *Catalog::getPageLabelInfo()
 {
+  catalogLocker();
   if (!pageLabelInfo) {
     Object catDict;
     Object obj;
@@ -807,6 +826,7 @@ PageLabelInfo *Catalog::getPageLabelInfo()
 
 Object *Catalog::getStructTreeRoot()
 {
+  catalogLocker();
   if (structTreeRoot.isNone())
   {
      Object catDict;
@@ -826,6 +846,7 @@ Object *Catalog::getStructTreeRoot()
 
 Object *Catalog::getOutline()
 {
+  catalogLocker();
   if (outline.isNone())
   {
      Object catDict;
@@ -845,6 +866,7 @@ Object *Catalog::getOutline()
 
 Object *Catalog::getDests()
 {
+  catalogLocker();
   if (dests.isNone())
   {
      Object catDict;
@@ -864,6 +886,7 @@ Object *Catalog::getDests()
 
 Form *Catalog::getForm()
 {
+  catalogLocker();
   if (!form) {
     if (acroForm.isDict()) {
       form = new Form(doc, &acroForm);
@@ -877,6 +900,7 @@ Form *Catalog::getForm()
 
 ViewerPreferences *Catalog::getViewerPreferences()
 {
+  catalogLocker();
   if (!viewerPrefs) {
     if (viewerPreferences.isDict()) {
       viewerPrefs = new ViewerPreferences(viewerPreferences.getDict());
@@ -888,6 +912,7 @@ ViewerPreferences *Catalog::getViewerPreferences()
 
 Object *Catalog::getNames()
 {
+  catalogLocker();
   if (names.isNone())
   {
      Object catDict;
@@ -907,6 +932,7 @@ Object *Catalog::getNames()
 
 NameTree *Catalog::getDestNameTree()
 {
+  catalogLocker();
   if (!destNameTree) {
 
     destNameTree = new NameTree();
@@ -926,6 +952,7 @@ NameTree *Catalog::getDestNameTree()
 
 NameTree *Catalog::getEmbeddedFileNameTree()
 {
+  catalogLocker();
   if (!embeddedFileNameTree) {
 
     embeddedFileNameTree = new NameTree();
@@ -945,6 +972,7 @@ NameTree *Catalog::getEmbeddedFileNameTree()
 
 NameTree *Catalog::getJSNameTree()
 {
+  catalogLocker();
   if (!jsNameTree) {
 
     jsNameTree = new NameTree();
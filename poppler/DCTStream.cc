@@ -62,6 +62,7 @@ static void str_term_source(j_decompress_ptr cinfo)
 DCTStream::DCTStream(Stream *strA, int colorXformA) :
   FilterStream(strA) {
   colorXform = colorXformA;
+  scaleDenom = 1;
   init();
 }
 
@@ -172,6 +173,11 @@ void DCTStream::reset() {
 	    break;
     }
 
+    // libjpeg scales the image down while doing the inverse DCT,
+    // which saves most of the decoding work for large reductions
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scaleDenom;
+
     jpeg_start_decompress(&cinfo);
 
     row_stride = cinfo.output_width * cinfo.output_components;
@@ -241,3 +247,8 @@ GooString *DCTStream::getPSFilter(int psLevel, const char *indent) {
 GBool DCTStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
+
+int DCTStream::setImageScaleDenom(int denom) {
+  scaleDenom = (denom == 2 || denom == 4 || denom == 8) ? denom : 1;
+  return scaleDenom;
+}
@@ -68,6 +68,7 @@ public:
   virtual int lookChar();
   virtual GooString *getPSFilter(int psLevel, const char *indent);
   virtual GBool isBinary(GBool last = gTrue);
+  virtual int setImageScaleDenom(int denom);
 
 private:
   void init();
@@ -76,6 +77,8 @@ private:
   virtual int getChars(int nChars, Guchar *buffer);
 
   int colorXform;
+  int scaleDenom;		// image is decoded at 1/scaleDenom of its
+				//   size (libjpeg DCT scaling)
   JSAMPLE *current;
   JSAMPLE *limit;
   struct jpeg_decompress_struct cinfo;
@@ -34,12 +34,30 @@
 #include "Decrypt.h"
 #include "Error.h"
 
+// AES-NI is compiled in on x86 with compilers that can target it per
+// function (so no -maes flag is needed), and used if the CPU has it.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define DECRYPT_AESNI 1
+#include <cpuid.h>
+#include <wmmintrin.h>
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define DECRYPT_AESNI 1
+#include <intrin.h>
+#include <wmmintrin.h>
+#define AESNI_TARGET
+#endif
+
 static void aesKeyExpansion(DecryptAESState *s,
 			    Guchar *objKey, int objKeyLen);
 static void aesDecryptBlock(DecryptAESState *s, Guchar *in, GBool last);
+static void aesDecryptBlocks(DecryptAESState *s, Guchar *buf, int n);
 static void aes256KeyExpansion(DecryptAES256State *s,
 			       Guchar *objKey, int objKeyLen);
 static void aes256DecryptBlock(DecryptAES256State *s, Guchar *in, GBool last);
+static void aes256DecryptBlocks(DecryptAES256State *s, Guchar *buf, int n);
 static void sha256(Guchar *msg, int msgLen, Guchar *hash);
 
 static const Guchar passwordPad[32] = {
@@ -268,23 +286,15 @@ GBool Decrypt::makeFileKey2(int encVersion, int encRevision, int keyLength,
   return ok;
 }
 
-//------------------------------------------------------------------------
-// DecryptStream
-//------------------------------------------------------------------------
+int Decrypt::makeObjectKey(CryptAlgorithm algo, Guchar *fileKey,
+			   int keyLength, int objNum, int objGen,
+			   Guchar *objKey) {
+  int objKeyLength, i;
 
-DecryptStream::DecryptStream(Stream *strA, Guchar *fileKey,
-			     CryptAlgorithm algoA, int keyLength,
-			     int objNum, int objGen):
-  FilterStream(strA)
-{
-  int i;
-
-  algo = algoA;
-
-  // construct object key
   for (i = 0; i < keyLength; ++i) {
     objKey[i] = fileKey[i];
   }
+  objKeyLength = 0;
   switch (algo) {
   case cryptRC4:
     objKey[keyLength] = objNum & 0xff;
@@ -308,16 +318,59 @@ DecryptStream::DecryptStream(Stream *strA, Guchar *fileKey,
     objKey[keyLength + 7] = 0x6c; // 'l'
     objKey[keyLength + 8] = 0x54; // 'T'
     md5(objKey, keyLength + 9, objKey);
-    if ((objKeyLength = keyLength + 5) > 16) {
-      objKeyLength = 16;
-    }
+    // AES-128 always uses the whole digest, whatever the length of
+    // the file key
+    objKeyLength = 16;
     break;
   case cryptAES256:
     objKeyLength = keyLength;
     break;
   }
+  return objKeyLength;
+}
+
+//------------------------------------------------------------------------
+// DecryptStream
+//------------------------------------------------------------------------
+
+DecryptStream::DecryptStream(Stream *strA, Guchar *fileKey,
+			     CryptAlgorithm algoA, int keyLength,
+			     int objNum, int objGen):
+  FilterStream(strA)
+{
+  Guchar objKeyA[32];
+  int objKeyLengthA;
+
+  objKeyLengthA = Decrypt::makeObjectKey(algoA, fileKey, keyLength,
+					 objNum, objGen, objKeyA);
+  init(algoA, objKeyA, objKeyLengthA);
+}
+
+DecryptStream::DecryptStream(Stream *strA, Guchar *objKeyA,
+			     int objKeyLengthA, CryptAlgorithm algoA):
+  FilterStream(strA)
+{
+  init(algoA, objKeyA, objKeyLengthA);
+}
+
+void DecryptStream::init(CryptAlgorithm algoA, Guchar *objKeyA,
+			 int objKeyLengthA) {
+  algo = algoA;
+  objKeyLength = objKeyLengthA;
+  memcpy(objKey, objKeyA, objKeyLength);
+  switch (algo) {
+  case cryptRC4:
+    break;
+  case cryptAES:
+    aesKeyExpansion(&state.aes, objKey, objKeyLength);
+    break;
+  case cryptAES256:
+    aes256KeyExpansion(&state.aes256, objKey, objKeyLength);
+    break;
+  }
 
   charactersRead = 0;
+  bufPtr = bufEnd = buf;
 }
 
 DecryptStream::~DecryptStream() {
@@ -328,22 +381,20 @@ void DecryptStream::reset() {
   int i;
 
   charactersRead = 0;
+  bufPtr = bufEnd = buf;
   str->reset();
   switch (algo) {
   case cryptRC4:
     state.rc4.x = state.rc4.y = 0;
     rc4InitKey(objKey, objKeyLength, state.rc4.state);
-    state.rc4.buf = EOF;
     break;
   case cryptAES:
-    aesKeyExpansion(&state.aes, objKey, objKeyLength);
     for (i = 0; i < 16; ++i) {
       state.aes.cbc[i] = str->getChar();
     }
     state.aes.bufIdx = 16;
     break;
   case cryptAES256:
-    aes256KeyExpansion(&state.aes256, objKey, objKeyLength);
     for (i = 0; i < 16; ++i) {
       state.aes256.cbc[i] = str->getChar();
     }
@@ -356,111 +407,132 @@ int DecryptStream::getPos() {
   return charactersRead;
 }
 
-int DecryptStream::getChar() {
-  Guchar in[16];
-  int c, i;
-
-  c = EOF; // make gcc happy
-  switch (algo) {
-  case cryptRC4:
-    if (state.rc4.buf == EOF) {
-      c = str->getChar();
-      if (c != EOF) {
-	state.rc4.buf = rc4DecryptByte(state.rc4.state, &state.rc4.x,
-				       &state.rc4.y, (Guchar)c);
-      }
-    }
-    c = state.rc4.buf;
-    state.rc4.buf = EOF;
-    break;
-  case cryptAES:
-    if (state.aes.bufIdx == 16) {
-      for (i = 0; i < 16; ++i) {
-	if ((c = str->getChar()) == EOF) {
-	  return EOF;
+// Copy out the buffered data, then decrypt the rest of large requests
+// straight into <buffer>.
+int DecryptStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd) {
+      if (nChars - n >= decryptStreamBufSize) {
+	if ((m = decrypt(nChars - n, buffer + n)) == 0) {
+	  break;
 	}
-	in[i] = (Guchar)c;
+	n += m;
+	continue;
       }
-      aesDecryptBlock(&state.aes, in, str->lookChar() == EOF);
-    }
-    if (state.aes.bufIdx == 16) {
-      c = EOF;
-    } else {
-      c = state.aes.buf[state.aes.bufIdx++];
-    }
-    break;
-  case cryptAES256:
-    if (state.aes256.bufIdx == 16) {
-      for (i = 0; i < 16; ++i) {
-	if ((c = str->getChar()) == EOF) {
-	  return EOF;
-	}
-	in[i] = (Guchar)c;
+      if (!fillBuf()) {
+	break;
       }
-      aes256DecryptBlock(&state.aes256, in, str->lookChar() == EOF);
     }
-    if (state.aes256.bufIdx == 16) {
-      c = EOF;
-    } else {
-      c = state.aes256.buf[state.aes256.bufIdx++];
+    m = (int)(bufEnd - bufPtr);
+    if (m > nChars - n) {
+      m = nChars - n;
     }
-    break;
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
   }
-  if (c != EOF)
-    charactersRead++;
-  return c;
+  charactersRead += n;
+  return n;
+}
+
+GBool DecryptStream::fillBuf() {
+  bufPtr = buf;
+  bufEnd = buf + decrypt(decryptStreamBufSize, buf);
+  return bufPtr < bufEnd;
 }
 
-int DecryptStream::lookChar() {
+// Read and decrypt up to <nChars> bytes into <buffer>.  RC4 data is
+// read straight into <buffer> and decrypted there.  AES data is read
+// and decrypted in place too, a run of whole blocks at a time, except
+// for the last block of each run: it goes through the block buffer, so
+// that the padding can be removed if it turns out to be the last one
+// of the stream.
+int DecryptStream::decrypt(int nChars, Guchar *buffer) {
   Guchar in[16];
-  int c, i;
+  int n, m, i;
+  GBool last;
 
-  c = EOF; // make gcc happy
+  n = 0;
   switch (algo) {
   case cryptRC4:
-    if (state.rc4.buf == EOF) {
-      c = str->getChar();
-      if (c != EOF) {
-	state.rc4.buf = rc4DecryptByte(state.rc4.state, &state.rc4.x,
-				       &state.rc4.y, (Guchar)c);
-      }
-    }
-    c = state.rc4.buf;
+    n = str->doGetChars(nChars, buffer);
+    rc4Decrypt(state.rc4.state, &state.rc4.x, &state.rc4.y, buffer, n);
     break;
   case cryptAES:
-    if (state.aes.bufIdx == 16) {
-      for (i = 0; i < 16; ++i) {
-	if ((c = str->getChar()) == EOF) {
-	  return EOF;
+    while (n < nChars) {
+      if (state.aes.bufIdx == 16) {
+	m = (nChars - n) & ~15;
+	if (m > 16) {
+	  i = str->doGetChars(m, buffer + n);
+	  m = i & ~15;
+	  if (m == 0) {
+	    break;
+	  }
+	  // a partial block at the end of the data is dropped, and the
+	  // block before it is not the last one
+	  last = !(i & 15) && str->lookChar() == EOF;
+	  aesDecryptBlocks(&state.aes, buffer + n, m - 16);
+	  n += m - 16;
+	  memcpy(in, buffer + n, 16);
+	  aesDecryptBlock(&state.aes, in, last);
+	} else {
+	  if (str->doGetChars(16, in) < 16) {
+	    break;
+	  }
+	  aesDecryptBlock(&state.aes, in, str->lookChar() == EOF);
+	}
+	if (state.aes.bufIdx == 16) {
+	  break;
 	}
-	in[i] = c;
       }
-      aesDecryptBlock(&state.aes, in, str->lookChar() == EOF);
-    }
-    if (state.aes.bufIdx == 16) {
-      c = EOF;
-    } else {
-      c = state.aes.buf[state.aes.bufIdx];
+      m = 16 - state.aes.bufIdx;
+      if (m > nChars - n) {
+	m = nChars - n;
+      }
+      memcpy(buffer + n, state.aes.buf + state.aes.bufIdx, m);
+      state.aes.bufIdx += m;
+      n += m;
     }
     break;
   case cryptAES256:
-    if (state.aes256.bufIdx == 16) {
-      for (i = 0; i < 16; ++i) {
-	if ((c = str->getChar()) == EOF) {
-	  return EOF;
+    while (n < nChars) {
+      if (state.aes256.bufIdx == 16) {
+	m = (nChars - n) & ~15;
+	if (m > 16) {
+	  i = str->doGetChars(m, buffer + n);
+	  m = i & ~15;
+	  if (m == 0) {
+	    break;
+	  }
+	  last = !(i & 15) && str->lookChar() == EOF;
+	  aes256DecryptBlocks(&state.aes256, buffer + n, m - 16);
+	  n += m - 16;
+	  memcpy(in, buffer + n, 16);
+	  aes256DecryptBlock(&state.aes256, in, last);
+	} else {
+	  if (str->doGetChars(16, in) < 16) {
+	    break;
+	  }
+	  aes256DecryptBlock(&state.aes256, in, str->lookChar() == EOF);
+	}
+	if (state.aes256.bufIdx == 16) {
+	  break;
 	}
-	in[i] = c;
       }
-      aes256DecryptBlock(&state.aes256, in, str->lookChar() == EOF);
-    }
-    if (state.aes256.bufIdx == 16) {
-      c = EOF;
-    } else {
-      c = state.aes256.buf[state.aes256.bufIdx];
+      m = 16 - state.aes256.bufIdx;
+      if (m > nChars - n) {
+	m = nChars - n;
+      }
+      memcpy(buffer + n, state.aes256.buf + state.aes256.bufIdx, m);
+      state.aes256.bufIdx += m;
+      n += m;
     }
     break;
   }
-  return c;
+  return n;
 }
 
 GBool DecryptStream::isBinary(GBool last) {
@@ -504,6 +576,25 @@ Guchar rc4DecryptByte(Guchar *state, Guchar *x, Guchar *y, Guchar c) {
   return c ^ state[(tx + ty) % 256];
 }
 
+void rc4Decrypt(Guchar *state, Guchar *x, Guchar *y, Guchar *buf, int n) {
+  Guchar x1, y1, tx, ty;
+  int i;
+
+  x1 = *x;
+  y1 = *y;
+  for (i = 0; i < n; ++i) {
+    x1 = (Guchar)(x1 + 1);
+    tx = state[x1];
+    y1 = (Guchar)(y1 + tx);
+    ty = state[y1];
+    state[x1] = ty;
+    state[y1] = tx;
+    buf[i] ^= state[(Guchar)(tx + ty)];
+  }
+  *x = x1;
+  *y = y1;
+}
+
 //------------------------------------------------------------------------
 // AES decryption
 //------------------------------------------------------------------------
@@ -571,37 +662,6 @@ static inline Guint rotWord(Guint x) {
   return ((x << 8) & 0xffffffff) | (x >> 24);
 }
 
-static inline void invSubBytes(Guchar *state) {
-  int i;
-
-  for (i = 0; i < 16; ++i) {
-    state[i] = invSbox[state[i]];
-  }
-}
-
-static inline void invShiftRows(Guchar *state) {
-  Guchar t;
-
-  t = state[7];
-  state[7] = state[6];
-  state[6] = state[5];
-  state[5] = state[4];
-  state[4] = t;
-
-  t = state[8];
-  state[8] = state[10];
-  state[10] = t;
-  t = state[9];
-  state[9] = state[11];
-  state[11] = t;
-
-  t = state[12];
-  state[12] = state[13];
-  state[13] = state[14];
-  state[14] = state[15];
-  state[15] = t;
-}
-
 // {09} \cdot s
 static inline Guchar mul09(Guchar s) {
   Guchar s2, s4, s8;
@@ -642,22 +702,6 @@ static inline Guchar mul0e(Guchar s) {
   return s2 ^ s4 ^ s8;
 }
 
-static inline void invMixColumns(Guchar *state) {
-  int c;
-  Guchar s0, s1, s2, s3;
-
-  for (c = 0; c < 4; ++c) {
-    s0 = state[c];
-    s1 = state[4+c];
-    s2 = state[8+c];
-    s3 = state[12+c];
-    state[c] =    mul0e(s0) ^ mul0b(s1) ^ mul0d(s2) ^ mul09(s3);
-    state[4+c] =  mul09(s0) ^ mul0e(s1) ^ mul0b(s2) ^ mul0d(s3);
-    state[8+c] =  mul0d(s0) ^ mul09(s1) ^ mul0e(s2) ^ mul0b(s3);
-    state[12+c] = mul0b(s0) ^ mul0d(s1) ^ mul09(s2) ^ mul0e(s3);
-  }
-}
-
 static inline void invMixColumnsW(Guint *w) {
   int c;
   Guchar s0, s1, s2, s3;
@@ -674,15 +718,54 @@ static inline void invMixColumnsW(Guint *w) {
   }
 }
 
-static inline void addRoundKey(Guchar *state, Guint *w) {
-  int c;
+// invSbox combined with InvMixColumns: invTab[x] is the column
+// ({0e}, {09}, {0d}, {0b}) * invSbox[x].  The other rows of a column
+// use the same table, rotated.
+static const Guint invTab[256] = {
+  0x51f4a750, 0x7e416553, 0x1a17a4c3, 0x3a275e96, 0x3bab6bcb, 0x1f9d45f1, 0xacfa58ab, 0x4be30393,
+  0x2030fa55, 0xad766df6, 0x88cc7691, 0xf5024c25, 0x4fe5d7fc, 0xc52acbd7, 0x26354480, 0xb562a38f,
+  0xdeb15a49, 0x25ba1b67, 0x45ea0e98, 0x5dfec0e1, 0xc32f7502, 0x814cf012, 0x8d4697a3, 0x6bd3f9c6,
+  0x038f5fe7, 0x15929c95, 0xbf6d7aeb, 0x955259da, 0xd4be832d, 0x587421d3, 0x49e06929, 0x8ec9c844,
+  0x75c2896a, 0xf48e7978, 0x99583e6b, 0x27b971dd, 0xbee14fb6, 0xf088ad17, 0xc920ac66, 0x7dce3ab4,
+  0x63df4a18, 0xe51a3182, 0x97513360, 0x62537f45, 0xb16477e0, 0xbb6bae84, 0xfe81a01c, 0xf9082b94,
+  0x70486858, 0x8f45fd19, 0x94de6c87, 0x527bf8b7, 0xab73d323, 0x724b02e2, 0xe31f8f57, 0x6655ab2a,
+  0xb2eb2807, 0x2fb5c203, 0x86c57b9a, 0xd33708a5, 0x302887f2, 0x23bfa5b2, 0x02036aba, 0xed16825c,
+  0x8acf1c2b, 0xa779b492, 0xf307f2f0, 0x4e69e2a1, 0x65daf4cd, 0x0605bed5, 0xd134621f, 0xc4a6fe8a,
+  0x342e539d, 0xa2f355a0, 0x058ae132, 0xa4f6eb75, 0x0b83ec39, 0x4060efaa, 0x5e719f06, 0xbd6e1051,
+  0x3e218af9, 0x96dd063d, 0xdd3e05ae, 0x4de6bd46, 0x91548db5, 0x71c45d05, 0x0406d46f, 0x605015ff,
+  0x1998fb24, 0xd6bde997, 0x894043cc, 0x67d99e77, 0xb0e842bd, 0x07898b88, 0xe7195b38, 0x79c8eedb,
+  0xa17c0a47, 0x7c420fe9, 0xf8841ec9, 0x00000000, 0x09808683, 0x322bed48, 0x1e1170ac, 0x6c5a724e,
+  0xfd0efffb, 0x0f853856, 0x3daed51e, 0x362d3927, 0x0a0fd964, 0x685ca621, 0x9b5b54d1, 0x24362e3a,
+  0x0c0a67b1, 0x9357e70f, 0xb4ee96d2, 0x1b9b919e, 0x80c0c54f, 0x61dc20a2, 0x5a774b69, 0x1c121a16,
+  0xe293ba0a, 0xc0a02ae5, 0x3c22e043, 0x121b171d, 0x0e090d0b, 0xf28bc7ad, 0x2db6a8b9, 0x141ea9c8,
+  0x57f11985, 0xaf75074c, 0xee99ddbb, 0xa37f60fd, 0xf701269f, 0x5c72f5bc, 0x44663bc5, 0x5bfb7e34,
+  0x8b432976, 0xcb23c6dc, 0xb6edfc68, 0xb8e4f163, 0xd731dcca, 0x42638510, 0x13972240, 0x84c61120,
+  0x854a247d, 0xd2bb3df8, 0xaef93211, 0xc729a16d, 0x1d9e2f4b, 0xdcb230f3, 0x0d8652ec, 0x77c1e3d0,
+  0x2bb3166c, 0xa970b999, 0x119448fa, 0x47e96422, 0xa8fc8cc4, 0xa0f03f1a, 0x567d2cd8, 0x223390ef,
+  0x87494ec7, 0xd938d1c1, 0x8ccaa2fe, 0x98d40b36, 0xa6f581cf, 0xa57ade28, 0xdab78e26, 0x3fadbfa4,
+  0x2c3a9de4, 0x5078920d, 0x6a5fcc9b, 0x547e4662, 0xf68d13c2, 0x90d8b8e8, 0x2e39f75e, 0x82c3aff5,
+  0x9f5d80be, 0x69d0937c, 0x6fd52da9, 0xcf2512b3, 0xc8ac993b, 0x10187da7, 0xe89c636e, 0xdb3bbb7b,
+  0xcd267809, 0x6e5918f4, 0xec9ab701, 0x834f9aa8, 0xe6956e65, 0xaaffe67e, 0x21bccf08, 0xef15e8e6,
+  0xbae79bd9, 0x4a6f36ce, 0xea9f09d4, 0x29b07cd6, 0x31a4b2af, 0x2a3f2331, 0xc6a59430, 0x35a266c0,
+  0x744ebc37, 0xfc82caa6, 0xe090d0b0, 0x33a7d815, 0xf104984a, 0x41ecdaf7, 0x7fcd500e, 0x1791f62f,
+  0x764dd68d, 0x43efb04d, 0xccaa4d54, 0xe49604df, 0x9ed1b5e3, 0x4c6a881b, 0xc12c1fb8, 0x4665517f,
+  0x9d5eea04, 0x018c355d, 0xfa877473, 0xfb0b412e, 0xb3671d5a, 0x92dbd252, 0xe9105633, 0x6dd64713,
+  0x9ad7618c, 0x37a10c7a, 0x59f8148e, 0xeb133c89, 0xcea927ee, 0xb761c935, 0xe11ce5ed, 0x7a47b13c,
+  0x9cd2df59, 0x55f2733f, 0x1814ce79, 0x73c737bf, 0x53f7cdea, 0x5ffdaa5b, 0xdf3d6f14, 0x7844db86,
+  0xcaaff381, 0xb968c43e, 0x3824342c, 0xc2a3405f, 0x161dc372, 0xbce2250c, 0x283c498b, 0xff0d9541,
+  0x39a80171, 0x080cb3de, 0xd8b4e49c, 0x6456c190, 0x7bcb8461, 0xd532b670, 0x486c5c74, 0xd0b85742
+};
 
-  for (c = 0; c < 4; ++c) {
-    state[c] ^= w[c] >> 24;
-    state[4+c] ^= w[c] >> 16;
-    state[8+c] ^= w[c] >> 8;
-    state[12+c] ^= w[c];
-  }
+static inline Guint rotateRight8(Guint x) {
+  return (x >> 8) | (x << 24);
+}
+
+static inline Guint rotateRight16(Guint x) {
+  return (x >> 16) | (x << 16);
+}
+
+static inline Guint rotateRight24(Guint x) {
+  return (x >> 24) | (x << 8);
 }
 
 static void aesKeyExpansion(DecryptAESState *s,
@@ -708,57 +791,198 @@ static void aesKeyExpansion(DecryptAESState *s,
   }
 }
 
-static void aesDecryptBlock(DecryptAESState *s, Guchar *in, GBool last) {
-  int c, round, n, i;
+// Decrypt the block at <in> into <out> with the <nRounds> round keys
+// in <w> (as set up by the key expansion functions), and undo the CBC
+// with the previous ciphertext block in <cbc>, which is then replaced
+// by <in>.  <in> and <out> may be the same.
+//
+// The state is kept as four column words, and each of the middle
+// rounds does InvShiftRows, InvSubBytes and InvMixColumns at once,
+// with lookups in invTab.
+static void aesDecryptRounds(Guint *w, int nRounds, Guchar *cbc,
+			     Guchar *in, Guchar *out) {
+  Guint s0, s1, s2, s3, t0, t1, t2, t3;
+  Guint *k;
+  Guchar c;
+  int round, i;
 
-  // initial state
-  for (c = 0; c < 4; ++c) {
-    s->state[c] = in[4*c];
-    s->state[4+c] = in[4*c+1];
-    s->state[8+c] = in[4*c+2];
-    s->state[12+c] = in[4*c+3];
+  // round 0
+  k = &w[nRounds * 4];
+  s0 = ((in[0] << 24) | (in[1] << 16) | (in[2] << 8) | in[3]) ^ k[0];
+  s1 = ((in[4] << 24) | (in[5] << 16) | (in[6] << 8) | in[7]) ^ k[1];
+  s2 = ((in[8] << 24) | (in[9] << 16) | (in[10] << 8) | in[11]) ^ k[2];
+  s3 = ((in[12] << 24) | (in[13] << 16) | (in[14] << 8) | in[15]) ^ k[3];
+
+  // rounds nRounds-1 .. 1
+  for (round = nRounds - 1; round >= 1; --round) {
+    k = &w[round * 4];
+    t0 = invTab[s0 >> 24] ^ rotateRight8(invTab[(s3 >> 16) & 0xff]) ^
+         rotateRight16(invTab[(s2 >> 8) & 0xff]) ^
+         rotateRight24(invTab[s1 & 0xff]) ^ k[0];
+    t1 = invTab[s1 >> 24] ^ rotateRight8(invTab[(s0 >> 16) & 0xff]) ^
+         rotateRight16(invTab[(s3 >> 8) & 0xff]) ^
+         rotateRight24(invTab[s2 & 0xff]) ^ k[1];
+    t2 = invTab[s2 >> 24] ^ rotateRight8(invTab[(s1 >> 16) & 0xff]) ^
+         rotateRight16(invTab[(s0 >> 8) & 0xff]) ^
+         rotateRight24(invTab[s3 & 0xff]) ^ k[2];
+    t3 = invTab[s3 >> 24] ^ rotateRight8(invTab[(s2 >> 16) & 0xff]) ^
+         rotateRight16(invTab[(s1 >> 8) & 0xff]) ^
+         rotateRight24(invTab[s0 & 0xff]) ^ k[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
   }
 
-  // round 0
-  addRoundKey(s->state, &s->w[10 * 4]);
-
-  // rounds 1-9
-  for (round = 9; round >= 1; --round) {
-    invSubBytes(s->state);
-    invShiftRows(s->state);
-    invMixColumns(s->state);
-    addRoundKey(s->state, &s->w[round * 4]);
+  // last round (no InvMixColumns)
+  k = &w[0];
+  t0 = ((invSbox[s0 >> 24] << 24) | (invSbox[(s3 >> 16) & 0xff] << 16) |
+	(invSbox[(s2 >> 8) & 0xff] << 8) | invSbox[s1 & 0xff]) ^ k[0];
+  t1 = ((invSbox[s1 >> 24] << 24) | (invSbox[(s0 >> 16) & 0xff] << 16) |
+	(invSbox[(s3 >> 8) & 0xff] << 8) | invSbox[s2 & 0xff]) ^ k[1];
+  t2 = ((invSbox[s2 >> 24] << 24) | (invSbox[(s1 >> 16) & 0xff] << 16) |
+	(invSbox[(s0 >> 8) & 0xff] << 8) | invSbox[s3 & 0xff]) ^ k[2];
+  t3 = ((invSbox[s3 >> 24] << 24) | (invSbox[(s2 >> 16) & 0xff] << 16) |
+	(invSbox[(s1 >> 8) & 0xff] << 8) | invSbox[s0 & 0xff]) ^ k[3];
+
+  // CBC -- the input block is saved for the next one before <out>
+  // (which may be the same) is written
+  for (i = 0; i < 4; ++i) {
+    c = in[i];
+    out[i] = cbc[i] ^ (Guchar)(t0 >> (24 - 8 * i));
+    cbc[i] = c;
+    c = in[4+i];
+    out[4+i] = cbc[4+i] ^ (Guchar)(t1 >> (24 - 8 * i));
+    cbc[4+i] = c;
+    c = in[8+i];
+    out[8+i] = cbc[8+i] ^ (Guchar)(t2 >> (24 - 8 * i));
+    cbc[8+i] = c;
+    c = in[12+i];
+    out[12+i] = cbc[12+i] ^ (Guchar)(t3 >> (24 - 8 * i));
+    cbc[12+i] = c;
   }
+}
 
-  // round 10
-  invSubBytes(s->state);
-  invShiftRows(s->state);
-  addRoundKey(s->state, &s->w[0]);
+#if DECRYPT_AESNI
 
-  // CBC
-  for (c = 0; c < 4; ++c) {
-    s->buf[4*c] = s->state[c] ^ s->cbc[4*c];
-    s->buf[4*c+1] = s->state[4+c] ^ s->cbc[4*c+1];
-    s->buf[4*c+2] = s->state[8+c] ^ s->cbc[4*c+2];
-    s->buf[4*c+3] = s->state[12+c] ^ s->cbc[4*c+3];
-  }
+static GBool aesniDetect() {
+#ifdef _MSC_VER
+  int info[4];
 
-  // save the input block for the next CBC
-  for (i = 0; i < 16; ++i) {
-    s->cbc[i] = in[i];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 25)) && (info[3] & (1 << 26));
+#else
+  unsigned int a, b, c, d;
+
+  if (!__get_cpuid(1, &a, &b, &c, &d)) {
+    return gFalse;
   }
+  return (c & (1 << 25)) && (d & (1 << 26));	// AES, SSE2
+#endif
+}
 
-  // remove padding
-  s->bufIdx = 0;
-  if (last) {
-    n = s->buf[15];
-    if (n < 1 || n > 16) { // this should never happen
-      n = 16;
+static const GBool aesniAvailable = aesniDetect();
+
+// Same as aesDecryptRounds, for the <n> bytes (a multiple of 16) at
+// <in>, with the AES-NI instructions.  The round keys in <w> are those
+// of the equivalent inverse cipher, which is what AESDEC expects.
+// Four blocks are decrypted at a time, to keep the AES unit busy.
+AESNI_TARGET
+static void aesniDecryptBlocks(Guint *w, int nRounds, Guchar *cbc,
+			       Guchar *in, Guchar *out, int n) {
+  __m128i k[15], iv, c0, c1, c2, c3, b0, b1, b2, b3;
+  Guchar key[16];
+  int round, i, j;
+
+  for (round = 0; round <= nRounds; ++round) {
+    for (j = 0; j < 16; ++j) {
+      key[j] = (Guchar)(w[round * 4 + j / 4] >> (24 - 8 * (j & 3)));
+    }
+    k[round] = _mm_loadu_si128((__m128i *)key);
+  }
+  iv = _mm_loadu_si128((__m128i *)cbc);
+
+  for (i = 0; i + 64 <= n; i += 64) {
+    c0 = _mm_loadu_si128((__m128i *)(in + i));
+    c1 = _mm_loadu_si128((__m128i *)(in + i + 16));
+    c2 = _mm_loadu_si128((__m128i *)(in + i + 32));
+    c3 = _mm_loadu_si128((__m128i *)(in + i + 48));
+    b0 = _mm_xor_si128(c0, k[nRounds]);
+    b1 = _mm_xor_si128(c1, k[nRounds]);
+    b2 = _mm_xor_si128(c2, k[nRounds]);
+    b3 = _mm_xor_si128(c3, k[nRounds]);
+    for (round = nRounds - 1; round >= 1; --round) {
+      b0 = _mm_aesdec_si128(b0, k[round]);
+      b1 = _mm_aesdec_si128(b1, k[round]);
+      b2 = _mm_aesdec_si128(b2, k[round]);
+      b3 = _mm_aesdec_si128(b3, k[round]);
     }
-    for (i = 15; i >= n; --i) {
-      s->buf[i] = s->buf[i-n];
+    b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, k[0]), iv);
+    b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1, k[0]), c0);
+    b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2, k[0]), c1);
+    b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3, k[0]), c2);
+    iv = c3;
+    _mm_storeu_si128((__m128i *)(out + i), b0);
+    _mm_storeu_si128((__m128i *)(out + i + 16), b1);
+    _mm_storeu_si128((__m128i *)(out + i + 32), b2);
+    _mm_storeu_si128((__m128i *)(out + i + 48), b3);
+  }
+  for (; i < n; i += 16) {
+    c0 = _mm_loadu_si128((__m128i *)(in + i));
+    b0 = _mm_xor_si128(c0, k[nRounds]);
+    for (round = nRounds - 1; round >= 1; --round) {
+      b0 = _mm_aesdec_si128(b0, k[round]);
     }
-    s->bufIdx = n;
+    b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, k[0]), iv);
+    iv = c0;
+    _mm_storeu_si128((__m128i *)(out + i), b0);
+  }
+  _mm_storeu_si128((__m128i *)cbc, iv);
+}
+
+#endif
+
+// Remove the padding from the last block in <buf>, moving the data to
+// the end of the block.  Returns the index of the first data byte.
+static int aesRemovePadding(Guchar *buf) {
+  int n, i;
+
+  n = buf[15];
+  if (n < 1 || n > 16) { // this should never happen
+    n = 16;
+  }
+  for (i = 15; i >= n; --i) {
+    buf[i] = buf[i-n];
+  }
+  return n;
+}
+
+static void aesDecryptBlock(DecryptAESState *s, Guchar *in, GBool last) {
+#if DECRYPT_AESNI
+  if (aesniAvailable) {
+    aesniDecryptBlocks(s->w, 10, s->cbc, in, s->buf, 16);
+  } else {
+    aesDecryptRounds(s->w, 10, s->cbc, in, s->buf);
+  }
+#else
+  aesDecryptRounds(s->w, 10, s->cbc, in, s->buf);
+#endif
+  s->bufIdx = last ? aesRemovePadding(s->buf) : 0;
+}
+
+// Decrypt <n> bytes (a multiple of 16) in <buf>, in place.  These must
+// not include the last block of the stream.
+static void aesDecryptBlocks(DecryptAESState *s, Guchar *buf, int n) {
+  int i;
+
+#if DECRYPT_AESNI
+  if (aesniAvailable) {
+    aesniDecryptBlocks(s->w, 10, s->cbc, buf, buf, n);
+    return;
+  }
+#endif
+  for (i = 0; i < n; i += 16) {
+    aesDecryptRounds(s->w, 10, s->cbc, buf + i, buf + i);
   }
 }
 
@@ -792,61 +1016,31 @@ static void aes256KeyExpansion(DecryptAES256State *s,
 }
 
 static void aes256DecryptBlock(DecryptAES256State *s, Guchar *in, GBool last) {
-  int c, round, n, i;
-
-  // initial state
-  for (c = 0; c < 4; ++c) {
-    s->state[c] = in[4*c];
-    s->state[4+c] = in[4*c+1];
-    s->state[8+c] = in[4*c+2];
-    s->state[12+c] = in[4*c+3];
-  }
-
-  // round 0
-  addRoundKey(s->state, &s->w[14 * 4]);
-
-  // rounds 13-1
-  for (round = 13; round >= 1; --round) {
-    invSubBytes(s->state);
-    invShiftRows(s->state);
-    invMixColumns(s->state);
-    addRoundKey(s->state, &s->w[round * 4]);
+#if DECRYPT_AESNI
+  if (aesniAvailable) {
+    aesniDecryptBlocks(s->w, 14, s->cbc, in, s->buf, 16);
+  } else {
+    aesDecryptRounds(s->w, 14, s->cbc, in, s->buf);
   }
+#else
+  aesDecryptRounds(s->w, 14, s->cbc, in, s->buf);
+#endif
+  s->bufIdx = last ? aesRemovePadding(s->buf) : 0;
+}
 
-  // round 14
-  invSubBytes(s->state);
-  invShiftRows(s->state);
-  addRoundKey(s->state, &s->w[0]);
-
-  // CBC
-  for (c = 0; c < 4; ++c) {
-    s->buf[4*c] = s->state[c] ^ s->cbc[4*c];
-    s->buf[4*c+1] = s->state[4+c] ^ s->cbc[4*c+1];
-    s->buf[4*c+2] = s->state[8+c] ^ s->cbc[4*c+2];
-    s->buf[4*c+3] = s->state[12+c] ^ s->cbc[4*c+3];
-  }
+// Decrypt <n> bytes (a multiple of 16) in <buf>, in place.  These must
+// not include the last block of the stream.
+static void aes256DecryptBlocks(DecryptAES256State *s, Guchar *buf, int n) {
+  int i;
 
-  // save the input block for the next CBC
-  for (i = 0; i < 16; ++i) {
-    s->cbc[i] = in[i];
+#if DECRYPT_AESNI
+  if (aesniAvailable) {
+    aesniDecryptBlocks(s->w, 14, s->cbc, buf, buf, n);
+    return;
   }
-
-  // remove padding
-  s->bufIdx = 0;
-  if (last) {
-    n = s->buf[15];
-    if (n < 1 || n > 16) { // this should never happen
-      n = 16;
-    }
-    for (i = 15; i >= n; --i) {
-      s->buf[i] = s->buf[i-n];
-    }
-    s->bufIdx = n;
-    if (n > 16)
-    {
-      error(errSyntaxError, -1, "Reducing bufIdx from {0:d} to 16 to not crash", n);
-      s->bufIdx = 16;
-    }
+#endif
+  for (i = 0; i < n; i += 16) {
+    aesDecryptRounds(s->w, 14, s->cbc, buf + i, buf + i);
   }
 }
 
@@ -53,6 +53,13 @@ public:
 			   Guchar *fileKey, GBool encryptMetadata,
 			   GBool *ownerPasswordOk);
 
+  // Generate the key of object <objNum>, <objGen> from the file key.
+  // The <objKey> buffer must have space for at least 32 bytes.
+  // Returns the length of the object key.
+  static int makeObjectKey(CryptAlgorithm algo, Guchar *fileKey,
+			   int keyLength, int objNum, int objGen,
+			   Guchar *objKey);
+
 private:
 
   static GBool makeFileKey2(int encVersion, int encRevision, int keyLength,
@@ -69,12 +76,10 @@ private:
 struct DecryptRC4State {
   Guchar state[256];
   Guchar x, y;
-  int buf;
 };
 
 struct DecryptAESState {
   Guint w[44];
-  Guchar state[16];
   Guchar cbc[16];
   Guchar buf[16];
   int bufIdx;
@@ -82,33 +87,55 @@ struct DecryptAESState {
 
 struct DecryptAES256State {
   Guint w[60];
-  Guchar state[16];
   Guchar cbc[16];
   Guchar buf[16];
   int bufIdx;
 };
 
+#define decryptStreamBufSize 4096
+
 class DecryptStream: public FilterStream {
 public:
 
   DecryptStream(Stream *strA, Guchar *fileKey,
 		CryptAlgorithm algoA, int keyLength,
 		int objNum, int objGen);
+  // Decrypt with an object key made by Decrypt::makeObjectKey().
+  DecryptStream(Stream *strA, Guchar *objKeyA, int objKeyLengthA,
+		CryptAlgorithm algoA);
   virtual ~DecryptStream();
   virtual StreamKind getKind() { return strWeird; }
   virtual void reset();
-  virtual int getChar();
-  virtual int lookChar();
+  virtual int getChar()
+    { if (bufPtr >= bufEnd && !fillBuf()) return EOF;
+      ++charactersRead; return *bufPtr++; }
+  virtual int lookChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : *bufPtr; }
   virtual int getPos();
   virtual GBool isBinary(GBool last);
   virtual Stream *getUndecodedStream() { return this; }
+  virtual const Guchar *peekChars(int *len)
+    { *len = (bufPtr >= bufEnd && !fillBuf()) ? 0 : (int)(bufEnd - bufPtr);
+      return bufPtr; }
+  virtual void skipPeekedChars(int n)
+    { bufPtr += n; charactersRead += n; }
 
 private:
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
+  void init(CryptAlgorithm algoA, Guchar *objKeyA, int objKeyLengthA);
+  GBool fillBuf();
+  int decrypt(int nChars, Guchar *buffer);
+
   CryptAlgorithm algo;
   int objKeyLength;
   Guchar objKey[32];
   int charactersRead; // so that getPos() can be correct
+  Guchar buf[decryptStreamBufSize];	// decrypted data
+  Guchar *bufPtr;		// next char to read
+  Guchar *bufEnd;		// end of buffer
 
   union {
     DecryptRC4State rc4;
@@ -121,6 +148,8 @@ private:
 
 extern void rc4InitKey(Guchar *key, int keyLen, Guchar *state);
 extern Guchar rc4DecryptByte(Guchar *state, Guchar *x, Guchar *y, Guchar c);
+extern void rc4Decrypt(Guchar *state, Guchar *x, Guchar *y,
+		       Guchar *buf, int n);
 extern void md5(Guchar *msg, int msgLen, Guchar *digest);
 
 #endif
@@ -43,6 +43,12 @@
 // Dict
 //------------------------------------------------------------------------
 
+#if MULTITHREADED
+#  define dictLocker()   MutexLocker locker(&mutex)
+#else
+#  define dictLocker()
+#endif
+
 static const int SORT_LENGTH_LOWER_LIMIT = 32;
 
 static inline bool cmpDictEntries(const DictEntry &e1, const DictEntry &e2)
@@ -74,9 +80,15 @@ Dict::Dict(XRef *xrefA) {
   size = length = 0;
   ref = 1;
   sorted = gFalse;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 }
 
 Dict::Dict(Dict* dictA) {
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
   xref = dictA->xref;
   size = length = dictA->length;
   ref = 1;
@@ -84,7 +96,7 @@ Dict::Dict(Dict* dictA) {
   sorted = dictA->sorted;
   entries = (DictEntry *)gmallocn(size, sizeof(DictEntry));
   for (int i=0; i<length; i++) {
-    entries[i].key = strdup(dictA->entries[i].key);
+    entries[i].key = copyName(dictA->entries[i].key);
     dictA->entries[i].val.copy(&entries[i].val);
   }
 }
@@ -93,13 +105,35 @@ Dict::~Dict() {
   int i;
 
   for (i = 0; i < length; ++i) {
-    gfree(entries[i].key);
+    freeName(entries[i].key);
     entries[i].val.free();
   }
   gfree(entries);
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+int Dict::incRef() {
+  dictLocker();
+  return ++ref;
+}
+
+int Dict::decRef() {
+  dictLocker();
+  return --ref;
 }
 
 void Dict::add(char *key, Object *val) {
+  const char *atom;
+
+  dictLocker();
+  // keys that match an atom are always stored as the atom, so that
+  // find() can compare them by pointer
+  if (!isAtom(key) && (atom = atomLookup(key))) {
+    gfree(key);
+    key = (char *)atom;
+  }
   if (sorted) {
     // We use add on very few occasions so
     // virtually this will never be hit
@@ -120,6 +154,7 @@ void Dict::add(char *key, Object *val) {
 }
 
 inline DictEntry *Dict::find(const char *key) {
+  dictLocker();
   if (!sorted && length >= SORT_LENGTH_LOWER_LIMIT)
   {
       sorted = gTrue;
@@ -134,9 +169,17 @@ inline DictEntry *Dict::find(const char *key) {
   } else {
     int i;
 
-    for (i = length - 1; i >=0; --i) {
-      if (!strcmp(key, entries[i].key))
-        return &entries[i];
+    if (isAtom(key)) {
+      // keys equal to an atom are stored as that atom
+      for (i = length - 1; i >=0; --i) {
+        if (entries[i].key == key)
+          return &entries[i];
+      }
+    } else {
+      for (i = length - 1; i >=0; --i) {
+        if (!strcmp(key, entries[i].key))
+          return &entries[i];
+      }
     }
   }
   return NULL;
@@ -147,6 +190,7 @@ GBool Dict::hasKey(const char *key) {
 }
 
 void Dict::remove(const char *key) {
+  dictLocker();
   if (sorted) {
     const int pos = binarySearch(key, entries, length);
     if (pos != -1) {
@@ -178,6 +222,7 @@ void Dict::remove(const char *key) {
 
 void Dict::set(const char *key, Object *val) {
   DictEntry *e;
+  dictLocker();
   if (val->isNull()) {
     remove(key);
     return;
@@ -187,15 +232,16 @@ void Dict::set(const char *key, Object *val) {
     e->val.free();
     e->val = *val;
   } else {
-    add (copyString(key), val);
+    add (copyName(key), val);
   }
 }
 
 
 GBool Dict::is(const char *type) {
+  static const char *typeAtom = atomLookup("Type");
   DictEntry *e;
 
-  return (e = find("Type")) && e->val.isName(type);
+  return (e = find(typeAtom)) && e->val.isName(type);
 }
 
 Object *Dict::lookup(const char *key, Object *obj, int recursion) {
@@ -31,14 +31,19 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
 #include "Object.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 //------------------------------------------------------------------------
 // Dict
 //------------------------------------------------------------------------
 
 struct DictEntry {
-  char *key;
+  char *key;			// may be an atom
   Object val;
 };
 
@@ -53,13 +58,14 @@ public:
   ~Dict();
 
   // Reference counting.
-  int incRef() { return ++ref; }
-  int decRef() { return --ref; }
+  int incRef();
+  int decRef();
 
   // Get number of entries.
   int getLength() { return length; }
 
-  // Add an entry.  NB: does not copy key.
+  // Add an entry.  NB: does not copy key; a key that matches an atom
+  // is freed and replaced by the atom.
   void add(char *key, Object *val);
 
   // Update the value of an existing entry, otherwise create it
@@ -71,7 +77,8 @@ public:
   GBool is(const char *type);
 
   // Look up an entry and return the value.  Returns a null object
-  // if <key> is not in the dictionary.
+  // if <key> is not in the dictionary.  Looking up an atom (see
+  // atomLookup) only compares pointers.
   Object *lookup(const char *key, Object *obj, int recursion = 0);
   Object *lookupNF(const char *key, Object *obj);
   GBool lookupInt(const char *key, const char *alt_key, int *value);
@@ -98,6 +105,9 @@ private:
   int size;			// size of <entries> array
   int length;			// number of entries in dictionary
   int ref;			// reference count
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
 
   DictEntry *find(const char *key);
 };
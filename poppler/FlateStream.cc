@@ -9,108 +9,183 @@
 //
 //========================================================================
 #include "FlateStream.h"
-FlateStream::FlateStream(Stream *strA, int predictor, int columns, int colors, int bits) :
-  FilterStream(strA)
-{
+
+FlateZlibStream::FlateZlibStream(Stream *strA, int predictor, int columns,
+				 int colors, int bits):
+    FilterStream(strA) {
   if (predictor != 1) {
     pred = new StreamPredictor(this, predictor, columns, colors, bits);
+    if (!pred->isOk()) {
+      delete pred;
+      pred = NULL;
+    }
   } else {
     pred = NULL;
   }
-  out_pos = 0;
-  memset(&d_stream, 0, sizeof(d_stream));
-  inflateInit(&d_stream);
+  // raw deflate data: the zlib header is read by reset()
+  memset(&zstr, 0, sizeof(zstr));
+  zstrOk = inflateInit2(&zstr, -MAX_WBITS) == Z_OK;
+  eof = gTrue;
+  outPos = outEnd = 0;
 }
 
-FlateStream::~FlateStream() {
-  inflateEnd(&d_stream);
+FlateZlibStream::~FlateZlibStream() {
+  if (zstrOk) {
+    inflateEnd(&zstr);
+  }
   delete pred;
   delete str;
 }
 
-void FlateStream::reset() {
-  //FIXME: what are the semantics of reset?
-  //i.e. how much intialization has to happen in the constructor?
-
-  /* reinitialize zlib */
-  inflateEnd(&d_stream);
-  memset(&d_stream, 0, sizeof(d_stream));
-  inflateInit(&d_stream);
+void FlateZlibStream::reset() {
+  int cmf, flg;
 
   str->reset();
-  d_stream.avail_in = 0;
-  status = Z_OK;
-  out_pos = 0;
-  out_buf_len = 0;
-}
+  outPos = outEnd = 0;
+  eof = gTrue;
+  if (!zstrOk) {
+    error(errInternal, getPos(), "Couldn't initialize zlib");
+    return;
+  }
+  inflateReset(&zstr);
+  zstr.avail_in = 0;
+
+  // read header
+  cmf = str->getChar();
+  flg = str->getChar();
+  if (cmf == EOF || flg == EOF)
+    return;
+  if ((cmf & 0x0f) != 0x08) {
+    error(errSyntaxError, getPos(), "Unknown compression method in flate stream");
+    return;
+  }
+  if ((((cmf << 8) + flg) % 31) != 0) {
+    error(errSyntaxError, getPos(), "Bad FCHECK in flate stream");
+    return;
+  }
+  if (flg & 0x20) {
+    error(errSyntaxError, getPos(), "FDICT bit set in flate stream");
+    return;
+  }
 
-int FlateStream::getRawChar() {
-  return doGetRawChar();
+  eof = gFalse;
 }
 
-void FlateStream::getRawChars(int nChars, int *buffer) {
-  for (int i = 0; i < nChars; ++i)
-    buffer[i] = doGetRawChar();
+int FlateZlibStream::getRawChar() {
+  return doGetRawChar();
 }
 
-int FlateStream::getChar() {
+int FlateZlibStream::getChar() {
   if (pred)
     return pred->getChar();
   else
     return getRawChar();
 }
 
-int FlateStream::lookChar() {
+int FlateZlibStream::getChars(int nChars, Guchar *buffer) {
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  return getRawChars(nChars, buffer);
+}
+
+int FlateZlibStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  for (n = 0; n < nChars; n += m) {
+    if (outPos >= outEnd && !fillBuf()) {
+      break;
+    }
+    m = outEnd - outPos;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, outBuf + outPos, m);
+    outPos += m;
+  }
+  return n;
+}
+
+int FlateZlibStream::lookChar() {
   if (pred)
     return pred->lookChar();
 
-  if (fill_buffer())
+  if (outPos >= outEnd && !fillBuf())
     return EOF;
 
-  return out_buf[out_pos];
+  return outBuf[outPos];
 }
 
-int FlateStream::fill_buffer() {
-  /* only fill the buffer if it has all been used */
-  if (out_pos >= out_buf_len) {
-    /* check if the flatestream has been exhausted */
-    if (status == Z_STREAM_END) {
-      return -1;
-    }
+const Guchar *FlateZlibStream::peekChars(int *len) {
+  if (pred) {
+    return NULL;
+  }
+  if (outPos >= outEnd && !fillBuf()) {
+    *len = 0;
+  } else {
+    *len = outEnd - outPos;
+  }
+  return outBuf + outPos;
+}
 
-    /* set to the begining of out_buf */
-    d_stream.avail_out = sizeof(out_buf);
-    d_stream.next_out = out_buf;
-    out_pos = 0;
-
-    while (1) {
-      /* buffer is empty so we need to fill it */
-      if (d_stream.avail_in == 0) {
-	int c;
-	/* read from the source stream */
-	while (d_stream.avail_in < sizeof(in_buf) && (c = str->getChar()) != EOF) {
-	  in_buf[d_stream.avail_in++] = c;
-	}
-	d_stream.next_in = in_buf;
-      }
+void FlateZlibStream::skipPeekedChars(int n) {
+  outPos += n;
+}
 
-      /* keep decompressing until we can't anymore */
-      if (d_stream.avail_out == 0 || d_stream.avail_in == 0 || (status != Z_OK && status != Z_BUF_ERROR))
+// Decode into the (empty) output buffer.  Returns false if nothing is
+// left; after an error, the characters decoded before it are
+// returned, and the stream ends there.
+GBool FlateZlibStream::fillBuf() {
+  const Guchar *p;
+  int n, c, ret;
+
+  outPos = outEnd = 0;
+  if (eof) {
+    return gFalse;
+  }
+  zstr.next_out = outBuf;
+  zstr.avail_out = flateZlibBufSize;
+  while (zstr.avail_out > 0) {
+    // input is taken straight from the underlying stream's buffer, and
+    // what zlib doesn't use is left there; a byte read with getChar()
+    // may be left over from the previous call
+    p = NULL;
+    if (zstr.avail_in == 0) {
+      if ((p = str->peekChars(&n))) {
+	zstr.next_in = (Bytef *)p;
+	zstr.avail_in = n;
+      } else if ((c = str->getChar()) != EOF) {
+	inBuf[0] = (Guchar)c;
+	zstr.next_in = inBuf;
+	zstr.avail_in = 1;
+      }
+      if (zstr.avail_in == 0) {
+	error(errSyntaxError, getPos(), "Unexpected end of file in flate stream");
+	eof = gTrue;
 	break;
-      status = inflate(&d_stream, Z_SYNC_FLUSH);
+      }
+    }
+    ret = inflate(&zstr, Z_NO_FLUSH);
+    if (p) {
+      str->skipPeekedChars(n - zstr.avail_in);
+      zstr.avail_in = 0;
+    }
+    if (ret == Z_STREAM_END) {
+      eof = gTrue;
+      break;
+    }
+    if (ret != Z_OK) {
+      error(errSyntaxError, getPos(), "Bad data in flate stream: {0:s}",
+	    zstr.msg ? zstr.msg : "unknown error");
+      eof = gTrue;
+      break;
     }
-
-    out_buf_len = sizeof(out_buf) - d_stream.avail_out;
-    if (status != Z_OK && status != Z_STREAM_END)
-      return -1;
-    if (!out_buf_len)
-      return -1;
   }
-
-  return 0;
+  outEnd = flateZlibBufSize - zstr.avail_out;
+  return outEnd > 0;
 }
 
-GooString *FlateStream::getPSFilter(int psLevel, const char *indent) {
+GooString *FlateZlibStream::getPSFilter(int psLevel, const char *indent) {
   GooString *s;
 
   if (psLevel < 3 || pred) {
@@ -123,6 +198,6 @@ GooString *FlateStream::getPSFilter(int psLevel, const char *indent) {
   return s;
 }
 
-GBool FlateStream::isBinary(GBool last) {
+GBool FlateZlibStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
@@ -41,37 +41,59 @@ extern "C" {
 #include <zlib.h>
 }
 
-class FlateStream: public FilterStream {
+//------------------------------------------------------------------------
+// FlateZlibStream
+//
+// A Flate decoder built on zlib, used instead of FlateStream if
+// GlobalParams::getFlateUseZlib() is set.  Errors are handled like in
+// FlateStream: the zlib header is checked the same way, the Adler-32
+// checksum is ignored, and the data decoded before an error in a
+// damaged stream is returned.
+//------------------------------------------------------------------------
+
+#define flateZlibBufSize 16384
+
+class FlateZlibStream: public FilterStream {
 public:
 
-  FlateStream(Stream *strA, int predictor, int columns, int colors, int bits);
-  virtual ~FlateStream();
+  FlateZlibStream(Stream *strA, int predictor, int columns,
+		  int colors, int bits);
+  virtual ~FlateZlibStream();
   virtual StreamKind getKind() { return strFlate; }
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
-  virtual void getRawChars(int nChars, int *buffer);
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, const char *indent);
   virtual GBool isBinary(GBool last = gTrue);
+  virtual const Guchar *peekChars(int *len);
+  virtual void skipPeekedChars(int n);
 
 private:
   inline int doGetRawChar() {
-    if (fill_buffer())
+    if (outPos >= outEnd && !fillBuf())
       return EOF;
-
-    return out_buf[out_pos++];
+    return outBuf[outPos++];
   }
 
-  int fill_buffer(void);
-  z_stream d_stream;
-  StreamPredictor *pred;
-  int status;
-  /* in_buf currently needs to be 1 or we over read from EmbedStreams */
-  unsigned char in_buf[1];
-  unsigned char out_buf[4096];
-  int out_pos;
-  int out_buf_len;
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
+  GBool fillBuf();
+
+  z_stream zstr;
+  GBool zstrOk;			// set if zstr was initialized
+  StreamPredictor *pred;	// predictor
+  GBool eof;			// set when the end of the data (or an
+				//   error) is reached
+  Guchar inBuf[1];		// input, if the underlying stream can't
+				//   be peeked at: one byte at a time, so
+				//   that nothing past the end of the data
+				//   is read (inline images)
+  Guchar outBuf[flateZlibBufSize];
+  int outPos;			// current index into outBuf
+  int outEnd;			// end of the valid data in outBuf
 };
 
 #endif
@@ -53,18 +53,21 @@
 #include <stddef.h>
 #include <string.h>
 #include <math.h>
+#include <assert.h>
 #include "goo/gmem.h"
 #include "goo/GooTimer.h"
 #include "goo/GooHash.h"
 #include "GlobalParams.h"
 #include "CharTypes.h"
 #include "Object.h"
+#include "Atom.h"
 #include "PDFDoc.h"
 #include "Array.h"
 #include "Dict.h"
 #include "Stream.h"
 #include "Lexer.h"
 #include "Parser.h"
+#include "GfxFormCache.h"
 #include "GfxFont.h"
 #include "GfxState.h"
 #include "OutputDev.h"
@@ -308,6 +311,32 @@ Operator Gfx::opTab[] = {
 
 #define numOps (sizeof(opTab) / sizeof(Operator))
 
+#ifndef NDEBUG
+// findOp() relies on opTab listing the operators in the order of their
+// atom slots (see Atom.h): check that the two tables agree.
+static GBool opTabMatchesAtoms(Operator *tab, int n) {
+  const char *atom;
+  int i;
+
+  if (n != atomNumOperators) {
+    return gFalse;
+  }
+  for (i = 0; i < n; ++i) {
+    if (!(atom = atomLookup(tab[i].name)) || atomOperatorIndex(atom) != i) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+// The tables are constant: check them for the first Gfx only.
+static GBool opTabMatchesAtomsOnce(Operator *tab, int n) {
+  static const GBool ok = opTabMatchesAtoms(tab, n);
+
+  return ok;
+}
+#endif
+
 static inline GBool isSameGfxColor(const GfxColor &colorA, const GfxColor &colorB, Guint nComps, double delta) {
   for (Guint k = 0; k < nComps; ++k) {
     if (abs(colorA.c[k] - colorB.c[k]) > delta) {
@@ -540,6 +569,8 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, int pageNum, Dict *resDict,
 {
   int i;
 
+  assert(opTabMatchesAtomsOnce(opTab, numOps));
+
   doc = docA;
   xref = doc->getXRef();
   catalog = doc->getCatalog();
@@ -570,6 +601,8 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, int pageNum, Dict *resDict,
   textClipBBoxEmpty = gTrue;
   ocState = gTrue;
   parser = NULL;
+  replay = NULL;
+  replayPos = 0;
   abortCheckCbk = abortCheckCbkA;
   abortCheckCbkData = abortCheckCbkDataA;
 
@@ -596,6 +629,8 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, Dict *resDict,
 {
   int i;
 
+  assert(opTabMatchesAtomsOnce(opTab, numOps));
+
   doc = docA;
   xref = doc->getXRef();
   catalog = doc->getCatalog();
@@ -623,6 +658,8 @@ Gfx::Gfx(PDFDoc *docA, OutputDev *outA, Dict *resDict,
   textClipBBoxEmpty = gTrue;
   ocState = gTrue;
   parser = NULL;
+  replay = NULL;
+  replayPos = 0;
   abortCheckCbk = abortCheckCbkA;
   abortCheckCbkData = abortCheckCbkDataA;
 
@@ -661,8 +698,9 @@ Gfx::~Gfx() {
 }
 
 void Gfx::display(Object *obj, GBool topLevel) {
+  GfxFormContent *oldReplay;
   Object obj2;
-  int i;
+  int oldReplayPos, i;
 
   if (obj->isArray()) {
     for (i = 0; i < obj->arrayGetLength(); ++i) {
@@ -678,10 +716,57 @@ void Gfx::display(Object *obj, GBool topLevel) {
     error(errSyntaxError, -1, "Weird page contents");
     return;
   }
+  oldReplay = replay;
+  oldReplayPos = replayPos;
+  replay = NULL;
   parser = new Parser(xref, new Lexer(xref, obj), gFalse);
+  // operands only live until their operator has been executed
+  parser->enableArena();
   go(topLevel);
   delete parser;
   parser = NULL;
+  replay = oldReplay;
+  replayPos = oldReplayPos;
+}
+
+// Run the tokenized content of a form.
+void Gfx::replayForm(GfxFormContent *content) {
+  Parser *oldParser;
+  GfxFormContent *oldReplay;
+  int oldReplayPos;
+
+  oldParser = parser;
+  oldReplay = replay;
+  oldReplayPos = replayPos;
+  parser = NULL;
+  replay = content;
+  replayPos = 0;
+  go(gFalse);
+  parser = oldParser;
+  replay = oldReplay;
+  replayPos = oldReplayPos;
+}
+
+// Get the next object, either from the parser or from the form
+// content being replayed.
+inline void Gfx::getContentObj(Object *obj) {
+  if (replay) {
+    if (replayPos < replay->nObjs) {
+      *obj = replay->objs[replayPos++];
+    } else {
+      obj->initEOF();
+    }
+  } else {
+    parser->getObj(obj);
+  }
+}
+
+// Free an object returned by getContentObj().  Replayed objects are
+// owned by the form cache.
+inline void Gfx::freeContentObj(Object *obj) {
+  if (!replay) {
+    obj->free();
+  }
 }
 
 void Gfx::go(GBool topLevel) {
@@ -695,7 +780,7 @@ void Gfx::go(GBool topLevel) {
   updateLevel = 1; // make sure even empty pages trigger a call to dump()
   lastAbortCheck = 0;
   numArgs = 0;
-  parser->getObj(&obj);
+  getContentObj(&obj);
   while (!obj.isEOF()) {
     commandAborted = gFalse;
 
@@ -734,10 +819,13 @@ void Gfx::go(GBool topLevel) {
 	  data_p->addElement(timer.getElapsed ());
 	}
       }
-      obj.free();
+      freeContentObj(&obj);
       for (i = 0; i < numArgs; ++i)
-	args[i].free();
+	freeContentObj(&args[i]);
       numArgs = 0;
+      if (parser) {
+	parser->resetArena();
+      }
 
       // periodically update display
       if (++updateLevel >= 20000) {
@@ -776,13 +864,20 @@ void Gfx::go(GBool topLevel) {
 	printf("\n");
 	fflush(stdout);
       }
-      obj.free();
+      freeContentObj(&obj);
+      // without an operator the arena would never be reset: move the
+      // pending args to the heap so that it can be
+      if (parser && !replay) {
+	for (i = 0; i < numArgs; ++i)
+	  args[i].moveToHeap();
+	parser->resetArena();
+      }
     }
 
     // grab the next object
-    parser->getObj(&obj);
+    getContentObj(&obj);
   }
-  obj.free();
+  freeContentObj(&obj);
 
   // args at end with no command
   if (numArgs > 0) {
@@ -797,7 +892,7 @@ void Gfx::go(GBool topLevel) {
       fflush(stdout);
     }
     for (i = 0; i < numArgs; ++i)
-      args[i].free();
+      freeContentObj(&args[i]);
   }
 
   popStateGuard();
@@ -858,25 +953,15 @@ void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
 }
 
 Operator *Gfx::findOp(char *name) {
-  int a, b, m, cmp;
-
-  a = -1;
-  b = numOps;
-  cmp = 0; // make gcc happy
-  // invariant: opTab[a] < name < opTab[b]
-  while (b - a > 1) {
-    m = (a + b) / 2;
-    cmp = strcmp(opTab[m].name, name);
-    if (cmp < 0)
-      a = m;
-    else if (cmp > 0)
-      b = m;
-    else
-      a = b = m;
-  }
-  if (cmp != 0)
+  int i;
+
+  // the lexer interns command names, so every known operator arrives
+  // as its atom, whose slot number is the operator's index in opTab
+  // (opTab lists the same operators in the same order, see Atom.h)
+  if ((i = atomOperatorIndex(name)) < 0 || i >= (int)numOps) {
     return NULL;
-  return &opTab[a];
+  }
+  return &opTab[i];
 }
 
 GBool Gfx::checkArg(Object *arg, TchkType type) {
@@ -4124,7 +4209,7 @@ void Gfx::opXObject(Object args[], int numArgs) {
     if (out->useDrawForm() && refObj.isRef()) {
       out->drawForm(refObj.getRef());
     } else {
-      doForm(&obj1);
+      doForm(&obj1, &refObj);
     }
     refObj.free();
   } else if (obj2.isName("PS")) {
@@ -4164,6 +4249,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
   GBool maskInterpolate;
   Stream *maskStr;
   Object obj1, obj2;
+  int scaleDenom;
   int i, n;
 
   // get info from the stream
@@ -4558,8 +4644,21 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
 	out->drawMaskedImage(state, ref, str, width, height, colorMap, interpolate,
 			     maskStr, maskWidth, maskHeight, maskInvert, maskInterpolate);
       } else {
-	out->drawImage(state, ref, str, width, height, colorMap, interpolate,
-		       haveColorKeyMask ? maskColors : (int *)NULL, inlineImg);
+	// if the device asks for it, have the image decoded at a reduced
+	// size (not with a color key mask, which needs the exact colors)
+	scaleDenom = haveColorKeyMask ? 1
+	                              : out->getImageScaleDenom(state, width,
+								height);
+	if (scaleDenom > 1 &&
+	    (scaleDenom = str->setImageScaleDenom(scaleDenom)) > 1) {
+	  out->drawImage(state, ref, str, (width + scaleDenom - 1) / scaleDenom,
+			 (height + scaleDenom - 1) / scaleDenom, colorMap,
+			 interpolate, NULL, inlineImg);
+	  str->setImageScaleDenom(1);
+	} else {
+	  out->drawImage(state, ref, str, width, height, colorMap, interpolate,
+			 haveColorKeyMask ? maskColors : (int *)NULL, inlineImg);
+	}
       }
     }
     delete colorMap;
@@ -4643,7 +4742,7 @@ GBool Gfx::checkTransparencyGroup(Dict *resDict) {
   return transpGroup;
 }
 
-void Gfx::doForm(Object *str) {
+void Gfx::doForm(Object *str, Object *ref) {
   Dict *dict;
   GBool transpGroup, isolated, knockout;
   GfxColorSpace *blendingColorSpace;
@@ -4651,6 +4750,7 @@ void Gfx::doForm(Object *str) {
   double m[6], bbox[4];
   Object resObj;
   Dict *resDict;
+  Ref formRef;
   GBool ocSaved;
   Object obj1, obj2, obj3;
   int i;
@@ -4748,9 +4848,13 @@ void Gfx::doForm(Object *str) {
   obj1.free();
 
   // draw it
+  if (ref->isRef()) {
+    formRef = ref->getRef();
+  }
   ++formDepth;
   drawForm(str, resDict, m, bbox,
-	  transpGroup, gFalse, blendingColorSpace, isolated, knockout);
+	  transpGroup, gFalse, blendingColorSpace, isolated, knockout,
+	  gFalse, NULL, NULL, ref->isRef() ? &formRef : (Ref *)NULL);
   --formDepth;
 
   if (blendingColorSpace) {
@@ -4766,8 +4870,9 @@ void Gfx::drawForm(Object *str, Dict *resDict, double *matrix, double *bbox,
 		  GfxColorSpace *blendingColorSpace,
 		  GBool isolated, GBool knockout,
 		  GBool alpha, Function *transferFunc,
-		  GfxColor *backdropColor) {
+		  GfxColor *backdropColor, Ref *formRef) {
   Parser *oldParser;
+  GfxFormContent *content;
   GfxState *savedState;
   double oldBaseMatrix[6];
   int i;
@@ -4827,8 +4932,17 @@ void Gfx::drawForm(Object *str, Dict *resDict, double *matrix, double *bbox,
   GfxState *stateBefore = state;
 
   // draw the form
-  display(str, gFalse);
-  
+  content = NULL;
+  if (formRef) {
+    content = xref->getFormCache()->get(xref, *formRef, str);
+  }
+  if (content) {
+    replayForm(content);
+    xref->getFormCache()->release(content);
+  } else {
+    display(str, gFalse);
+  }
+
   if (stateBefore != state) {
     if (state->isParentState(stateBefore)) {
       error(errSyntaxError, -1, "There's a form with more q than Q, trying to fix");
@@ -4910,13 +5024,14 @@ Stream *Gfx::buildImageStream() {
       error(errSyntaxError, getPos(), "Inline image dictionary key must be a name object");
       obj.free();
     } else {
-      key = copyString(obj.getName());
+      key = copyName(obj.getName());
       obj.free();
       parser->getObj(&obj);
       if (obj.isEOF() || obj.isError()) {
-	gfree(key);
+	freeName(key);
 	break;
       }
+      obj.moveToHeap();
       dict.dictAdd(key, &obj);
     }
     parser->getObj(&obj);
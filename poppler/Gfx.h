@@ -49,6 +49,7 @@ class XRef;
 class Array;
 class Stream;
 class Parser;
+struct GfxFormContent;
 class Dict;
 class Function;
 class OutputDev;
@@ -183,12 +184,14 @@ public:
 
   GBool checkTransparencyGroup(Dict *resDict);
 
+  // Draw a Form XObject.  If <formRef> is given, the content of forms
+  // drawn repeatedly is tokenized once and replayed.
   void drawForm(Object *str, Dict *resDict, double *matrix, double *bbox,
 	       GBool transpGroup = gFalse, GBool softMask = gFalse,
 	       GfxColorSpace *blendingColorSpace = NULL,
 	       GBool isolated = gFalse, GBool knockout = gFalse,
 	       GBool alpha = gFalse, Function *transferFunc = NULL,
-	       GfxColor *backdropColor = NULL);
+	       GfxColor *backdropColor = NULL, Ref *formRef = NULL);
 
   void pushResources(Dict *resDict);
   void popResources();
@@ -228,6 +231,9 @@ private:
   MarkedContentStack *mcStack;	// current BMC/EMC stack
 
   Parser *parser;		// parser for page content stream(s)
+  GfxFormContent *replay;	// form content being replayed instead of
+				//   being parsed
+  int replayPos;		// next object of replay
 
 #ifdef USE_CMS
   PopplerCache iccColorSpaceCache;
@@ -240,6 +246,9 @@ private:
   static Operator opTab[];	// table of operators
 
   void go(GBool topLevel);
+  void getContentObj(Object *obj);
+  void freeContentObj(Object *obj);
+  void replayForm(GfxFormContent *content);
   void execOp(Object *cmd, Object args[], int numArgs);
   Operator *findOp(char *name);
   GBool checkArg(Object *arg, TchkType type);
@@ -361,7 +370,7 @@ private:
   // XObject operators
   void opXObject(Object args[], int numArgs);
   void doImage(Object *ref, Stream *str, GBool inlineImg);
-  void doForm(Object *str);
+  void doForm(Object *str, Object *ref);
 
   // in-line image operators
   void opBeginImage(Object args[], int numArgs);
@@ -0,0 +1,345 @@
+//========================================================================
+//
+// GfxFormCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "Object.h"
+#include "Atom.h"
+#include "Array.h"
+#include "Dict.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "GfxFormCache.h"
+
+#if MULTITHREADED
+#  define formCacheLocker()   MutexLocker locker(&mutex)
+#else
+#  define formCacheLocker()
+#endif
+
+#define formCacheHashSize 256	// must be a power of 2
+
+//------------------------------------------------------------------------
+
+// Rough estimate of the heap memory used by a content stream object.
+static Guint contentObjSize(Object *obj) {
+  Object obj1;
+  Guint n;
+  int i;
+
+  n = sizeof(Object);
+  switch (obj->getType()) {
+  case objString:
+    n += sizeof(GooString) + obj->getString()->getLength();
+    break;
+  case objName:
+    if (!isAtom(obj->getName())) {
+      n += strlen(obj->getName()) + 1;
+    }
+    break;
+  case objCmd:
+    if (!isAtom(obj->getCmd())) {
+      n += strlen(obj->getCmd()) + 1;
+    }
+    break;
+  case objArray:
+    n += sizeof(Array);
+    for (i = 0; i < obj->arrayGetLength(); ++i) {
+      n += contentObjSize(obj->arrayGetNF(i, &obj1));
+      obj1.free();
+    }
+    break;
+  case objDict:
+    n += sizeof(Dict);
+    for (i = 0; i < obj->dictGetLength(); ++i) {
+      n += sizeof(char *) + contentObjSize(obj->dictGetValNF(i, &obj1));
+      obj1.free();
+    }
+    break;
+  default:
+    break;
+  }
+  return n;
+}
+
+static inline int formCacheHash(int num) {
+  return num & (formCacheHashSize - 1);
+}
+
+//------------------------------------------------------------------------
+// GfxFormCache
+//------------------------------------------------------------------------
+
+GfxFormCache::GfxFormCache(Guint maxBytesA) {
+  hashTab = (GfxFormContent **)gmallocn(formCacheHashSize,
+					sizeof(GfxFormContent *));
+  memset(hashTab, 0, formCacheHashSize * sizeof(GfxFormContent *));
+  head = tail = NULL;
+  bytes = 0;
+  maxBytes = maxBytesA;
+  hits = 0;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+GfxFormCache::~GfxFormCache() {
+  // replays must not outlive the cache
+  clear();
+  gfree(hashTab);
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void GfxFormCache::setMaxBytes(Guint maxBytesA) {
+  formCacheLocker();
+  maxBytes = maxBytesA;
+  evict();
+}
+
+GfxFormContent *GfxFormCache::find(Ref ref) {
+  GfxFormContent *content;
+
+  for (content = hashTab[formCacheHash(ref.num)];
+       content;
+       content = content->hashNext) {
+    if (content->ref.num == ref.num && content->ref.gen == ref.gen) {
+      return content;
+    }
+  }
+  return NULL;
+}
+
+GfxFormContent *GfxFormCache::get(XRef *xref, Ref ref, Object *str) {
+  GfxFormContent *content;
+  Object *objs;
+  Guint maxSize, size;
+  int nObjs, i;
+  GBool ok;
+
+  {
+    formCacheLocker();
+
+    if (maxBytes == 0) {
+      return NULL;
+    }
+    content = find(ref);
+
+    // first use: only remember the form
+    if (!content) {
+      add(ref);
+      evict();
+      return NULL;
+    }
+
+    // move it to the front of the LRU list
+    if (content != head) {
+      unlink(content);
+      content->prev = NULL;
+      content->next = head;
+      head->prev = content;
+      head = content;
+    }
+
+    if (!content->cacheable) {
+      return NULL;
+    }
+    ++content->refCnt;
+    if (content->objs) {
+      ++hits;
+      return content;
+    }
+    maxSize = maxBytes;
+  }
+
+  // tokenize the form -- without holding the lock, since this can take
+  // a while
+  ok = tokenize(xref, str, maxSize, &objs, &nObjs, &size);
+
+  {
+    formCacheLocker();
+
+    if (!ok) {
+      content->cacheable = gFalse;
+      release(content);
+      return NULL;
+    }
+
+    // another thread may have tokenized the form in the meantime
+    if (content->objs) {
+      for (i = 0; i < nObjs; ++i) {
+	objs[i].free();
+      }
+      gfree(objs);
+      return content;
+    }
+    content->objs = objs;
+    content->nObjs = nObjs;
+    content->size = size;
+    // the entry may have been dropped in the meantime: it then only
+    // lives for this replay
+    if (find(ref) == content) {
+      bytes += size - sizeof(GfxFormContent);
+      evict();
+    }
+    return content;
+  }
+}
+
+void GfxFormCache::release(GfxFormContent *content) {
+  int i;
+
+  formCacheLocker();
+  if (--content->refCnt == 0) {
+    for (i = 0; i < content->nObjs; ++i) {
+      content->objs[i].free();
+    }
+    gfree(content->objs);
+    delete content;
+  }
+}
+
+// Tokenize the content stream <str>.  Returns false if it contains
+// inline images, whose data is read from the content stream by the
+// image operators, or if it would take more than <maxSize> bytes.
+GBool GfxFormCache::tokenize(XRef *xref, Object *str, Guint maxSize,
+			     Object **objsA, int *nObjsA, Guint *sizeA) {
+  Parser *parser;
+  Object *objs;
+  Object obj;
+  Guint size;
+  int nObjs, objsSize, i;
+  GBool ok;
+
+  parser = new Parser(xref, new Lexer(xref, str), gFalse);
+  objs = NULL;
+  nObjs = objsSize = 0;
+  size = sizeof(GfxFormContent);
+  ok = gTrue;
+  for (parser->getObj(&obj); !obj.isEOF(); parser->getObj(&obj)) {
+    size += contentObjSize(&obj);
+    if (obj.isCmd("BI") || size > maxSize) {
+      obj.free();
+      ok = gFalse;
+      break;
+    }
+    if (nObjs == objsSize) {
+      objsSize = objsSize ? 2 * objsSize : 64;
+      objs = (Object *)greallocn(objs, objsSize, sizeof(Object));
+    }
+    objs[nObjs++] = obj;
+  }
+  delete parser;
+
+  if (!ok) {
+    for (i = 0; i < nObjs; ++i) {
+      objs[i].free();
+    }
+    gfree(objs);
+    return gFalse;
+  }
+  *objsA = objs;
+  *nObjsA = nObjs;
+  *sizeA = size + (objsSize - nObjs) * sizeof(Object);
+  return gTrue;
+}
+
+// Add an entry, with no content, at the front of the LRU list.
+// Callers must hold the lock.
+GfxFormContent *GfxFormCache::add(Ref ref) {
+  GfxFormContent *content;
+  int h;
+
+  content = new GfxFormContent;
+  content->ref = ref;
+  content->objs = NULL;
+  content->nObjs = 0;
+  content->cacheable = gTrue;
+  content->size = sizeof(GfxFormContent);
+  content->refCnt = 1;
+  content->prev = NULL;
+  content->next = head;
+  if (head) {
+    head->prev = content;
+  } else {
+    tail = content;
+  }
+  head = content;
+  h = formCacheHash(ref.num);
+  content->hashNext = hashTab[h];
+  hashTab[h] = content;
+  bytes += content->size;
+  return content;
+}
+
+void GfxFormCache::unlink(GfxFormContent *content) {
+  if (content->prev) {
+    content->prev->next = content->next;
+  } else {
+    head = content->next;
+  }
+  if (content->next) {
+    content->next->prev = content->prev;
+  } else {
+    tail = content->prev;
+  }
+}
+
+// Take an entry out of the cache.  Its content is freed once no replay
+// uses it any more.  Callers must hold the lock.
+void GfxFormCache::drop(GfxFormContent *content) {
+  GfxFormContent **p;
+
+  unlink(content);
+  for (p = &hashTab[formCacheHash(content->ref.num)]; *p != content;
+       p = &(*p)->hashNext) ;
+  *p = content->hashNext;
+  bytes -= content->size;
+  release(content);
+}
+
+// Drop the least recently used forms until the content fits in the
+// budget.  Callers must hold the lock.
+void GfxFormCache::evict() {
+  while (tail && bytes > maxBytes) {
+    drop(tail);
+  }
+}
+
+void GfxFormCache::remove(int num) {
+  GfxFormContent *content, *next;
+
+  formCacheLocker();
+  for (content = hashTab[formCacheHash(num)]; content; content = next) {
+    next = content->hashNext;
+    if (content->ref.num == num) {
+      drop(content);
+    }
+  }
+}
+
+void GfxFormCache::clear() {
+  formCacheLocker();
+  while (head) {
+    drop(head);
+  }
+}
+
+void GfxFormCache::getStats(Guint *hitsA, Guint *bytesA) {
+  formCacheLocker();
+  *hitsA = hits;
+  *bytesA = bytes;
+}
@@ -0,0 +1,104 @@
+//========================================================================
+//
+// GfxFormCache.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef GFXFORMCACHE_H
+#define GFXFORMCACHE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#include "Object.h"
+
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+class XRef;
+
+//------------------------------------------------------------------------
+// GfxFormContent
+//------------------------------------------------------------------------
+
+// The tokenized content stream of a Form XObject.
+struct GfxFormContent {
+  Ref ref;
+  Object *objs;			// operands and operators, in stream order
+				//   (NULL until the form is drawn again)
+  int nObjs;
+  GBool cacheable;		// false if the form can't be replayed
+  Guint size;			// estimated memory used by this entry
+  int refCnt;			// one for the cache, while the entry is
+				//   in it, plus one for each replay
+  GfxFormContent *prev;		// LRU list, most recently used first
+  GfxFormContent *next;
+  GfxFormContent *hashNext;
+};
+
+//------------------------------------------------------------------------
+// GfxFormCache
+//------------------------------------------------------------------------
+
+// Document-wide cache of the tokenized content of Form XObjects, keyed
+// by the Ref of the form, so that forms drawn many times (on one page
+// or on many) are only parsed twice.  The least recently used forms
+// are dropped when their estimated size exceeds <maxBytes>; forms
+// being replayed stay alive until they are released.  The cache can
+// be used concurrently from several threads.
+class GfxFormCache {
+public:
+
+  GfxFormCache(Guint maxBytesA);
+  ~GfxFormCache();
+
+  // Set the memory budget, dropping forms if needed.  Zero disables
+  // the cache.
+  void setMaxBytes(Guint maxBytesA);
+
+  // Return the content of form <ref>, whose stream is <str>, ready to
+  // be replayed, or NULL if it has to be parsed from <str>.  Forms are
+  // tokenized the second time they are drawn.  A non-NULL result must
+  // be given back with release().
+  GfxFormContent *get(XRef *xref, Ref ref, Object *str);
+
+  void release(GfxFormContent *content);
+
+  // Drop the forms of object <num>.
+  void remove(int num);
+
+  // Drop all forms.
+  void clear();
+
+  // Return the number of requests served from the cache, and the
+  // estimated memory currently held by the cache.
+  void getStats(Guint *hitsA, Guint *bytesA);
+
+private:
+
+  GfxFormContent *find(Ref ref);
+  GfxFormContent *add(Ref ref);
+  GBool tokenize(XRef *xref, Object *str, Guint maxSize,
+		 Object **objsA, int *nObjsA, Guint *sizeA);
+  void unlink(GfxFormContent *content);
+  void drop(GfxFormContent *content);
+  void evict();
+
+  GfxFormContent **hashTab;
+  GfxFormContent *head;		// most recently used
+  GfxFormContent *tail;		// least recently used
+  Guint bytes;
+  Guint maxBytes;
+  Guint hits;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
+#endif
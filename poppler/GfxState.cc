@@ -242,15 +242,47 @@ cmsHPROFILE GfxColorSpace::getDisplayProfile() {
 
 #endif
 
+//------------------------------------------------------------------------
+// GfxColorLineCache
+//------------------------------------------------------------------------
+
+// Gray and RGB values of the pixels converted by the
+// GfxColorSpace::getCached*Line functions.  Single component pixels
+// index a table of all their 256 values; other pixels are hashed into
+// a direct-mapped table.
+
+#define colorLineCacheSize 4096	// must be a power of 2
+
+#define colorLineCacheGray 1	// flags: gray value is set
+#define colorLineCacheRGB  2	//        RGB value is set
+
+struct GfxColorLineCache {
+  int nComps;
+  double low[gfxColorMaxComps];	// default ranges, to map the bytes
+  double range[gfxColorMaxComps]; //   back to components
+  int size;			// number of entries
+  Guchar *keys;			// pixel of each entry (NULL for single
+				//   component pixels)
+  Guchar *flags;		// which values of each entry are set
+  Guchar *vals;			// gray, r, g, b of each entry
+};
+
 //------------------------------------------------------------------------
 // GfxColorSpace
 //------------------------------------------------------------------------
 
 GfxColorSpace::GfxColorSpace() {
   overprintMask = 0x0f;
+  lineCache = NULL;
 }
 
 GfxColorSpace::~GfxColorSpace() {
+  if (lineCache) {
+    gfree(lineCache->keys);
+    gfree(lineCache->flags);
+    gfree(lineCache->vals);
+    delete lineCache;
+  }
 }
 
 GfxColorSpace *GfxColorSpace::parse(Object *csObj, Gfx *gfx, int recursion) {
@@ -331,6 +363,116 @@ void GfxColorSpace::getDefaultRanges(double *decodeLow, double *decodeRange,
   }
 }
 
+// Return the gray value (if <what> is colorLineCacheGray) or RGB value
+// (colorLineCacheRGB) of pixel <p>, as bytes at offsets 0 and 1..3 of
+// the returned entry.
+Guchar *GfxColorSpace::getCachedPixel(Guchar *p, int what) {
+  GfxColorLineCache *cache;
+  GfxColor color;
+  GfxGray gray;
+  GfxRGB rgb;
+  Guchar *v;
+  Guint h;
+  int n, i, k;
+
+  if (!(cache = lineCache)) {
+    cache = lineCache = new GfxColorLineCache;
+    cache->nComps = getNComps();
+    getDefaultRanges(cache->low, cache->range, 255);
+    if (cache->nComps == 1) {
+      cache->size = 256;
+      cache->keys = NULL;
+    } else {
+      cache->size = colorLineCacheSize;
+      cache->keys = (Guchar *)gmallocn(cache->size, cache->nComps);
+      memset(cache->keys, 0, cache->size * cache->nComps);
+    }
+    cache->flags = (Guchar *)gmalloc(cache->size);
+    memset(cache->flags, 0, cache->size);
+    cache->vals = (Guchar *)gmallocn(cache->size, 4);
+  }
+
+  n = cache->nComps;
+  if (n == 1) {
+    i = p[0];
+  } else {
+    h = 2166136261U;
+    for (k = 0; k < n; ++k) {
+      h = (h ^ p[k]) * 16777619U;
+    }
+    i = (h ^ (h >> 16)) & (cache->size - 1);
+    if (memcmp(cache->keys + i * n, p, n)) {
+      memcpy(cache->keys + i * n, p, n);
+      cache->flags[i] = 0;
+    }
+  }
+  v = cache->vals + 4 * i;
+  if (!(cache->flags[i] & what)) {
+    for (k = 0; k < n; ++k) {
+      color.c[k] = dblToCol(cache->low[k] + (p[k] * cache->range[k]) / 255);
+    }
+    if (what == colorLineCacheGray) {
+      getGray(&color, &gray);
+      v[0] = colToByte(gray);
+    } else {
+      getRGB(&color, &rgb);
+      v[1] = colToByte(rgb.r);
+      v[2] = colToByte(rgb.g);
+      v[3] = colToByte(rgb.b);
+    }
+    cache->flags[i] |= what;
+  }
+  return v;
+}
+
+void GfxColorSpace::getCachedGrayLine(Guchar *in, Guchar *out, int length) {
+  int n, i;
+
+  n = getNComps();
+  for (i = 0; i < length; ++i, in += n) {
+    out[i] = getCachedPixel(in, colorLineCacheGray)[0];
+  }
+}
+
+void GfxColorSpace::getCachedRGBLine(Guchar *in, unsigned int *out,
+				     int length) {
+  Guchar *v;
+  int n, i;
+
+  n = getNComps();
+  for (i = 0; i < length; ++i, in += n) {
+    v = getCachedPixel(in, colorLineCacheRGB);
+    out[i] = (v[1] << 16) | (v[2] << 8) | v[3];
+  }
+}
+
+void GfxColorSpace::getCachedRGBLine(Guchar *in, Guchar *out, int length) {
+  Guchar *v;
+  int n, i;
+
+  n = getNComps();
+  for (i = 0; i < length; ++i, in += n) {
+    v = getCachedPixel(in, colorLineCacheRGB);
+    *out++ = v[1];
+    *out++ = v[2];
+    *out++ = v[3];
+  }
+}
+
+void GfxColorSpace::getCachedRGBXLine(Guchar *in, Guchar *out, int length) {
+  Guchar *v;
+  int n, i;
+
+  n = getNComps();
+  for (i = 0; i < length; ++i, in += n) {
+    v = getCachedPixel(in, colorLineCacheRGB);
+    *out++ = v[1];
+    *out++ = v[2];
+    *out++ = v[3];
+    *out++ = 255;
+  }
+}
+
 int GfxColorSpace::getNumColorSpaceModes() {
   return nGfxColorSpaceModes;
 }
@@ -4831,9 +4973,13 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
   Object obj;
   double x[gfxColorMaxComps];
   double y[gfxColorMaxComps];
+  double low2[gfxColorMaxComps];
+  double range2[gfxColorMaxComps];
+  GfxColorSpace *lineSpace;
+  int lineComps;
   int i, j, k;
   double mapped;
-  GBool useByteLookup;
+  GBool useByteLookup, linePixels;
 
   ok = gTrue;
 
@@ -4854,6 +5000,8 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
     lookup2[k] = NULL;
   }
   byte_lookup = NULL;
+  cachedLines = gFalse;
+  lineFallback = gFalse;
 
   // get decode map
   if (decode->isNull()) {
@@ -4933,7 +5081,7 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
 	mapped = x[k] + (indexedLookup[j*nComps2 + k] / 255.0) * y[k];
 	lookup2[k][i] = dblToCol(mapped);
 	if (useByteLookup)
-	  byte_lookup[i * nComps2 + k] = (Guchar) (mapped * 255);
+	  byte_lookup[i * nComps2 + k] = indexedLookup[j*nComps2 + k];
       }
     }
     break;
@@ -4942,6 +5090,7 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
     colorSpace2 = sepCS->getAlt();
     nComps2 = colorSpace2->getNComps();
     sepFunc = sepCS->getFunc();
+    colorSpace2->getDefaultRanges(low2, range2, 255);
     if (colorSpace2->useGetGrayLine() || colorSpace2->useGetRGBLine()) {
       byte_lookup = (Guchar *)gmallocn ((maxPixel + 1), nComps2);
       useByteLookup = gTrue;
@@ -4953,12 +5102,23 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
 	x[0] = decodeLow[0] + (i * decodeRange[0]) / maxPixel;
 	sepFunc->transform(x, y);
 	lookup2[k][i] = dblToCol(y[k]);
-	if (useByteLookup)
-	  byte_lookup[i*nComps2 + k] = (Guchar) (y[k] * 255);
+	if (useByteLookup) {
+	  double byte;
+
+	  // the tint transform may give values outside the alternate
+	  // space's default range
+	  byte = (y[k] - low2[k]) / range2[k] * 255.0 + 0.5;
+	  if (byte < 0)
+	    byte = 0;
+	  else if (byte > 255)
+	    byte = 255;
+	  byte_lookup[i*nComps2 + k] = (Guchar)byte;
+	}
       }
     }
     break;
   default:
+    colorSpace->getDefaultRanges(low2, range2, maxPixel);
     if (colorSpace->useGetGrayLine() || colorSpace->useGetRGBLine()) {
       byte_lookup = (Guchar *)gmallocn ((maxPixel + 1), nComps);
       useByteLookup = gTrue;
@@ -4972,7 +5132,7 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
 	if (useByteLookup) {
 	  int byte;
 
-	  byte = (int) (mapped * 255.0 + 0.5);
+	  byte = (int) ((mapped - low2[k]) / range2[k] * 255.0 + 0.5);
 	  if (byte < 0)
 	    byte = 0;
 	  else if (byte > 255)
@@ -4983,6 +5143,29 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
     }
   }
 
+  // The line functions pass each component through byte_lookup, as a
+  // byte in the default range of the space that converts it.  The
+  // cached line conversions give the same colors as getGray and getRGB
+  // only if each byte maps back to the decoded value, as it does
+  // without a Decode array; otherwise convert pixel by pixel.
+  lineSpace = colorSpace2 ? colorSpace2 : colorSpace;
+  lineComps = colorSpace2 ? nComps2 : nComps;
+  if (useByteLookup && lineSpace->useCachedLines()) {
+    lineSpace->getDefaultRanges(low2, range2, 255);
+    linePixels = gTrue;
+    for (k = 0; k < lineComps && linePixels; ++k) {
+      for (i = 0; i <= maxPixel; ++i) {
+	if (lookup2[k][i] !=
+	    dblToCol(low2[k] + (byte_lookup[i * lineComps + k] * range2[k]) / 255)) {
+	  linePixels = gFalse;
+	  break;
+	}
+      }
+    }
+    lineFallback = !linePixels;
+    cachedLines = linePixels && !colorSpace2;
+  }
+
   return;
 
  err2:
@@ -5031,6 +5214,8 @@ GfxImageColorMap::GfxImageColorMap(GfxImageColorMap *colorMap) {
     decodeLow[i] = colorMap->decodeLow[i];
     decodeRange[i] = colorMap->decodeRange[i];
   }
+  cachedLines = colorMap->cachedLines;
+  lineFallback = colorMap->lineFallback;
   ok = gTrue;
 }
 
@@ -5084,7 +5269,7 @@ void GfxImageColorMap::getGrayLine(Guchar *in, Guchar *out, int length) {
   Guchar *inp, *tmp_line;
 
   if ((colorSpace2 && !colorSpace2->useGetGrayLine ()) ||
-      (!colorSpace2 && !colorSpace->useGetGrayLine ())) {
+      (!colorSpace2 && !colorSpace->useGetGrayLine ()) || lineFallback) {
     GfxGray gray;
 
     inp = in;
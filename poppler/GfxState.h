@@ -187,6 +187,8 @@ private:
   unsigned int refCount;
 };
 
+struct GfxColorLineCache;
+
 class GfxColorSpace {
 public:
 
@@ -202,6 +204,10 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray) = 0;
   virtual void getRGB(GfxColor *color, GfxRGB *rgb) = 0;
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk) = 0;
+
+  // Convert a line of pixels to gray, RGB, or RGB plus a 255 byte.
+  // Each component is given as a byte, scaled over the component's
+  // default range (see getDefaultRanges).
   virtual void getGrayLine(Guchar * /*in*/, Guchar * /*out*/, int /*length*/) { error(errInternal, -1, "GfxColorSpace::getGrayLine this should not happen"); }
   virtual void getRGBLine(Guchar * /*in*/, unsigned int * /*out*/, int /*length*/) { error(errInternal, -1, "GfxColorSpace::getRGBLine (first variant) this should not happen"); }
   virtual void getRGBLine(Guchar * /*in*/, Guchar * /*out*/, int /*length*/) {  error(errInternal, -1, "GfxColorSpace::getRGBLine (second variant) this should not happen"); }
@@ -211,6 +217,9 @@ public:
   virtual GBool useGetRGBLine() { return gFalse; }
   // Does this ColorSpace support getGrayLine?
   virtual GBool useGetGrayLine() { return gFalse; }
+  // Are its line functions the getCached*Line ones, which give the
+  // same result as getGray/getRGB?
+  virtual GBool useCachedLines() { return gFalse; }
 
   // Return the number of color components.
   virtual int getNComps() = 0;
@@ -248,7 +257,22 @@ public:
 #endif
 protected:
 
+  // Line conversions for color spaces whose per-pixel conversions are
+  // costly: each pixel value is converted once, with getGray() or
+  // getRGB(), and the result is remembered.
+  void getCachedGrayLine(Guchar *in, Guchar *out, int length);
+  void getCachedRGBLine(Guchar *in, unsigned int *out, int length);
+  void getCachedRGBLine(Guchar *in, Guchar *out, int length);
+  void getCachedRGBXLine(Guchar *in, Guchar *out, int length);
+
   Guint overprintMask;
+
+private:
+
+  Guchar *getCachedPixel(Guchar *p, int what);
+
+  GfxColorLineCache *lineCache;	// results of the getCached*Line
+				//   functions (allocated on first use)
 };
 
 //------------------------------------------------------------------------
@@ -298,6 +322,18 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(Guchar *in, Guchar *out, int length)
+    { getCachedGrayLine(in, out, length); }
+  virtual void getRGBLine(Guchar *in, unsigned int *out, int length)
+    { getCachedRGBLine(in, out, length); }
+  virtual void getRGBLine(Guchar *in, Guchar *out, int length)
+    { getCachedRGBLine(in, out, length); }
+  virtual void getRGBXLine(Guchar *in, Guchar *out, int length)
+    { getCachedRGBXLine(in, out, length); }
+
+  virtual GBool useGetRGBLine() { return gTrue; }
+  virtual GBool useGetGrayLine() { return gTrue; }
+  virtual GBool useCachedLines() { return gTrue; }
 
   virtual int getNComps() { return 1; }
   virtual void getDefaultColor(GfxColor *color);
@@ -367,6 +403,18 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(Guchar *in, Guchar *out, int length)
+    { getCachedGrayLine(in, out, length); }
+  virtual void getRGBLine(Guchar *in, unsigned int *out, int length)
+    { getCachedRGBLine(in, out, length); }
+  virtual void getRGBLine(Guchar *in, Guchar *out, int length)
+    { getCachedRGBLine(in, out, length); }
+  virtual void getRGBXLine(Guchar *in, Guchar *out, int length)
+    { getCachedRGBXLine(in, out, length); }
+
+  virtual GBool useGetRGBLine() { return gTrue; }
+  virtual GBool useGetGrayLine() { return gTrue; }
+  virtual GBool useCachedLines() { return gTrue; }
 
   virtual int getNComps() { return 3; }
   virtual void getDefaultColor(GfxColor *color);
@@ -437,6 +485,18 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(Guchar *in, Guchar *out, int length)
+    { getCachedGrayLine(in, out, length); }
+  virtual void getRGBLine(Guchar *in, unsigned int *out, int length)
+    { getCachedRGBLine(in, out, length); }
+  virtual void getRGBLine(Guchar *in, Guchar *out, int length)
+    { getCachedRGBLine(in, out, length); }
+  virtual void getRGBXLine(Guchar *in, Guchar *out, int length)
+    { getCachedRGBXLine(in, out, length); }
+
+  virtual GBool useGetRGBLine() { return gTrue; }
+  virtual GBool useGetGrayLine() { return gTrue; }
+  virtual GBool useCachedLines() { return gTrue; }
 
   virtual int getNComps() { return 3; }
   virtual void getDefaultColor(GfxColor *color);
@@ -573,6 +633,18 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(Guchar *in, Guchar *out, int length)
+    { getCachedGrayLine(in, out, length); }
+  virtual void getRGBLine(Guchar *in, unsigned int *out, int length)
+    { getCachedRGBLine(in, out, length); }
+  virtual void getRGBLine(Guchar *in, Guchar *out, int length)
+    { getCachedRGBLine(in, out, length); }
+  virtual void getRGBXLine(Guchar *in, Guchar *out, int length)
+    { getCachedRGBXLine(in, out, length); }
+
+  virtual GBool useGetRGBLine() { return gTrue; }
+  virtual GBool useGetGrayLine() { return gTrue; }
+  virtual GBool useCachedLines() { return gTrue; }
 
   virtual int getNComps() { return 1; }
   virtual void getDefaultColor(GfxColor *color);
@@ -615,6 +687,18 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(Guchar *in, Guchar *out, int length)
+    { getCachedGrayLine(in, out, length); }
+  virtual void getRGBLine(Guchar *in, unsigned int *out, int length)
+    { getCachedRGBLine(in, out, length); }
+  virtual void getRGBLine(Guchar *in, Guchar *out, int length)
+    { getCachedRGBLine(in, out, length); }
+  virtual void getRGBXLine(Guchar *in, Guchar *out, int length)
+    { getCachedRGBXLine(in, out, length); }
+
+  virtual GBool useGetRGBLine() { return gTrue; }
+  virtual GBool useGetGrayLine() { return gTrue; }
+  virtual GBool useCachedLines() { return gTrue; }
 
   virtual int getNComps() { return nComps; }
   virtual void getDefaultColor(GfxColor *color);
@@ -1097,7 +1181,11 @@ public:
   double getDecodeLow(int i) { return decodeLow[i]; }
   double getDecodeHigh(int i) { return decodeLow[i] + decodeRange[i]; }
   
-  bool useRGBLine() { return (colorSpace2 && colorSpace2->useGetRGBLine ()) || (!colorSpace2 && colorSpace->useGetRGBLine ()); }
+  bool useRGBLine() { return ((colorSpace2 && colorSpace2->useGetRGBLine ()) || (!colorSpace2 && colorSpace->useGetRGBLine ())) && !lineFallback; }
+  // Do the line functions give the same result as getGray/getRGB for
+  // each pixel?  Only the color spaces with cached line conversions
+  // do, and only for images without a Decode array.
+  GBool useCachedLines() { return cachedLines; }
 
   // Convert an image pixel to a color.
   void getGray(Guchar *x, GfxGray *gray);
@@ -1123,6 +1211,9 @@ private:
   GfxColorComp *		// optimized case lookup table
     lookup2[gfxColorMaxComps];
   Guchar *byte_lookup;
+  GBool cachedLines;		// see useCachedLines()
+  GBool lineFallback;		// the cached line conversions would lose
+				//   precision: convert pixel by pixel
   double			// minimum values for each component
     decodeLow[gfxColorMaxComps];
   double			// max - min value for each component
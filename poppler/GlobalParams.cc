@@ -63,6 +63,9 @@
 #include "goo/GooList.h"
 #include "goo/GooHash.h"
 #include "goo/gfile.h"
+#if MULTITHREADED
+#include "goo/GooThreadPool.h"
+#endif
 #include "Error.h"
 #include "NameToCharCode.h"
 #include "CharCodeToUnicode.h"
@@ -634,6 +637,20 @@ GlobalParams::GlobalParams(const char *customPopplerDataDir)
   mapUnknownCharNames = gFalse;
   printCommands = gFalse;
   profileCommands = gFalse;
+  xrefObjectCacheSize = 0;
+  formContentCacheSize = 0;
+  imageCacheSize = 16 * 1024 * 1024;
+  jbig2GlobalsCacheSize = 8 * 1024 * 1024;
+  jpxDecodeThreads = 0;
+#if MULTITHREADED
+  jpxDecodePool = NULL;
+#endif
+  mapFiles = gTrue;
+#ifdef ENABLE_ZLIB
+  flateUseZlib = gTrue;
+#else
+  flateUseZlib = gFalse;
+#endif
   errQuiet = gFalse;
 
   cidToUnicodeCache = new CharCodeToUnicodeCache(cidToUnicodeCacheSize);
@@ -838,6 +855,9 @@ GlobalParams::~GlobalParams() {
 #endif
 
 #if MULTITHREADED
+  // stops the worker threads
+  delete jpxDecodePool;
+
   gDestroyMutex(&mutex);
   gDestroyMutex(&unicodeMapCacheMutex);
   gDestroyMutex(&cMapCacheMutex);
@@ -1821,6 +1841,87 @@ GBool GlobalParams::getProfileCommands() {
   return p;
 }
 
+Guint GlobalParams::getXRefObjectCacheSize() {
+  Guint size;
+
+  lockGlobalParams;
+  size = xrefObjectCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+Guint GlobalParams::getFormContentCacheSize() {
+  Guint size;
+
+  lockGlobalParams;
+  size = formContentCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+Guint GlobalParams::getImageCacheSize() {
+  Guint size;
+
+  lockGlobalParams;
+  size = imageCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+Guint GlobalParams::getJBIG2GlobalsCacheSize() {
+  Guint size;
+
+  lockGlobalParams;
+  size = jbig2GlobalsCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+int GlobalParams::getJPXDecodeThreads() {
+  int n;
+
+  lockGlobalParams;
+  n = jpxDecodeThreads;
+  unlockGlobalParams;
+  return n;
+}
+
+#if MULTITHREADED
+// The pool is created by the first JPXStream that needs it, with room
+// for jpxDecodeThreads threads (or one per processor) at that time.
+GooThreadPool *GlobalParams::getJPXDecodePool() {
+  GooThreadPool *pool;
+
+  lockGlobalParams;
+  if (!jpxDecodePool) {
+    jpxDecodePool = new GooThreadPool(jpxDecodeThreads > 0
+				        ? jpxDecodeThreads
+				        : gGetNumProcessors());
+  }
+  pool = jpxDecodePool;
+  unlockGlobalParams;
+  return pool;
+}
+#endif
+
+GBool GlobalParams::getMapFiles() {
+  GBool map;
+
+  lockGlobalParams;
+  map = mapFiles;
+  unlockGlobalParams;
+  return map;
+}
+
+GBool GlobalParams::getFlateUseZlib() {
+  GBool zlib;
+
+  lockGlobalParams;
+  zlib = flateUseZlib;
+  unlockGlobalParams;
+  return zlib;
+}
+
 GBool GlobalParams::getErrQuiet() {
   // no locking -- this function may get called from inside a locked
   // section
@@ -2193,6 +2294,48 @@ void GlobalParams::setProfileCommands(GBool profileCommandsA) {
   unlockGlobalParams;
 }
 
+void GlobalParams::setXRefObjectCacheSize(Guint size) {
+  lockGlobalParams;
+  xrefObjectCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setFormContentCacheSize(Guint size) {
+  lockGlobalParams;
+  formContentCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setImageCacheSize(Guint size) {
+  lockGlobalParams;
+  imageCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setJBIG2GlobalsCacheSize(Guint size) {
+  lockGlobalParams;
+  jbig2GlobalsCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setJPXDecodeThreads(int n) {
+  lockGlobalParams;
+  jpxDecodeThreads = n;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setMapFiles(GBool mapFilesA) {
+  lockGlobalParams;
+  mapFiles = mapFilesA;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setFlateUseZlib(GBool flateUseZlibA) {
+  lockGlobalParams;
+  flateUseZlib = flateUseZlibA;
+  unlockGlobalParams;
+}
+
 void GlobalParams::setErrQuiet(GBool errQuietA) {
   lockGlobalParams;
   errQuiet = errQuietA;
@@ -63,6 +63,9 @@ class GlobalParams;
 class GfxFont;
 class Stream;
 class SysFontList;
+#if MULTITHREADED
+class GooThreadPool;
+#endif
 
 //------------------------------------------------------------------------
 
@@ -191,6 +194,16 @@ public:
   GBool getMapUnknownCharNames();
   GBool getPrintCommands();
   GBool getProfileCommands();
+  Guint getXRefObjectCacheSize();
+  Guint getFormContentCacheSize();
+  Guint getImageCacheSize();
+  Guint getJBIG2GlobalsCacheSize();
+  int getJPXDecodeThreads();
+#if MULTITHREADED
+  GooThreadPool *getJPXDecodePool();
+#endif
+  GBool getMapFiles();
+  GBool getFlateUseZlib();
   GBool getErrQuiet();
   double getSplashResolution();
 
@@ -246,6 +259,13 @@ public:
   void setMapUnknownCharNames(GBool map);
   void setPrintCommands(GBool printCommandsA);
   void setProfileCommands(GBool profileCommandsA);
+  void setXRefObjectCacheSize(Guint size);
+  void setFormContentCacheSize(Guint size);
+  void setImageCacheSize(Guint size);
+  void setJBIG2GlobalsCacheSize(Guint size);
+  void setJPXDecodeThreads(int n);
+  void setMapFiles(GBool mapFilesA);
+  void setFlateUseZlib(GBool flateUseZlibA);
   void setErrQuiet(GBool errQuietA);
 
   //----- security handlers
@@ -348,6 +368,25 @@ private:
   GBool mapUnknownCharNames;	// map unknown char names?
   GBool printCommands;		// print the drawing commands
   GBool profileCommands;	// profile the drawing commands
+  Guint xrefObjectCacheSize;	// bytes of parsed objects cached by each
+				//   XRef (0 = no cache)
+  Guint formContentCacheSize;	// bytes of tokenized Form XObject content
+				//   cached by each XRef (0 = no cache, the
+				//   default)
+  Guint imageCacheSize;		// bytes of decoded image data cached by
+				//   each XRef (0 = no cache)
+  Guint jbig2GlobalsCacheSize;	// bytes of decoded JBIG2 globals cached
+				//   by each XRef (0 = no cache)
+  int jpxDecodeThreads;		// threads decoding each JPX image (0 = one
+				//   per processor, 1 = no worker threads)
+#if MULTITHREADED
+  GooThreadPool *jpxDecodePool;	// worker threads shared by all the
+				//   JPXStreams, created when first needed
+#endif
+  GBool mapFiles;		// read documents opened by file name
+				//   through a memory mapping, if possible
+  GBool flateUseZlib;		// decode Flate streams with zlib instead of
+				//   the built-in decoder (if built with zlib)
   GBool errQuiet;		// suppress error messages?
   double splashResolution;	// resolution when rasterizing images
 
@@ -0,0 +1,308 @@
+//========================================================================
+//
+// ImageCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <limits.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "Object.h"
+#include "Stream.h"
+#include "ImageCache.h"
+
+#if MULTITHREADED
+#  define imageCacheLocker()   MutexLocker locker(&mutex)
+#else
+#  define imageCacheLocker()
+#endif
+
+#define imageCacheHashSize 256	// must be a power of 2
+
+//------------------------------------------------------------------------
+
+struct ImageCacheEntry {
+  Ref ref;
+  int width, height, nComps, nBits;
+  Guchar *data;			// decoded data (NULL until the image is
+				//   requested again)
+  Guint dataLen;		// number of bytes in data
+  GBool cacheable;		// false if the image is too large
+  int refCnt;			// one for the cache, while the entry is
+				//   in it, plus one for each stream
+  ImageCacheEntry *prev;	// LRU list, most recently used first
+  ImageCacheEntry *next;
+  ImageCacheEntry *hashNext;
+};
+
+static inline int imageCacheHash(int num) {
+  return num & (imageCacheHashSize - 1);
+}
+
+//------------------------------------------------------------------------
+// ImageCacheStream
+//------------------------------------------------------------------------
+
+// Reads the data of a cached image, and keeps it from being freed.
+class ImageCacheStream: public MemStream {
+public:
+
+  ImageCacheStream(ImageCache *cacheA, ImageCacheEntry *entryA,
+		   Object *dictA);
+  virtual ~ImageCacheStream();
+
+private:
+
+  ImageCache *cache;
+  ImageCacheEntry *entry;
+};
+
+ImageCacheStream::ImageCacheStream(ImageCache *cacheA,
+				   ImageCacheEntry *entryA, Object *dictA):
+  MemStream((char *)entryA->data, 0, entryA->dataLen, dictA)
+{
+  cache = cacheA;
+  entry = entryA;
+}
+
+ImageCacheStream::~ImageCacheStream() {
+  cache->release(entry);
+}
+
+//------------------------------------------------------------------------
+// ImageCache
+//------------------------------------------------------------------------
+
+ImageCache::ImageCache(Guint maxBytesA) {
+  hashTab = (ImageCacheEntry **)gmallocn(imageCacheHashSize,
+					 sizeof(ImageCacheEntry *));
+  memset(hashTab, 0, imageCacheHashSize * sizeof(ImageCacheEntry *));
+  head = tail = NULL;
+  bytes = 0;
+  maxBytes = maxBytesA;
+  hits = 0;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+ImageCache::~ImageCache() {
+  // streams must not outlive the cache
+  clear();
+  gfree(hashTab);
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void ImageCache::setMaxBytes(Guint maxBytesA) {
+  imageCacheLocker();
+  maxBytes = maxBytesA;
+  evict();
+}
+
+ImageCacheEntry *ImageCache::find(Ref ref, int width, int height,
+				  int nComps, int nBits) {
+  ImageCacheEntry *entry;
+
+  for (entry = hashTab[imageCacheHash(ref.num)];
+       entry;
+       entry = entry->hashNext) {
+    if (entry->ref.num == ref.num && entry->ref.gen == ref.gen &&
+	entry->width == width && entry->height == height &&
+	entry->nComps == nComps && entry->nBits == nBits) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+Stream *ImageCache::getImageStream(Ref ref, Stream *str,
+				   int width, int height,
+				   int nComps, int nBits) {
+  ImageCacheEntry *entry;
+  Object dictObj;
+  Guchar *data;
+  Guint rowBytes, dataLen;
+  int n;
+
+  {
+    imageCacheLocker();
+
+    if (maxBytes == 0 || width <= 0 || height <= 0 ||
+	nComps <= 0 || nBits <= 0) {
+      return NULL;
+    }
+    entry = find(ref, width, height, nComps, nBits);
+
+    // first use: only remember the image
+    if (!entry) {
+      entry = add(ref, width, height, nComps, nBits);
+      entry->cacheable = width <= (INT_MAX - 7) / nComps / nBits &&
+	  (Guint)height <= maxBytes / ((width * nComps * nBits + 7) >> 3);
+      evict();
+      return NULL;
+    }
+
+    // move it to the front of the LRU list
+    if (entry != head) {
+      unlink(entry);
+      entry->prev = NULL;
+      entry->next = head;
+      head->prev = entry;
+      head = entry;
+    }
+
+    if (!entry->cacheable) {
+      return NULL;
+    }
+    if (entry->data) {
+      ++entry->refCnt;
+      ++hits;
+      dictObj.initNull();
+      return new ImageCacheStream(this, entry, &dictObj);
+    }
+  }
+
+  // decode the image -- without holding the lock, since this can take
+  // a while
+  rowBytes = (width * nComps * nBits + 7) >> 3;
+  dataLen = 0;
+  data = (Guchar *)gmallocn(height, rowBytes);
+  str->reset();
+  while (dataLen < height * rowBytes &&
+	 (n = str->doGetChars(height * rowBytes - dataLen,
+			      data + dataLen)) > 0) {
+    dataLen += n;
+  }
+  str->close();
+
+  {
+    imageCacheLocker();
+
+    // the entry may have been dropped, or filled by another thread, in
+    // the meantime
+    if (!(entry = find(ref, width, height, nComps, nBits))) {
+      entry = add(ref, width, height, nComps, nBits);
+    }
+    if (entry->data) {
+      gfree(data);
+    } else {
+      entry->data = data;
+      entry->dataLen = dataLen;
+      bytes += dataLen;
+    }
+    ++entry->refCnt;
+    evict();
+    dictObj.initNull();
+    return new ImageCacheStream(this, entry, &dictObj);
+  }
+}
+
+// Add an entry, with no data, at the front of the LRU list.  Callers
+// must hold the lock.
+ImageCacheEntry *ImageCache::add(Ref ref, int width, int height,
+				 int nComps, int nBits) {
+  ImageCacheEntry *entry;
+  int h;
+
+  entry = new ImageCacheEntry;
+  entry->ref = ref;
+  entry->width = width;
+  entry->height = height;
+  entry->nComps = nComps;
+  entry->nBits = nBits;
+  entry->data = NULL;
+  entry->dataLen = 0;
+  entry->cacheable = gTrue;
+  entry->refCnt = 1;
+  entry->prev = NULL;
+  entry->next = head;
+  if (head) {
+    head->prev = entry;
+  } else {
+    tail = entry;
+  }
+  head = entry;
+  h = imageCacheHash(ref.num);
+  entry->hashNext = hashTab[h];
+  hashTab[h] = entry;
+  bytes += sizeof(ImageCacheEntry);
+  return entry;
+}
+
+void ImageCache::unlink(ImageCacheEntry *entry) {
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+  } else {
+    head = entry->next;
+  }
+  if (entry->next) {
+    entry->next->prev = entry->prev;
+  } else {
+    tail = entry->prev;
+  }
+}
+
+// Take an entry out of the cache.  Its data is freed once no stream
+// reads it any more.  Callers must hold the lock.
+void ImageCache::drop(ImageCacheEntry *entry) {
+  ImageCacheEntry **p;
+
+  unlink(entry);
+  for (p = &hashTab[imageCacheHash(entry->ref.num)]; *p != entry;
+       p = &(*p)->hashNext) ;
+  *p = entry->hashNext;
+  bytes -= sizeof(ImageCacheEntry) + entry->dataLen;
+  release(entry);
+}
+
+// Drop the least recently used images until the data fits in the
+// budget.  Callers must hold the lock.
+void ImageCache::evict() {
+  while (tail && bytes > maxBytes) {
+    drop(tail);
+  }
+}
+
+void ImageCache::release(ImageCacheEntry *entry) {
+  imageCacheLocker();
+
+  if (--entry->refCnt == 0) {
+    gfree(entry->data);
+    delete entry;
+  }
+}
+
+void ImageCache::remove(int num) {
+  ImageCacheEntry *entry, *next;
+
+  imageCacheLocker();
+  for (entry = hashTab[imageCacheHash(num)]; entry; entry = next) {
+    next = entry->hashNext;
+    if (entry->ref.num == num) {
+      drop(entry);
+    }
+  }
+}
+
+void ImageCache::clear() {
+  imageCacheLocker();
+  while (head) {
+    drop(head);
+  }
+}
+
+void ImageCache::getStats(Guint *hitsA, Guint *bytesA) {
+  imageCacheLocker();
+  *hitsA = hits;
+  *bytesA = bytes;
+}
@@ -0,0 +1,91 @@
+//========================================================================
+//
+// ImageCache.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#include "Object.h"
+
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+class Stream;
+struct ImageCacheEntry;
+
+//------------------------------------------------------------------------
+// ImageCache
+//------------------------------------------------------------------------
+
+// Document-wide cache of decoded image data, so that images drawn on
+// many pages (letterheads, watermarks, backgrounds) only go through
+// their filters once.  An image is keyed by the Ref of its XObject and
+// by the size and format of the samples it is decoded to (which
+// depends on any setImageScaleDenom reduction).  The least recently
+// used images are dropped when the data exceeds <maxBytes>.  The
+// cache can be used concurrently from several threads.
+class ImageCache {
+public:
+
+  ImageCache(Guint maxBytesA);
+  ~ImageCache();
+
+  // Set the memory budget, dropping images if needed.  Zero disables
+  // the cache.
+  void setMaxBytes(Guint maxBytesA);
+
+  // Return a stream that reads the decoded data of image <ref>, with
+  // <height> lines of <width> pixels of <nComps> components of
+  // <nBits> bits, or NULL if <str> has to be read as usual.  Images
+  // are decoded from <str> into the cache the second time they are
+  // requested.  The caller must delete the returned stream, which
+  // keeps the data alive until then.
+  Stream *getImageStream(Ref ref, Stream *str, int width, int height,
+			 int nComps, int nBits);
+
+  // Drop the images of object <num>.
+  void remove(int num);
+
+  // Drop all images.
+  void clear();
+
+  // Return the number of requests served from the cache, and the
+  // number of bytes of image data currently in the cache.
+  void getStats(Guint *hitsA, Guint *bytesA);
+
+private:
+
+  ImageCacheEntry *find(Ref ref, int width, int height,
+			int nComps, int nBits);
+  ImageCacheEntry *add(Ref ref, int width, int height,
+		       int nComps, int nBits);
+  void unlink(ImageCacheEntry *entry);
+  void drop(ImageCacheEntry *entry);
+  void evict();
+  void release(ImageCacheEntry *entry);
+
+  ImageCacheEntry **hashTab;
+  ImageCacheEntry *head;	// most recently used
+  ImageCacheEntry *tail;	// least recently used
+  Guint bytes;
+  Guint maxBytes;
+  Guint hits;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+
+  friend class ImageCacheStream;
+};
+
+#endif
@@ -34,6 +34,8 @@
 #include <limits.h>
 #include "goo/GooList.h"
 #include "Error.h"
+#include "Object.h"
+#include "XRef.h"
 #include "JArithmeticDecoder.h"
 #include "JBIG2Stream.h"
 
@@ -683,6 +685,7 @@ public:
     { data[y * line + (x >> 3)] |= 1 << (7 - (x & 7)); }
   void clearPixel(int x, int y)
     { data[y * line + (x >> 3)] &= 0x7f7f >> (x & 7); }
+  void setPixels(int x0, int x1, int y);
   void getPixelPtr(int x, int y, JBIG2BitmapPtr *ptr);
   int nextPixel(JBIG2BitmapPtr *ptr);
   void duplicateRow(int yDest, int ySrc);
@@ -824,6 +827,29 @@ inline int JBIG2Bitmap::nextPixel(JBIG2BitmapPtr *ptr) {
   return pix;
 }
 
+// Set the pixels x0 <= x < x1 of row y.
+void JBIG2Bitmap::setPixels(int x0, int x1, int y) {
+  Guchar *p;
+  Guchar m0, m1;
+  int i0, i1;
+
+  if (x0 >= x1) {
+    return;
+  }
+  p = data + y * line;
+  i0 = x0 >> 3;
+  i1 = (x1 - 1) >> 3;
+  m0 = 0xff >> (x0 & 7);
+  m1 = 0xff << (7 - ((x1 - 1) & 7));
+  if (i0 == i1) {
+    p[i0] |= m0 & m1;
+  } else {
+    p[i0] |= m0;
+    memset(p + i0 + 1, 0xff, i1 - i0 - 1);
+    p[i1] |= m1;
+  }
+}
+
 void JBIG2Bitmap::duplicateRow(int yDest, int ySrc) {
   memcpy(data + yDest * line, data + ySrc * line, line);
 }
@@ -1143,13 +1169,199 @@ JBIG2CodeTable::~JBIG2CodeTable() {
   gfree(table);
 }
 
+//------------------------------------------------------------------------
+// JBIG2GlobalsCache
+//------------------------------------------------------------------------
+
+#if MULTITHREADED
+#  define jbig2GlobalsLocker()   MutexLocker locker(&mutex)
+#else
+#  define jbig2GlobalsLocker()
+#endif
+
+struct JBIG2Globals {
+  Ref ref;
+  GooList *segments;		// [JBIG2Segment]
+  Guint size;			// estimated memory held by the segments
+  int refCnt;			// one for the cache, while the entry is
+				//   in it, plus one for each stream
+};
+
+static Guint jbig2BitmapSize(JBIG2Bitmap *bitmap) {
+  return bitmap ? sizeof(JBIG2Bitmap) + bitmap->getDataSize() : 0;
+}
+
+// Estimate the memory held by a list of decoded segments.
+static Guint jbig2SegmentsSize(GooList *segments) {
+  JBIG2Segment *seg;
+  JBIG2SymbolDict *symbolDict;
+  JBIG2PatternDict *patternDict;
+  Guint size, i;
+  int j;
+
+  size = 0;
+  for (j = 0; j < segments->getLength(); ++j) {
+    seg = (JBIG2Segment *)segments->get(j);
+    switch (seg->getType()) {
+    case jbig2SegBitmap:
+      size += jbig2BitmapSize((JBIG2Bitmap *)seg);
+      break;
+    case jbig2SegSymbolDict:
+      symbolDict = (JBIG2SymbolDict *)seg;
+      size += sizeof(JBIG2SymbolDict) +
+	      symbolDict->getSize() * sizeof(JBIG2Bitmap *);
+      for (i = 0; i < symbolDict->getSize(); ++i) {
+	size += jbig2BitmapSize(symbolDict->getBitmap(i));
+      }
+      break;
+    case jbig2SegPatternDict:
+      patternDict = (JBIG2PatternDict *)seg;
+      size += sizeof(JBIG2PatternDict) +
+	      patternDict->getSize() * sizeof(JBIG2Bitmap *);
+      for (i = 0; i < patternDict->getSize(); ++i) {
+	size += jbig2BitmapSize(patternDict->getBitmap(i));
+      }
+      break;
+    case jbig2SegCodeTable:
+      size += sizeof(JBIG2CodeTable);
+      break;
+    }
+  }
+  return size;
+}
+
+JBIG2GlobalsCache::JBIG2GlobalsCache(Guint maxBytesA) {
+  entries = new GooList();
+  bytes = 0;
+  maxBytes = maxBytesA;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+JBIG2GlobalsCache::~JBIG2GlobalsCache() {
+  // streams must not outlive the cache
+  clear();
+  delete entries;
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void JBIG2GlobalsCache::setMaxBytes(Guint maxBytesA) {
+  jbig2GlobalsLocker();
+  maxBytes = maxBytesA;
+  evict();
+}
+
+// Return the entry for <ref>, with a reference for the caller, or NULL
+// if the stream has not been decoded yet.
+JBIG2Globals *JBIG2GlobalsCache::lookup(Ref ref) {
+  JBIG2Globals *globals;
+  int i;
+
+  jbig2GlobalsLocker();
+  for (i = 0; i < entries->getLength(); ++i) {
+    globals = (JBIG2Globals *)entries->get(i);
+    if (globals->ref.num == ref.num && globals->ref.gen == ref.gen) {
+      // move it to the end of the LRU list
+      entries->del(i);
+      entries->append(globals);
+      ++globals->refCnt;
+      return globals;
+    }
+  }
+  return NULL;
+}
+
+// Add the segments decoded from <ref>, and return the entry, with a
+// reference for the caller.  If another stream has added them in the
+// meantime, <segments> is deleted and the existing entry is returned.
+// Segments larger than the budget are not kept in the cache: the
+// entry then only belongs to the caller.
+JBIG2Globals *JBIG2GlobalsCache::add(Ref ref, GooList *segments) {
+  JBIG2Globals *globals;
+  Guint size;
+  int i;
+
+  size = jbig2SegmentsSize(segments);
+
+  jbig2GlobalsLocker();
+  for (i = 0; i < entries->getLength(); ++i) {
+    globals = (JBIG2Globals *)entries->get(i);
+    if (globals->ref.num == ref.num && globals->ref.gen == ref.gen) {
+      deleteGooList(segments, JBIG2Segment);
+      ++globals->refCnt;
+      return globals;
+    }
+  }
+  globals = new JBIG2Globals;
+  globals->ref = ref;
+  globals->segments = segments;
+  globals->size = size;
+  globals->refCnt = 1;
+  if (size <= maxBytes) {
+    ++globals->refCnt;
+    entries->append(globals);
+    bytes += size;
+    evict();
+  }
+  return globals;
+}
+
+void JBIG2GlobalsCache::release(JBIG2Globals *globals) {
+  jbig2GlobalsLocker();
+  if (--globals->refCnt == 0) {
+    deleteGooList(globals->segments, JBIG2Segment);
+    delete globals;
+  }
+}
+
+// Take entry <i> out of the cache.  Callers must hold the lock.
+void JBIG2GlobalsCache::drop(int i) {
+  JBIG2Globals *globals;
+
+  globals = (JBIG2Globals *)entries->del(i);
+  bytes -= globals->size;
+  release(globals);
+}
+
+// Drop the least recently used globals until they fit in the budget.
+// Callers must hold the lock.
+void JBIG2GlobalsCache::evict() {
+  while (bytes > maxBytes && entries->getLength() > 0) {
+    drop(0);
+  }
+}
+
+void JBIG2GlobalsCache::remove(int num) {
+  int i;
+
+  jbig2GlobalsLocker();
+  for (i = entries->getLength() - 1; i >= 0; --i) {
+    if (((JBIG2Globals *)entries->get(i))->ref.num == num) {
+      drop(i);
+    }
+  }
+}
+
+void JBIG2GlobalsCache::clear() {
+  jbig2GlobalsLocker();
+  while (entries->getLength() > 0) {
+    drop(entries->getLength() - 1);
+  }
+}
+
 //------------------------------------------------------------------------
 // JBIG2Stream
 //------------------------------------------------------------------------
 
-JBIG2Stream::JBIG2Stream(Stream *strA, Object *globalsStreamA):
+JBIG2Stream::JBIG2Stream(Stream *strA, Object *globalsStreamA,
+			 Object *globalsStreamRefA):
   FilterStream(strA)
 {
+  XRef *xref;
+
   pageBitmap = NULL;
 
   arithDecoder = new JArithmeticDecoder();
@@ -1173,6 +1385,17 @@ JBIG2Stream::JBIG2Stream(Stream *strA, Object *globalsStreamA):
   mmrDecoder = new JBIG2MMRDecoder();
 
   globalsStreamA->copy(&globalsStream);
+  globalsCache = NULL;
+  if (globalsStreamRefA->isRef() && globalsStream.isStream()) {
+    globalsStreamRef = globalsStreamRefA->getRef();
+    xref = globalsStream.streamGetDict()->getXRef();
+    if (xref) {
+      globalsCache = xref->getJBIG2GlobalsCache();
+    }
+  } else {
+    globalsStreamRef.num = globalsStreamRef.gen = -1;
+  }
+  sharedGlobals = NULL;
   segments = globalSegments = NULL;
   curStr = NULL;
   dataPtr = dataEnd = NULL;
@@ -1204,17 +1427,30 @@ JBIG2Stream::~JBIG2Stream() {
 }
 
 void JBIG2Stream::reset() {
-  // read the globals stream
-  globalSegments = new GooList();
-  if (globalsStream.isStream()) {
-    segments = globalSegments;
-    curStr = globalsStream.getStream();
-    curStr->reset();
-    arithDecoder->setStream(curStr);
-    huffDecoder->setStream(curStr);
-    mmrDecoder->setStream(curStr);
-    readSegments();
-    curStr->close();
+  // read the globals stream, unless another stream of the document has
+  // already decoded it
+  if (globalsCache &&
+      (sharedGlobals = globalsCache->lookup(globalsStreamRef))) {
+    globalSegments = sharedGlobals->segments;
+  } else {
+    globalSegments = new GooList();
+    if (globalsStream.isStream()) {
+      segments = globalSegments;
+      curStr = globalsStream.getStream();
+      curStr->reset();
+      arithDecoder->setStream(curStr);
+      huffDecoder->setStream(curStr);
+      mmrDecoder->setStream(curStr);
+      readSegments();
+      curStr->close();
+
+      // globals are not supposed to set up the page, but if they do,
+      // they can't be shared
+      if (globalsCache && !pageBitmap) {
+	sharedGlobals = globalsCache->add(globalsStreamRef, globalSegments);
+	globalSegments = sharedGlobals->segments;
+      }
+    }
   }
 
   // read the main stream
@@ -1243,7 +1479,11 @@ void JBIG2Stream::close() {
     deleteGooList(segments, JBIG2Segment);
     segments = NULL;
   }
-  if (globalSegments) {
+  if (sharedGlobals) {
+    globalsCache->release(sharedGlobals);
+    sharedGlobals = NULL;
+    globalSegments = NULL;
+  } else if (globalSegments) {
     deleteGooList(globalSegments, JBIG2Segment);
     globalSegments = NULL;
   }
@@ -2838,7 +3078,9 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
   Guint atBuf0, atBuf1, atBuf2, atBuf3;
   int atShift0, atShift1, atShift2, atShift3;
   Guchar mask;
-  int x, y, x0, x1, a0i, b1i, blackPixels, pix, i;
+  Guchar *zeroLine;
+  GBool nominalAT;
+  int x, y, x0, x1, a0i, b1i, blackPixels, pix, line, i;
 
   bitmap = new JBIG2Bitmap(0, w, h);
   if (!bitmap->isOk()) {
@@ -3039,15 +3281,11 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
       }
 
       // convert the run lengths to a bitmap line
-      i = 0;
-      while (1) {
-	for (x = codingLine[i]; x < codingLine[i+1]; ++x) {
-	  bitmap->setPixel(x, y);
-	}
-	if (codingLine[i+1] >= w || codingLine[i+2] >= w) {
+      for (i = 0; codingLine[i] < w; i += 2) {
+	bitmap->setPixels(codingLine[i], codingLine[i+1], y);
+	if (codingLine[i+1] >= w) {
 	  break;
 	}
-	i += 2;
       }
     }
 
@@ -3084,6 +3322,32 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
       }
     }
 
+    // the adaptive template pixels are nearly always left at their
+    // nominal positions: in that case (unless there is a skip bitmap)
+    // the rows are decoded by readGenericBitmapRow, with all of the
+    // context taken from the previous two rows
+    switch (templ) {
+    case 0:
+      nominalAT = atx[0] == 3 && aty[0] == -1 && atx[1] == -3 &&
+	          aty[1] == -1 && atx[2] == 2 && aty[2] == -2 &&
+	          atx[3] == -2 && aty[3] == -2;
+      break;
+    case 1:
+      nominalAT = atx[0] == 3 && aty[0] == -1;
+      break;
+    default:
+      nominalAT = atx[0] == 2 && aty[0] == -1;
+      break;
+    }
+    nominalAT = nominalAT && !useSkip;
+    line = bitmap->getLineSize();
+    zeroLine = NULL;
+    if (nominalAT) {
+      // stands in for the rows above the top of the bitmap
+      zeroLine = (Guchar *)gmalloc(line);
+      memset(zeroLine, 0, line);
+    }
+
     ltp = 0;
     cx = cx0 = cx1 = cx2 = 0; // make gcc happy
     for (y = 0; y < h; ++y) {
@@ -3101,6 +3365,16 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 	}
       }
 
+      if (nominalAT) {
+	readGenericBitmapRow(templ,
+			     y >= 2 ? bitmap->getDataPtr() + (y - 2) * line
+			            : zeroLine,
+			     y >= 1 ? bitmap->getDataPtr() + (y - 1) * line
+			            : zeroLine,
+			     bitmap->getDataPtr() + y * line, w);
+	continue;
+      }
+
       switch (templ) {
       case 0:
 
@@ -3600,11 +3874,91 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 	break;
       }
     }
+
+    gfree(zeroLine);
   }
 
   return bitmap;
 }
 
+// Decode one row of a generic region whose adaptive template pixels
+// are at their nominal positions.  <p0> and <p1> point to the two rows
+// above, and <pp> to the row to decode, which must be clear.  buf0 and
+// buf1 hold the pixels of rows y-2 and y-1, with pixel x at bit 15
+// (and the pixels to its right below it); buf2 holds the pixels
+// decoded so far in row y, with pixel x-1 at bit 0.  The context is
+// assembled from these in the same layout as in readGenericBitmap, and
+// the row is stored a byte at a time.
+void JBIG2Stream::readGenericBitmapRow(int templ, Guchar *p0, Guchar *p1,
+				       Guchar *pp, int w) {
+  Guint buf0, buf1, buf2, cx;
+  int x0, x1, n;
+
+  buf0 = *p0++ << 8;
+  buf1 = *p1++ << 8;
+  buf2 = 0;
+  for (x0 = 0; x0 < w; x0 += 8) {
+    if (x0 + 8 < w) {
+      buf0 |= *p0++;
+      buf1 |= *p1++;
+    }
+    n = w - x0 < 8 ? w - x0 : 8;
+
+    switch (templ) {
+    case 0:
+      for (x1 = 0; x1 < n; ++x1) {
+	cx = ((buf0 >> 1) & 0xe000) |	// (x-1..x+1, y-2)
+	     ((buf1 >> 5) & 0x1f00) |	// (x-2..x+2, y-1)
+	     ((buf2 << 4) & 0x00f0) |	// (x-4..x-1, y)
+	     ((buf1 >> 9) & 0x0008) |	// A1 = (x+3, y-1)
+	     ((buf1 >> 16) & 0x0004) |	// A2 = (x-3, y-1)
+	     ((buf0 >> 12) & 0x0002) |	// A3 = (x+2, y-2)
+	     ((buf0 >> 17) & 0x0001);	// A4 = (x-2, y-2)
+	buf2 = (buf2 << 1) | arithDecoder->decodeBit(cx, genericRegionStats);
+	buf0 <<= 1;
+	buf1 <<= 1;
+      }
+      break;
+
+    case 1:
+      for (x1 = 0; x1 < n; ++x1) {
+	cx = ((buf0 >> 4) & 0x1e00) |	// (x-1..x+2, y-2)
+	     ((buf1 >> 9) & 0x01f0) |	// (x-2..x+2, y-1)
+	     ((buf2 << 1) & 0x000e) |	// (x-3..x-1, y)
+	     ((buf1 >> 12) & 0x0001);	// A1 = (x+3, y-1)
+	buf2 = (buf2 << 1) | arithDecoder->decodeBit(cx, genericRegionStats);
+	buf0 <<= 1;
+	buf1 <<= 1;
+      }
+      break;
+
+    case 2:
+      for (x1 = 0; x1 < n; ++x1) {
+	cx = ((buf0 >> 7) & 0x0380) |	// (x-1..x+1, y-2)
+	     ((buf1 >> 11) & 0x0078) |	// (x-2..x+1, y-1)
+	     ((buf2 << 1) & 0x0006) |	// (x-2..x-1, y)
+	     ((buf1 >> 13) & 0x0001);	// A1 = (x+2, y-1)
+	buf2 = (buf2 << 1) | arithDecoder->decodeBit(cx, genericRegionStats);
+	buf0 <<= 1;
+	buf1 <<= 1;
+      }
+      break;
+
+    case 3:
+      for (x1 = 0; x1 < n; ++x1) {
+	cx = ((buf1 >> 9) & 0x03e0) |	// (x-3..x+1, y-1)
+	     ((buf2 << 1) & 0x001e) |	// (x-4..x-1, y)
+	     ((buf1 >> 13) & 0x0001);	// A1 = (x+2, y-1)
+	buf2 = (buf2 << 1) | arithDecoder->decodeBit(cx, genericRegionStats);
+	buf1 <<= 1;
+      }
+      break;
+    }
+
+    *pp++ = (Guchar)(buf2 << (8 - n));
+  }
+}
+
 void JBIG2Stream::readGenericRefinementRegionSeg(Guint segNum, GBool imm,
 						 GBool lossless, Guint length,
 						 Guint *refSegs,
@@ -4049,7 +4403,10 @@ void JBIG2Stream::discardSegment(Guint segNum) {
   for (i = 0; i < globalSegments->getLength(); ++i) {
     seg = (JBIG2Segment *)globalSegments->get(i);
     if (seg->getSegNum() == segNum) {
-      globalSegments->del(i);
+      // shared globals are read-only: the segment is left in them
+      if (!sharedGlobals) {
+	globalSegments->del(i);
+      }
       return;
     }
   }
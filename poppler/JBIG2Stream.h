@@ -27,12 +27,19 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
 #include "goo/gtypes.h"
 #include "Object.h"
 #include "Stream.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class GooList;
 class JBIG2Segment;
+struct JBIG2Globals;
+class JBIG2GlobalsCache;
 class JBIG2Bitmap;
 class JArithmeticDecoder;
 class JArithmeticDecoderStats;
@@ -45,7 +52,8 @@ class JBIG2MMRDecoder;
 class JBIG2Stream: public FilterStream {
 public:
 
-  JBIG2Stream(Stream *strA, Object *globalsStreamA);
+  JBIG2Stream(Stream *strA, Object *globalsStreamA,
+	      Object *globalsStreamRefA);
   virtual ~JBIG2Stream();
   virtual StreamKind getKind() { return strJBIG2; }
   virtual void reset();
@@ -102,6 +110,8 @@ private:
 				 GBool useSkip, JBIG2Bitmap *skip,
 				 int *atx, int *aty,
 				 int mmrDataLength);
+  void readGenericBitmapRow(int templ, Guchar *p0, Guchar *p1,
+			    Guchar *pp, int w);
   void readGenericRefinementRegionSeg(Guint segNum, GBool imm,
 				      GBool lossless, Guint length,
 				      Guint *refSegs,
@@ -130,6 +140,14 @@ private:
   GBool readLong(int *x);
 
   Object globalsStream;
+  Ref globalsStreamRef;		// num is -1 if the globals stream is
+				//   not an indirect object
+  JBIG2GlobalsCache *globalsCache; // the document's cache of decoded
+				//   globals streams (NULL if not
+				//   available)
+  JBIG2Globals *sharedGlobals;	// the cache entry that globalSegments
+				//   comes from, or NULL if they are
+				//   private to this stream
   Guint pageW, pageH, curPageH;
   Guint pageDefPixel;
   JBIG2Bitmap *pageBitmap;
@@ -161,4 +179,49 @@ private:
   JBIG2MMRDecoder *mmrDecoder;
 };
 
+//------------------------------------------------------------------------
+// JBIG2GlobalsCache
+//------------------------------------------------------------------------
+
+// The segments decoded from the /JBIG2Globals streams of a document,
+// keyed by the Ref of the stream.  All the pages of a scanned document
+// usually share one globals stream: its symbol dictionaries are then
+// decoded once, and read by every JBIG2Stream that refers to it.  The
+// least recently used globals are dropped when their estimated size
+// exceeds <maxBytes>; streams that still read them keep them alive.
+class JBIG2GlobalsCache {
+public:
+
+  JBIG2GlobalsCache(Guint maxBytesA);
+  ~JBIG2GlobalsCache();
+
+  // Set the memory budget, dropping globals if needed.  Zero disables
+  // the cache.
+  void setMaxBytes(Guint maxBytesA);
+
+  // Drop the globals stream of object <num>.
+  void remove(int num);
+
+  // Drop all globals streams.
+  void clear();
+
+private:
+
+  JBIG2Globals *lookup(Ref ref);
+  JBIG2Globals *add(Ref ref, GooList *segments);
+  void release(JBIG2Globals *globals);
+  void drop(int i);
+  void evict();
+
+  GooList *entries;		// [JBIG2Globals], least recently used
+				//   first
+  Guint bytes;
+  Guint maxBytes;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+
+  friend class JBIG2Stream;
+};
+
 #endif
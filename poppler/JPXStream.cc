@@ -31,6 +31,10 @@
 #include "Error.h"
 #include "JArithmeticDecoder.h"
 #include "JPXStream.h"
+#include "GlobalParams.h"
+#if MULTITHREADED
+#include "goo/GooThreadPool.h"
+#endif
 
 //~ to do:
 //  - precincts
@@ -51,6 +55,10 @@
 
 //------------------------------------------------------------------------
 
+// images with fewer samples than this (width * height * components)
+// are decoded without the worker threads
+#define jpxMinParallelSamples (256 * 256)
+
 // number of contexts for the arithmetic decoder
 #define jpxNContexts        19
 
@@ -331,12 +339,8 @@ void JPXStream::close() {
 			  cb = &subband->cbs[k];
 			  gfree(cb->dataLen);
 			  gfree(cb->touched);
-			  if (cb->arithDecoder) {
-			    delete cb->arithDecoder;
-			  }
-			  if (cb->stats) {
-			    delete cb->stats;
-			  }
+			  gfree(cb->pktData);
+			  gfree(cb->pktSegs);
 			}
 			gfree(subband->cbs);
 		      }
@@ -888,7 +892,6 @@ GBool JPXStream::readColorSpecBox(Guint dataLen) {
 
 GBool JPXStream::readCodestream(Guint len) {
   JPXTile *tile;
-  JPXTileComp *tileComp;
   int segType;
   GBool haveSIZ, haveCOD, haveQCD, haveSOT;
   Guint precinctSize, style;
@@ -1465,11 +1468,10 @@ GBool JPXStream::readCodestream(Guint len) {
       error(errSyntaxError, getPos(), "Uninitialized tile in JPX codestream");
       return gFalse;
     }
-    for (comp = 0; comp < img.nComps; ++comp) {
-      tileComp = &tile->tileComps[comp];
-      inverseTransform(tileComp);
-    }
-    if (!inverseMultiCompAndDC(tile)) {
+  }
+  decodeTiles();
+  for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
+    if (!inverseMultiCompAndDC(&img.tiles[i])) {
       return gFalse;
     }
   }
@@ -2040,8 +2042,10 @@ GBool JPXStream::readTilePart() {
 		}
 		memset(cb->touched, 0,
 		       (1 << (tileComp->codeBlockW + tileComp->codeBlockH)));
-		cb->arithDecoder = NULL;
-		cb->stats = NULL;
+		cb->pktData = NULL;
+		cb->pktDataLen = cb->pktDataSize = 0;
+		cb->pktSegs = NULL;
+		cb->pktSegsLen = cb->pktSegsSize = 0;
 		++cb;
 	      }
 	    }
@@ -2291,8 +2295,7 @@ GBool JPXStream::readTilePartData(Guint tileIdx,
 	for (cbX = 0; cbX < subband->nXCBs; ++cbX) {
 	  cb = &subband->cbs[cbY * subband->nXCBs + cbX];
 	  if (cb->included) {
-	    if (!readCodeBlockData(tileComp, resLevel, precinct, subband,
-				   tile->res, sb, cb)) {
+	    if (!readCodeBlockData(tileComp, cb)) {
 	      return gFalse;
 	    }
 	    if (tileComp->codeBlockStyle & 0x04) {
@@ -2384,331 +2387,528 @@ GBool JPXStream::readTilePartData(Guint tileIdx,
   return gFalse;
 }
 
+// Read the code-block's data from the current packet.  The data is
+// only collected here; it's decoded by decodeCodeBlock once the whole
+// codestream has been read.
 GBool JPXStream::readCodeBlockData(JPXTileComp *tileComp,
-				   JPXResLevel *resLevel,
-				   JPXPrecinct *precinct,
-				   JPXSubband *subband,
-				   Guint res, Guint sb,
 				   JPXCodeBlock *cb) {
+  Guint nSegs, n, i;
+  int c;
+
+  // record the number of coding passes and the data lengths
+  nSegs = (tileComp->codeBlockStyle & 0x04) ? cb->nCodingPasses : 1;
+  if (cb->pktSegsLen + 1 + nSegs > cb->pktSegsSize) {
+    cb->pktSegsSize = 2 * cb->pktSegsSize + 1 + nSegs;
+    cb->pktSegs = (Guint *)greallocn(cb->pktSegs, cb->pktSegsSize,
+				     sizeof(Guint));
+  }
+  cb->pktSegs[cb->pktSegsLen++] = cb->nCodingPasses;
+  n = 0;
+  for (i = 0; i < nSegs; ++i) {
+    cb->pktSegs[cb->pktSegsLen++] = cb->dataLen[i];
+    n += cb->dataLen[i];
+  }
+
+  // read the data -- the arithmetic decoder reads past the end of its
+  // data as 0xff bytes, so there's no need to store anything past EOF
+  for (i = 0; i < n; ++i) {
+    if ((c = bufStr->getChar()) == EOF) {
+      break;
+    }
+    if (cb->pktDataLen == cb->pktDataSize) {
+      cb->pktDataSize = 2 * cb->pktDataSize + 256;
+      cb->pktData = (Guchar *)grealloc(cb->pktData, cb->pktDataSize);
+    }
+    cb->pktData[cb->pktDataLen++] = (Guchar)c;
+  }
+
+  return gTrue;
+}
+
+//------------------------------------------------------------------------
+
+// The code-blocks of all the tiles, or all the tile-components, to be
+// decoded by decodeTiles.
+struct JPXDecodeTask {
+  JPXTileComp *tileComp;
+  Guint res, sb;
+  JPXCodeBlock *cb;		// NULL to inverse transform tileComp
+};
+
+struct JPXDecodeJob {
+  JPXStream *str;
+  JPXDecodeTask *tasks;
+  int nTasks;
+  int nThreads;			// threads to spread the tasks over
+
+  void runTask(int i);
+};
+
+void JPXDecodeJob::runTask(int i) {
+  JPXDecodeTask *task;
+
+  task = &tasks[i];
+  if (task->cb) {
+    str->decodeCodeBlock(task->tileComp, task->res, task->sb, task->cb);
+  } else {
+    str->inverseTransform(task->tileComp);
+  }
+}
+
+static void runJPXDecodeTask(void *data, int i) {
+  ((JPXDecodeJob *)data)->runTask(i);
+}
+
+// Decode the code-blocks of all the tiles, and then inverse transform
+// all the tile-components.  Code-blocks and tile-components are
+// independent of each other, so each of the two steps is spread over
+// the threads of the GlobalParams JPX decode pool; the result is the
+// same as when decoding them in order.  Small images are decoded by
+// the calling thread only.
+void JPXStream::decodeTiles() {
+  JPXDecodeJob job;
+  JPXDecodeTask *tasks;
+  JPXTile *tile;
+  JPXTileComp *tileComp;
+  JPXResLevel *resLevel;
+  JPXSubband *subband;
+  JPXCodeBlock *cb;
+  Guint i, comp, r, sb, k;
+  int nTasks;
+
+  // code-blocks
+  nTasks = 0;
+  for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
+    tile = &img.tiles[i];
+    for (comp = 0; comp < img.nComps; ++comp) {
+      tileComp = &tile->tileComps[comp];
+      for (r = 0; r <= tileComp->nDecompLevels; ++r) {
+	resLevel = &tileComp->resLevels[r];
+	for (sb = 0; sb < (Guint)(r == 0 ? 1 : 3); ++sb) {
+	  subband = &resLevel->precincts[0].subbands[sb];
+	  nTasks += subband->nXCBs * subband->nYCBs;
+	}
+      }
+    }
+  }
+  if (nTasks < (int)(img.nXTiles * img.nYTiles * img.nComps)) {
+    nTasks = img.nXTiles * img.nYTiles * img.nComps;
+  }
+  tasks = (JPXDecodeTask *)gmallocn(nTasks, sizeof(JPXDecodeTask));
+  nTasks = 0;
+  for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
+    tile = &img.tiles[i];
+    for (comp = 0; comp < img.nComps; ++comp) {
+      tileComp = &tile->tileComps[comp];
+      for (r = 0; r <= tileComp->nDecompLevels; ++r) {
+	resLevel = &tileComp->resLevels[r];
+	for (sb = 0; sb < (Guint)(r == 0 ? 1 : 3); ++sb) {
+	  subband = &resLevel->precincts[0].subbands[sb];
+	  for (k = 0; k < subband->nXCBs * subband->nYCBs; ++k) {
+	    cb = &subband->cbs[k];
+	    if (cb->pktSegsLen > 0) {
+	      tasks[nTasks].tileComp = tileComp;
+	      tasks[nTasks].res = r;
+	      tasks[nTasks].sb = sb;
+	      tasks[nTasks].cb = cb;
+	      ++nTasks;
+	    }
+	  }
+	}
+      }
+    }
+  }
+  job.str = this;
+  job.tasks = tasks;
+  job.nTasks = nTasks;
+  job.nThreads = 1;
+#if MULTITHREADED
+  if ((double)(img.xSize - img.xOffset) * (double)(img.ySize - img.yOffset) *
+      img.nComps >= jpxMinParallelSamples) {
+    job.nThreads = globalParams ? globalParams->getJPXDecodeThreads() : 1;
+    if (job.nThreads <= 0) {
+      job.nThreads = globalParams->getJPXDecodePool()->getMaxThreads();
+    }
+  }
+#endif
+  runDecodeJob(&job);
+
+  // tile-components
+  nTasks = 0;
+  for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
+    tile = &img.tiles[i];
+    for (comp = 0; comp < img.nComps; ++comp) {
+      tasks[nTasks].tileComp = &tile->tileComps[comp];
+      tasks[nTasks].cb = NULL;
+      ++nTasks;
+    }
+  }
+  job.nTasks = nTasks;
+  runDecodeJob(&job);
+
+  gfree(tasks);
+}
+
+void JPXStream::runDecodeJob(JPXDecodeJob *job) {
+  int i;
+
+#if MULTITHREADED
+  if (job->nThreads > 1) {
+    globalParams->getJPXDecodePool()->run(&runJPXDecodeTask, job,
+					  job->nTasks, job->nThreads);
+    return;
+  }
+#endif
+  for (i = 0; i < job->nTasks; ++i) {
+    job->runTask(i);
+  }
+}
+
+// Decode the coefficients of a code-block from the data collected by
+// readCodeBlockData.  This only touches the code-block's own
+// coefficients, so different code-blocks can be decoded in parallel.
+void JPXStream::decodeCodeBlock(JPXTileComp *tileComp, Guint res, Guint sb,
+				JPXCodeBlock *cb) {
+  MemStream *dataStr;
+  JArithmeticDecoder *arithDecoder;
+  JArithmeticDecoderStats *stats;
+  Object dictObj;
   int *coeff0, *coeff1, *coeff;
   char *touched0, *touched1, *touched;
   Guint horiz, vert, diag, all, cx, xorBit;
   int horizSign, vertSign, bit;
   int segSym;
-  Guint i, x, y0, y1;
+  Guint *dataLen;
+  Guint seg, nCodingPasses, i, x, y0, y1;
+
+  dictObj.initNull();
+  dataStr = new MemStream((char *)cb->pktData, 0, cb->pktDataLen, &dictObj);
+  arithDecoder = NULL;
+  stats = NULL;
+
+  // replay the packets which included this code-block
+  for (seg = 0; seg < cb->pktSegsLen; ) {
+    nCodingPasses = cb->pktSegs[seg++];
+    dataLen = &cb->pktSegs[seg];
+    seg += (tileComp->codeBlockStyle & 0x04) ? nCodingPasses : 1;
+
+    if (arithDecoder) {
+      cover(63);
+      arithDecoder->restart(dataLen[0]);
+    } else {
+      cover(64);
+      arithDecoder = new JArithmeticDecoder();
+      arithDecoder->setStream(dataStr, dataLen[0]);
+      arithDecoder->start();
+      stats = new JArithmeticDecoderStats(jpxNContexts);
+      stats->setEntry(jpxContextSigProp, 4, 0);
+      stats->setEntry(jpxContextRunLength, 3, 0);
+      stats->setEntry(jpxContextUniform, 46, 0);
+    }
 
-  if (cb->arithDecoder) {
-    cover(63);
-    cb->arithDecoder->restart(cb->dataLen[0]);
-  } else {
-    cover(64);
-    cb->arithDecoder = new JArithmeticDecoder();
-    cb->arithDecoder->setStream(bufStr, cb->dataLen[0]);
-    cb->arithDecoder->start();
-    cb->stats = new JArithmeticDecoderStats(jpxNContexts);
-    cb->stats->setEntry(jpxContextSigProp, 4, 0);
-    cb->stats->setEntry(jpxContextRunLength, 3, 0);
-    cb->stats->setEntry(jpxContextUniform, 46, 0);
-  }
-
-  for (i = 0; i < cb->nCodingPasses; ++i) {
-    if ((tileComp->codeBlockStyle & 0x04) && i > 0) {
-      cb->arithDecoder->setStream(bufStr, cb->dataLen[i]);
-      cb->arithDecoder->start();
-    }
-
-    switch (cb->nextPass) {
-
-    //----- significance propagation pass
-    case jpxPassSigProp:
-      cover(65);
-      for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 * tileComp->w,
-	     touched0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
-	     x < cb->x1;
-	     ++x, ++coeff1, ++touched1) {
-	  for (y1 = 0, coeff = coeff1, touched = touched1;
-	       y1 < 4 && y0+y1 < cb->y1;
-	       ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
-	    if (!*coeff) {
-	      horiz = vert = diag = 0;
-	      horizSign = vertSign = 2;
-	      if (x > cb->x0) {
-		if (coeff[-1]) {
-		  ++horiz;
-		  horizSign += coeff[-1] < 0 ? -1 : 1;
-		}
-		if (y0+y1 > cb->y0) {
-		  diag += coeff[-(int)tileComp->w - 1] ? 1 : 0;
-		}
-		if (y0+y1 < cb->y1 - 1 &&
-		    (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		  diag += coeff[tileComp->w - 1] ? 1 : 0;
+    for (i = 0; i < nCodingPasses; ++i) {
+      if ((tileComp->codeBlockStyle & 0x04) && i > 0) {
+	arithDecoder->setStream(dataStr, dataLen[i]);
+	arithDecoder->start();
+      }
+
+      switch (cb->nextPass) {
+
+      //----- significance propagation pass
+      case jpxPassSigProp:
+	cover(65);
+	for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 * tileComp->w,
+	       touched0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
+	       x < cb->x1;
+	       ++x, ++coeff1, ++touched1) {
+	    for (y1 = 0, coeff = coeff1, touched = touched1;
+		 y1 < 4 && y0+y1 < cb->y1;
+		 ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
+	      if (!*coeff) {
+		horiz = vert = diag = 0;
+		horizSign = vertSign = 2;
+		if (x > cb->x0) {
+		  if (coeff[-1]) {
+		    ++horiz;
+		    horizSign += coeff[-1] < 0 ? -1 : 1;
+		  }
+		  if (y0+y1 > cb->y0) {
+		    diag += coeff[-(int)tileComp->w - 1] ? 1 : 0;
+		  }
+		  if (y0+y1 < cb->y1 - 1 &&
+		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		    diag += coeff[tileComp->w - 1] ? 1 : 0;
+		  }
 		}
-	      }
-	      if (x < cb->x1 - 1) {
-		if (coeff[1]) {
-		  ++horiz;
-		  horizSign += coeff[1] < 0 ? -1 : 1;
+		if (x < cb->x1 - 1) {
+		  if (coeff[1]) {
+		    ++horiz;
+		    horizSign += coeff[1] < 0 ? -1 : 1;
+		  }
+		  if (y0+y1 > cb->y0) {
+		    diag += coeff[-(int)tileComp->w + 1] ? 1 : 0;
+		  }
+		  if (y0+y1 < cb->y1 - 1 &&
+		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		    diag += coeff[tileComp->w + 1] ? 1 : 0;
+		  }
 		}
 		if (y0+y1 > cb->y0) {
-		  diag += coeff[-(int)tileComp->w + 1] ? 1 : 0;
+		  if (coeff[-(int)tileComp->w]) {
+		    ++vert;
+		    vertSign += coeff[-(int)tileComp->w] < 0 ? -1 : 1;
+		  }
 		}
 		if (y0+y1 < cb->y1 - 1 &&
 		    (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		  diag += coeff[tileComp->w + 1] ? 1 : 0;
-		}
-	      }
-	      if (y0+y1 > cb->y0) {
-		if (coeff[-(int)tileComp->w]) {
-		  ++vert;
-		  vertSign += coeff[-(int)tileComp->w] < 0 ? -1 : 1;
-		}
-	      }
-	      if (y0+y1 < cb->y1 - 1 &&
-		  (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		if (coeff[tileComp->w]) {
-		  ++vert;
-		  vertSign += coeff[tileComp->w] < 0 ? -1 : 1;
+		  if (coeff[tileComp->w]) {
+		    ++vert;
+		    vertSign += coeff[tileComp->w] < 0 ? -1 : 1;
+		  }
 		}
-	      }
-	      cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
-	      if (cx != 0) {
-		if (cb->arithDecoder->decodeBit(cx, cb->stats)) {
-		  cx = signContext[horizSign][vertSign][0];
-		  xorBit = signContext[horizSign][vertSign][1];
-		  if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		    *coeff = -1;
-		  } else {
-		    *coeff = 1;
+		cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
+		if (cx != 0) {
+		  if (arithDecoder->decodeBit(cx, stats)) {
+		    cx = signContext[horizSign][vertSign][0];
+		    xorBit = signContext[horizSign][vertSign][1];
+		    if (arithDecoder->decodeBit(cx, stats) ^ xorBit) {
+		      *coeff = -1;
+		    } else {
+		      *coeff = 1;
+		    }
 		  }
+		  *touched = 1;
 		}
-		*touched = 1;
 	      }
 	    }
 	  }
 	}
-      }
-      ++cb->nextPass;
-      break;
+	++cb->nextPass;
+	break;
 
-    //----- magnitude refinement pass
-    case jpxPassMagRef:
-      cover(66);
-      for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 * tileComp->w,
-	     touched0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
-	     x < cb->x1;
-	     ++x, ++coeff1, ++touched1) {
-	  for (y1 = 0, coeff = coeff1, touched = touched1;
-	       y1 < 4 && y0+y1 < cb->y1;
-	       ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
-	    if (*coeff && !*touched) {
-	      if (*coeff == 1 || *coeff == -1) {
-		all = 0;
-		if (x > cb->x0) {
-		  all += coeff[-1] ? 1 : 0;
-		  if (y0+y1 > cb->y0) {
-		    all += coeff[-(int)tileComp->w - 1] ? 1 : 0;
+      //----- magnitude refinement pass
+      case jpxPassMagRef:
+	cover(66);
+	for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 * tileComp->w,
+	       touched0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
+	       x < cb->x1;
+	       ++x, ++coeff1, ++touched1) {
+	    for (y1 = 0, coeff = coeff1, touched = touched1;
+		 y1 < 4 && y0+y1 < cb->y1;
+		 ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
+	      if (*coeff && !*touched) {
+		if (*coeff == 1 || *coeff == -1) {
+		  all = 0;
+		  if (x > cb->x0) {
+		    all += coeff[-1] ? 1 : 0;
+		    if (y0+y1 > cb->y0) {
+		      all += coeff[-(int)tileComp->w - 1] ? 1 : 0;
+		    }
+		    if (y0+y1 < cb->y1 - 1 &&
+			(!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		      all += coeff[tileComp->w - 1] ? 1 : 0;
+		    }
 		  }
-		  if (y0+y1 < cb->y1 - 1 &&
-		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		    all += coeff[tileComp->w - 1] ? 1 : 0;
+		  if (x < cb->x1 - 1) {
+		    all += coeff[1] ? 1 : 0;
+		    if (y0+y1 > cb->y0) {
+		      all += coeff[-(int)tileComp->w + 1] ? 1 : 0;
+		    }
+		    if (y0+y1 < cb->y1 - 1 &&
+			(!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		      all += coeff[tileComp->w + 1] ? 1 : 0;
+		    }
 		  }
-		}
-		if (x < cb->x1 - 1) {
-		  all += coeff[1] ? 1 : 0;
 		  if (y0+y1 > cb->y0) {
-		    all += coeff[-(int)tileComp->w + 1] ? 1 : 0;
+		    all += coeff[-(int)tileComp->w] ? 1 : 0;
 		  }
 		  if (y0+y1 < cb->y1 - 1 &&
 		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		    all += coeff[tileComp->w + 1] ? 1 : 0;
+		    all += coeff[tileComp->w] ? 1 : 0;
 		  }
+		  cx = all ? 15 : 14;
+		} else {
+		  cx = 16;
 		}
-		if (y0+y1 > cb->y0) {
-		  all += coeff[-(int)tileComp->w] ? 1 : 0;
-		}
-		if (y0+y1 < cb->y1 - 1 &&
-		    (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		  all += coeff[tileComp->w] ? 1 : 0;
+		bit = arithDecoder->decodeBit(cx, stats);
+		if (*coeff < 0) {
+		  *coeff = (*coeff << 1) - bit;
+		} else {
+		  *coeff = (*coeff << 1) + bit;
 		}
-		cx = all ? 15 : 14;
-	      } else {
-		cx = 16;
-	      }
-	      bit = cb->arithDecoder->decodeBit(cx, cb->stats);
-	      if (*coeff < 0) {
-		*coeff = (*coeff << 1) - bit;
-	      } else {
-		*coeff = (*coeff << 1) + bit;
+		*touched = 1;
 	      }
-	      *touched = 1;
 	    }
 	  }
 	}
-      }
-      ++cb->nextPass;
-      break;
+	++cb->nextPass;
+	break;
 
-    //----- cleanup pass
-    case jpxPassCleanup:
-      cover(67);
-      for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 * tileComp->w,
-	     touched0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
-	     x < cb->x1;
-	     ++x, ++coeff1, ++touched1) {
-	  y1 = 0;
-	  if (y0 + 3 < cb->y1 &&
-	      !(*touched1) &&
-	      !(touched1[tileComp->cbW]) &&
-	      !(touched1[2 * tileComp->cbW]) &&
-	      !(touched1[3 * tileComp->cbW]) &&
-	      (x == cb->x0 || y0 == cb->y0 ||
-	       !coeff1[-(int)tileComp->w - 1]) &&
-	      (y0 == cb->y0 ||
-	       !coeff1[-(int)tileComp->w]) &&
-	      (x == cb->x1 - 1 || y0 == cb->y0 ||
-	       !coeff1[-(int)tileComp->w + 1]) &&
-	      (x == cb->x0 ||
-	       (!coeff1[-1] &&
-		!coeff1[tileComp->w - 1] &&
-		!coeff1[2 * tileComp->w - 1] && 
-		!coeff1[3 * tileComp->w - 1])) &&
-	      (x == cb->x1 - 1 ||
-	       (!coeff1[1] &&
-		!coeff1[tileComp->w + 1] &&
-		!coeff1[2 * tileComp->w + 1] &&
-		!coeff1[3 * tileComp->w + 1])) &&
-	      ((tileComp->codeBlockStyle & 0x08) ||
-	       ((x == cb->x0 || y0+4 == cb->y1 ||
-		 !coeff1[4 * tileComp->w - 1]) &&
-		(y0+4 == cb->y1 ||
-		 !coeff1[4 * tileComp->w]) &&
-		(x == cb->x1 - 1 || y0+4 == cb->y1 ||
-		 !coeff1[4 * tileComp->w + 1])))) {
-	    if (cb->arithDecoder->decodeBit(jpxContextRunLength, cb->stats)) {
-	      y1 = cb->arithDecoder->decodeBit(jpxContextUniform, cb->stats);
-	      y1 = (y1 << 1) |
-		   cb->arithDecoder->decodeBit(jpxContextUniform, cb->stats);
-	      coeff = &coeff1[y1 * tileComp->w];
-	      cx = signContext[2][2][0];
-	      xorBit = signContext[2][2][1];
-	      if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		*coeff = -1;
+      //----- cleanup pass
+      case jpxPassCleanup:
+	cover(67);
+	for (y0 = cb->y0, coeff0 = cb->coeffs, touched0 = cb->touched;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 * tileComp->w,
+	       touched0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0, touched1 = touched0;
+	       x < cb->x1;
+	       ++x, ++coeff1, ++touched1) {
+	    y1 = 0;
+	    if (y0 + 3 < cb->y1 &&
+		!(*touched1) &&
+		!(touched1[tileComp->cbW]) &&
+		!(touched1[2 * tileComp->cbW]) &&
+		!(touched1[3 * tileComp->cbW]) &&
+		(x == cb->x0 || y0 == cb->y0 ||
+		 !coeff1[-(int)tileComp->w - 1]) &&
+		(y0 == cb->y0 ||
+		 !coeff1[-(int)tileComp->w]) &&
+		(x == cb->x1 - 1 || y0 == cb->y0 ||
+		 !coeff1[-(int)tileComp->w + 1]) &&
+		(x == cb->x0 ||
+		 (!coeff1[-1] &&
+		  !coeff1[tileComp->w - 1] &&
+		  !coeff1[2 * tileComp->w - 1] && 
+		  !coeff1[3 * tileComp->w - 1])) &&
+		(x == cb->x1 - 1 ||
+		 (!coeff1[1] &&
+		  !coeff1[tileComp->w + 1] &&
+		  !coeff1[2 * tileComp->w + 1] &&
+		  !coeff1[3 * tileComp->w + 1])) &&
+		((tileComp->codeBlockStyle & 0x08) ||
+		 ((x == cb->x0 || y0+4 == cb->y1 ||
+		   !coeff1[4 * tileComp->w - 1]) &&
+		  (y0+4 == cb->y1 ||
+		   !coeff1[4 * tileComp->w]) &&
+		  (x == cb->x1 - 1 || y0+4 == cb->y1 ||
+		   !coeff1[4 * tileComp->w + 1])))) {
+	      if (arithDecoder->decodeBit(jpxContextRunLength, stats)) {
+		y1 = arithDecoder->decodeBit(jpxContextUniform, stats);
+		y1 = (y1 << 1) |
+		     arithDecoder->decodeBit(jpxContextUniform, stats);
+		coeff = &coeff1[y1 * tileComp->w];
+		cx = signContext[2][2][0];
+		xorBit = signContext[2][2][1];
+		if (arithDecoder->decodeBit(cx, stats) ^ xorBit) {
+		  *coeff = -1;
+		} else {
+		  *coeff = 1;
+		}
+		++y1;
 	      } else {
-		*coeff = 1;
+		y1 = 4;
 	      }
-	      ++y1;
-	    } else {
-	      y1 = 4;
 	    }
-	  }
-	  for (coeff = &coeff1[y1 * tileComp->w],
-		 touched = &touched1[y1 << tileComp->codeBlockW];
-	       y1 < 4 && y0 + y1 < cb->y1;
-	       ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
-	    if (!*touched) {
-	      horiz = vert = diag = 0;
-	      horizSign = vertSign = 2;
-	      if (x > cb->x0) {
-		if (coeff[-1]) {
-		  ++horiz;
-		  horizSign += coeff[-1] < 0 ? -1 : 1;
-		}
-		if (y0+y1 > cb->y0) {
-		  diag += coeff[-(int)tileComp->w - 1] ? 1 : 0;
-		}
-		if (y0+y1 < cb->y1 - 1 &&
-		    (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		  diag += coeff[tileComp->w - 1] ? 1 : 0;
+	    for (coeff = &coeff1[y1 * tileComp->w],
+		   touched = &touched1[y1 << tileComp->codeBlockW];
+		 y1 < 4 && y0 + y1 < cb->y1;
+		 ++y1, coeff += tileComp->w, touched += tileComp->cbW) {
+	      if (!*touched) {
+		horiz = vert = diag = 0;
+		horizSign = vertSign = 2;
+		if (x > cb->x0) {
+		  if (coeff[-1]) {
+		    ++horiz;
+		    horizSign += coeff[-1] < 0 ? -1 : 1;
+		  }
+		  if (y0+y1 > cb->y0) {
+		    diag += coeff[-(int)tileComp->w - 1] ? 1 : 0;
+		  }
+		  if (y0+y1 < cb->y1 - 1 &&
+		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		    diag += coeff[tileComp->w - 1] ? 1 : 0;
+		  }
 		}
-	      }
-	      if (x < cb->x1 - 1) {
-		if (coeff[1]) {
-		  ++horiz;
-		  horizSign += coeff[1] < 0 ? -1 : 1;
+		if (x < cb->x1 - 1) {
+		  if (coeff[1]) {
+		    ++horiz;
+		    horizSign += coeff[1] < 0 ? -1 : 1;
+		  }
+		  if (y0+y1 > cb->y0) {
+		    diag += coeff[-(int)tileComp->w + 1] ? 1 : 0;
+		  }
+		  if (y0+y1 < cb->y1 - 1 &&
+		      (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
+		    diag += coeff[tileComp->w + 1] ? 1 : 0;
+		  }
 		}
 		if (y0+y1 > cb->y0) {
-		  diag += coeff[-(int)tileComp->w + 1] ? 1 : 0;
+		  if (coeff[-(int)tileComp->w]) {
+		    ++vert;
+		    vertSign += coeff[-(int)tileComp->w] < 0 ? -1 : 1;
+		  }
 		}
 		if (y0+y1 < cb->y1 - 1 &&
 		    (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		  diag += coeff[tileComp->w + 1] ? 1 : 0;
-		}
-	      }
-	      if (y0+y1 > cb->y0) {
-		if (coeff[-(int)tileComp->w]) {
-		  ++vert;
-		  vertSign += coeff[-(int)tileComp->w] < 0 ? -1 : 1;
-		}
-	      }
-	      if (y0+y1 < cb->y1 - 1 &&
-		  (!(tileComp->codeBlockStyle & 0x08) || y1 < 3)) {
-		if (coeff[tileComp->w]) {
-		  ++vert;
-		  vertSign += coeff[tileComp->w] < 0 ? -1 : 1;
+		  if (coeff[tileComp->w]) {
+		    ++vert;
+		    vertSign += coeff[tileComp->w] < 0 ? -1 : 1;
+		  }
 		}
-	      }
-	      cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
-	      if (cb->arithDecoder->decodeBit(cx, cb->stats)) {
-		cx = signContext[horizSign][vertSign][0];
-		xorBit = signContext[horizSign][vertSign][1];
-		if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		  *coeff = -1;
-		} else {
-		  *coeff = 1;
+		cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
+		if (arithDecoder->decodeBit(cx, stats)) {
+		  cx = signContext[horizSign][vertSign][0];
+		  xorBit = signContext[horizSign][vertSign][1];
+		  if (arithDecoder->decodeBit(cx, stats) ^ xorBit) {
+		    *coeff = -1;
+		  } else {
+		    *coeff = 1;
+		  }
 		}
+	      } else {
+		*touched = 0;
 	      }
-	    } else {
-	      *touched = 0;
 	    }
 	  }
 	}
+	++cb->len;
+	// look for a segmentation symbol
+	if (tileComp->codeBlockStyle & 0x20) {
+	  segSym = arithDecoder->decodeBit(jpxContextUniform, stats) << 3;
+	  segSym |= arithDecoder->decodeBit(jpxContextUniform, stats) << 2;
+	  segSym |= arithDecoder->decodeBit(jpxContextUniform, stats) << 1;
+	  segSym |= arithDecoder->decodeBit(jpxContextUniform, stats);
+	  if (segSym != 0x0a) {
+	    // in theory this should be a fatal error, but it seems to
+	    // be problematic
+	    error(errSyntaxWarning, getPos(),
+		  "Missing or invalid segmentation symbol in JPX stream");
+	  }
+	}
+	cb->nextPass = jpxPassSigProp;
+	break;
       }
-      ++cb->len;
-      // look for a segmentation symbol
-      if (tileComp->codeBlockStyle & 0x20) {
-	segSym = cb->arithDecoder->decodeBit(jpxContextUniform,
-					     cb->stats) << 3;
-	segSym |= cb->arithDecoder->decodeBit(jpxContextUniform,
-					      cb->stats) << 2;
-	segSym |= cb->arithDecoder->decodeBit(jpxContextUniform,
-					      cb->stats) << 1;
-	segSym |= cb->arithDecoder->decodeBit(jpxContextUniform,
-					      cb->stats);
-	if (segSym != 0x0a) {
-	  // in theory this should be a fatal error, but it seems to
-	  // be problematic
-	  error(errSyntaxWarning, getPos(),
-		"Missing or invalid segmentation symbol in JPX stream");
-	}
-      }
-      cb->nextPass = jpxPassSigProp;
-      break;
-    }
 
-    if (tileComp->codeBlockStyle & 0x02) {
-      cb->stats->reset();
-      cb->stats->setEntry(jpxContextSigProp, 4, 0);
-      cb->stats->setEntry(jpxContextRunLength, 3, 0);
-      cb->stats->setEntry(jpxContextUniform, 46, 0);
-    }
+      if (tileComp->codeBlockStyle & 0x02) {
+	stats->reset();
+	stats->setEntry(jpxContextSigProp, 4, 0);
+	stats->setEntry(jpxContextRunLength, 3, 0);
+	stats->setEntry(jpxContextUniform, 46, 0);
+      }
 
-    if (tileComp->codeBlockStyle & 0x04) {
-      cb->arithDecoder->cleanup();
+      if (tileComp->codeBlockStyle & 0x04) {
+	arithDecoder->cleanup();
+      }
     }
+
+    arithDecoder->cleanup();
   }
 
-  cb->arithDecoder->cleanup();
-  return gTrue;
+  delete arithDecoder;
+  delete stats;
+  delete dataStr;
+
+  // the data isn't needed any more
+  gfree(cb->pktData);
+  cb->pktData = NULL;
+  cb->pktDataLen = cb->pktDataSize = 0;
 }
 
 // Inverse quantization, and wavelet transform (IDWT).  This also does
@@ -17,8 +17,7 @@
 #include "Object.h"
 #include "Stream.h"
 
-class JArithmeticDecoder;
-class JArithmeticDecoderStats;
+struct JPXDecodeJob;
 
 //------------------------------------------------------------------------
 
@@ -119,14 +118,19 @@ struct JPXCodeBlock {
   Guint *dataLen;		// data lengths (one per codeword segment)
   Guint dataLenSize;		// size of the dataLen array
 
+  //----- data from all packets (decoded once the codestream is read)
+  Guchar *pktData;		// codeword segment data
+  Guint pktDataLen;		// number of bytes in pktData
+  Guint pktDataSize;		// size of the pktData array
+  Guint *pktSegs;		// for each packet: number of coding passes,
+				//   followed by the data lengths
+  Guint pktSegsLen;		// number of entries in pktSegs
+  Guint pktSegsSize;		// size of the pktSegs array
+
   //----- coefficient data
   int *coeffs;
   char *touched;		// coefficient 'touched' flags
   Gushort len;			// coefficient length
-  JArithmeticDecoder		// arithmetic decoder
-    *arithDecoder;
-  JArithmeticDecoderStats	// arithmetic decoder stats
-    *stats;
 };
 
 //------------------------------------------------------------------------
@@ -282,12 +286,11 @@ private:
   GBool readTilePart();
   GBool readTilePartData(Guint tileIdx,
 			 Guint tilePartLen, GBool tilePartToEOC);
-  GBool readCodeBlockData(JPXTileComp *tileComp,
-			  JPXResLevel *resLevel,
-			  JPXPrecinct *precinct,
-			  JPXSubband *subband,
-			  Guint res, Guint sb,
-			  JPXCodeBlock *cb);
+  GBool readCodeBlockData(JPXTileComp *tileComp, JPXCodeBlock *cb);
+  void decodeTiles();
+  void runDecodeJob(JPXDecodeJob *job);
+  void decodeCodeBlock(JPXTileComp *tileComp, Guint res, Guint sb,
+		       JPXCodeBlock *cb);
   void inverseTransform(JPXTileComp *tileComp);
   void inverseTransformLevel(JPXTileComp *tileComp,
 			     Guint r, JPXResLevel *resLevel);
@@ -333,6 +336,8 @@ private:
   Guint curX, curY, curComp;	// current position for lookChar/getChar
   Guint readBuf;		// read buffer
   Guint readBufLen;		// number of valid bits in readBuf
+
+  friend struct JPXDecodeJob;
 };
 
 #endif
@@ -72,6 +72,9 @@ Lexer::Lexer(XRef *xrefA, Stream *str) {
 
   lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
   xref = xrefA;
+  arena = NULL;
+  bufStart = bufPtr = bufEnd = NULL;
+  peekable = gTrue;
 
   curStr.initStream(str);
   streams = new Array(xref);
@@ -86,6 +89,9 @@ Lexer::Lexer(XRef *xrefA, Object *obj) {
 
   lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
   xref = xrefA;
+  arena = NULL;
+  bufStart = bufPtr = bufEnd = NULL;
+  peekable = gTrue;
 
   if (obj->isStream()) {
     streams = new Array(xref);
@@ -112,7 +118,14 @@ Lexer::~Lexer() {
   }
 }
 
-int Lexer::getChar(GBool comesFromLook) {
+inline int Lexer::getChar(GBool comesFromLook) {
+  if (bufPtr < bufEnd) {
+    return *bufPtr++;
+  }
+  return getCharSlow(comesFromLook);
+}
+
+int Lexer::getCharSlow(GBool comesFromLook) {
   int c;
 
   if (LOOK_VALUE_NOT_CACHED != lookCharLastValueCached) {
@@ -121,6 +134,10 @@ int Lexer::getChar(GBool comesFromLook) {
     return c;
   }
 
+  if (fillWindow()) {
+    return *bufPtr++;
+  }
+
   c = EOF;
   while (!curStr.isNone() && (c = curStr.streamGetChar()) == EOF) {
     if (comesFromLook == gTrue) {
@@ -132,17 +149,24 @@ int Lexer::getChar(GBool comesFromLook) {
       if (strPtr < streams->getLength()) {
         streams->get(strPtr, &curStr);
         curStr.streamReset();
+        peekable = gTrue;
       }
     }
   }
   return c;
 }
 
-int Lexer::lookChar() {
+inline int Lexer::lookChar() {
   
+  if (bufPtr < bufEnd) {
+    return *bufPtr;
+  }
   if (LOOK_VALUE_NOT_CACHED != lookCharLastValueCached) {
     return lookCharLastValueCached;
   }
+  if (fillWindow()) {
+    return *bufPtr;
+  }
   lookCharLastValueCached = getChar(gTrue);
   if (lookCharLastValueCached == EOF) {
     lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
@@ -152,7 +176,38 @@ int Lexer::lookChar() {
   }
 }
 
+// Replace the window with the characters that follow it in the
+// current stream.  Returns false if there are none, or if the stream
+// can't be read that way; getChar() then falls back to
+// Stream::getChar().
+GBool Lexer::fillWindow() {
+  int n;
+
+  releaseWindow();
+  if (!peekable || !curStr.isStream()) {
+    return gFalse;
+  }
+  if (!(bufStart = curStr.getStream()->peekChars(&n))) {
+    peekable = gFalse;
+    return gFalse;
+  }
+  bufPtr = bufStart;
+  bufEnd = bufStart + n;
+  return n > 0;
+}
+
+void Lexer::skipChar() {
+  getChar();
+  releaseWindow();
+}
+
 Object *Lexer::getObj(Object *obj, int objNum) {
+  getToken(obj, objNum);
+  releaseWindow();
+  return obj;
+}
+
+Object *Lexer::getToken(Object *obj, int objNum) {
   char *p;
   int c, c2;
   GBool comment, neg, done, overflownInteger, overflownUnsignedInteger;
@@ -392,11 +447,15 @@ Object *Lexer::getObj(Object *obj, int objNum) {
       }
     } while (!done);
     if (n >= 0) {
-      if (!s)
-        s = new GooString(tokBuf, n);
-      else
-        s->append(tokBuf, n);
-      obj->initString(s);
+      if (!s && arena) {
+	obj->initArenaString(arena, tokBuf, n);
+      } else {
+	if (!s)
+	  s = new GooString(tokBuf, n);
+	else
+	  s->append(tokBuf, n);
+	obj->initString(s);
+      }
     } else {
       obj->initEOF();
     }
@@ -450,7 +509,11 @@ Object *Lexer::getObj(Object *obj, int objNum) {
     }
     if (n < tokBufSize) {
       *p = '\0';
-      obj->initName(tokBuf);
+      if (arena) {
+	obj->initArenaName(arena, tokBuf);
+      } else {
+	obj->initName(tokBuf);
+      }
     } else {
       obj->initName(s->getCString());
       delete s;
@@ -515,13 +578,17 @@ Object *Lexer::getObj(Object *obj, int objNum) {
 	  }
 	}
       }
-      if (!s)
-	s = new GooString(tokBuf, n);
-      else
-	s->append(tokBuf, n);
-      if (m == 1)
-	s->append((char)(c2 << 4));
-      obj->initString(s);
+      if (!s && m == 0 && arena) {
+	obj->initArenaString(arena, tokBuf, n);
+      } else {
+	if (!s)
+	  s = new GooString(tokBuf, n);
+	else
+	  s->append(tokBuf, n);
+	if (m == 1)
+	  s->append((char)(c2 << 4));
+	obj->initString(s);
+      }
     }
     break;
 
@@ -567,6 +634,8 @@ Object *Lexer::getObj(Object *obj, int objNum) {
       obj->initBool(gFalse);
     } else if (tokBuf[0] == 'n' && !strcmp(tokBuf, "null")) {
       obj->initNull();
+    } else if (arena) {
+      obj->initArenaCmd(arena, tokBuf);
     } else {
       obj->initCmd(tokBuf);
     }
@@ -582,15 +651,16 @@ void Lexer::skipToNextLine() {
   while (1) {
     c = getChar();
     if (c == EOF || c == '\n') {
-      return;
+      break;
     }
     if (c == '\r') {
       if ((c = lookChar()) == '\n') {
 	getChar();
       }
-      return;
+      break;
     }
   }
+  releaseWindow();
 }
 
 GBool Lexer::isSpace(int c) {
@@ -56,24 +56,30 @@ public:
   // Get the next object from the input stream.
   Object *getObj(Object *obj, int objNum = -1);
 
+  // Allocate strings, names and commands from <arenaA> (see
+  // Parser::enableArena), or from the heap if it is NULL.
+  void setArena(GooArena *arenaA) { arena = arenaA; }
+
   // Skip to the beginning of the next line in the input stream.
   void skipToNextLine();
 
   // Skip over one character.
-  void skipChar() { getChar(); }
+  void skipChar();
 
   // Get stream.
   Stream *getStream()
-    { return curStr.isStream() ? curStr.getStream() : (Stream *)NULL; }
+    { releaseWindow();
+      return curStr.isStream() ? curStr.getStream() : (Stream *)NULL; }
 
   // Get current position in file.  This is only used for error
   // messages, so it returns an int instead of a Guint.
   int getPos()
-    { return curStr.isStream() ? (int)curStr.streamGetPos() : -1; }
+    { releaseWindow();
+      return curStr.isStream() ? (int)curStr.streamGetPos() : -1; }
 
   // Set position in file.
   void setPos(Guint pos, int dir = 0)
-    { if (curStr.isStream()) curStr.streamSetPos(pos, dir); }
+    { releaseWindow(); if (curStr.isStream()) curStr.streamSetPos(pos, dir); }
 
   // Returns true if <c> is a whitespace character.
   static GBool isSpace(int c);
@@ -90,14 +96,31 @@ public:
 
 private:
 
+  Object *getToken(Object *obj, int objNum);
   int getChar(GBool comesFromLook = gFalse);
   int lookChar();
+  int getCharSlow(GBool comesFromLook);
+  GBool fillWindow();
+
+  // Consume the characters read from the window, so that the stream
+  // is positioned right after the last character returned by
+  // getChar(), and drop the window.
+  void releaseWindow()
+    { if (bufPtr != bufStart)
+	curStr.getStream()->skipPeekedChars((int)(bufPtr - bufStart));
+      bufStart = bufPtr = bufEnd = NULL; }
 
   Array *streams;		// array of input streams
   int strPtr;			// index of current stream
   Object curStr;		// current stream
   GBool freeArray;		// should lexer free the streams array?
   char tokBuf[tokBufSize];	// temporary token buffer
+  GooArena *arena;		// arena for token contents, or NULL
+  const Guchar *bufStart;	// window on the buffer of the current
+  const Guchar *bufPtr;		//   stream (see Stream::peekChars), only
+  const Guchar *bufEnd;		//   held during a call to the lexer
+  GBool peekable;		// does the current stream support
+				//   peekChars()?
 
   XRef *xref;
 };
@@ -27,6 +27,8 @@
 #endif
 
 #include <stddef.h>
+#include <new>
+#include "goo/GooArena.h"
 #include "Object.h"
 #include "Array.h"
 #include "Dict.h"
@@ -86,6 +88,56 @@ Object *Object::initStream(Stream *streamA) {
   return this;
 }
 
+Object *Object::initArenaString(GooArena *arena, const char *s, int length) {
+  initObj(objString);
+  string = new (arena->alloc(sizeof(GooString))) GooString(s, length);
+  inArena = gTrue;
+  return this;
+}
+
+Object *Object::initArenaName(GooArena *arena, const char *nameA) {
+  const char *atom;
+
+  initObj(objName);
+  if ((atom = atomLookup(nameA))) {
+    name = (char *)atom;
+  } else {
+    name = arena->copyString(nameA);
+    inArena = gTrue;
+  }
+  return this;
+}
+
+Object *Object::initArenaCmd(GooArena *arena, const char *cmdA) {
+  const char *atom;
+
+  initObj(objCmd);
+  if ((atom = atomLookup(cmdA))) {
+    cmd = (char *)atom;
+  } else {
+    cmd = arena->copyString(cmdA);
+    inArena = gTrue;
+  }
+  return this;
+}
+
+Object *Object::initArenaArray(XRef *xref, GooArena *arena) {
+  initObj(objArray);
+  array = new (arena->alloc(sizeof(Array))) Array(xref, arena);
+  inArena = gTrue;
+  return this;
+}
+
+void Object::moveToHeap() {
+  Object obj;
+
+  if (inArena) {
+    copy(&obj);
+    free();
+    *this = obj;
+  }
+}
+
 Object *Object::copy(Object *obj) {
   *obj = *this;
   switch (type) {
@@ -93,10 +145,14 @@ Object *Object::copy(Object *obj) {
     obj->string = string->copy();
     break;
   case objName:
-    obj->name = copyString(name);
+    obj->name = copyName(name);
     break;
   case objArray:
-    array->incRef();
+    if (inArena) {
+      obj->array = array->copy();
+    } else {
+      array->incRef();
+    }
     break;
   case objDict:
     dict->incRef();
@@ -105,11 +161,12 @@ Object *Object::copy(Object *obj) {
     stream->incRef();
     break;
   case objCmd:
-    obj->cmd = copyString(cmd);
+    obj->cmd = copyName(cmd);
     break;
   default:
     break;
   }
+  obj->inArena = gFalse;
 #ifdef DEBUG_MEM
   ++numAlloc[type];
 #endif
@@ -124,13 +181,21 @@ Object *Object::fetch(XRef *xref, Object *obj, int recursion) {
 void Object::free() {
   switch (type) {
   case objString:
-    delete string;
+    if (inArena) {
+      string->~GooString();
+    } else {
+      delete string;
+    }
     break;
   case objName:
-    gfree(name);
+    if (!inArena) {
+      freeName(name);
+    }
     break;
   case objArray:
-    if (!array->decRef()) {
+    if (inArena) {
+      array->~Array();
+    } else if (!array->decRef()) {
       delete array;
     }
     break;
@@ -145,7 +210,9 @@ void Object::free() {
     }
     break;
   case objCmd:
-    gfree(cmd);
+    if (!inArena) {
+      freeName(cmd);
+    }
     break;
   default:
     break;
@@ -154,6 +221,7 @@ void Object::free() {
   --numAlloc[type];
 #endif
   type = objNone;
+  inArena = gFalse;
 }
 
 const char *Object::getTypeName() {
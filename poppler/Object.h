@@ -39,6 +39,7 @@
 #include "goo/GooString.h"
 #include "goo/GooLikely.h"
 #include "Error.h"
+#include "Atom.h"
 
 #define OBJECT_TYPE_CHECK(wanted_type) \
     if (unlikely(type != wanted_type)) { \
@@ -58,6 +59,7 @@ class XRef;
 class Array;
 class Dict;
 class Stream;
+class GooArena;
 
 //------------------------------------------------------------------------
 // Ref
@@ -104,9 +106,9 @@ enum ObjType {
 //------------------------------------------------------------------------
 
 #ifdef DEBUG_MEM
-#define initObj(t) zeroUnion(); ++numAlloc[type = t]
+#define initObj(t) zeroUnion(); inArena = gFalse; ++numAlloc[type = t]
 #else
-#define initObj(t) zeroUnion(); type = t
+#define initObj(t) zeroUnion(); inArena = gFalse; type = t
 #endif
 
 class Object {
@@ -116,7 +118,7 @@ public:
 
   // Default constructor.
   Object():
-    type(objNone) { zeroUnion(); }
+    type(objNone), inArena(gFalse) { zeroUnion(); }
 
   // Initialize an object.
   Object *initBool(GBool boolnA)
@@ -128,7 +130,7 @@ public:
   Object *initString(GooString *stringA)
     { initObj(objString); string = stringA; return this; }
   Object *initName(const char *nameA)
-    { initObj(objName); name = copyString(nameA); return this; }
+    { initObj(objName); name = copyName(nameA); return this; }
   Object *initNull()
     { initObj(objNull); return this; }
   Object *initArray(XRef *xref);
@@ -138,7 +140,7 @@ public:
   Object *initRef(int numA, int genA)
     { initObj(objRef); ref.num = numA; ref.gen = genA; return this; }
   Object *initCmd(char *cmdA)
-    { initObj(objCmd); cmd = copyString(cmdA); return this; }
+    { initObj(objCmd); cmd = copyName(cmdA); return this; }
   Object *initError()
     { initObj(objError); return this; }
   Object *initEOF()
@@ -146,6 +148,19 @@ public:
   Object *initUint(unsigned int uintgA)
     { initObj(objUint); uintg = uintgA; return this; }
 
+  // Initialize an object whose contents are allocated from <arena>
+  // (see Parser::enableArena).  These are still released with free(),
+  // and copy() always returns an object that lives on the heap.
+  Object *initArenaString(GooArena *arena, const char *s, int length);
+  Object *initArenaName(GooArena *arena, const char *nameA);
+  Object *initArenaCmd(GooArena *arena, const char *cmdA);
+  Object *initArenaArray(XRef *xref, GooArena *arena);
+  GBool isInArena() { return inArena; }
+
+  // If the contents of this object live in an arena, replace them by
+  // a copy on the heap.
+  void moveToHeap();
+
   // Copy an object.
   Object *copy(Object *obj);
   Object *shallowCopy(Object *obj) {
@@ -179,13 +194,13 @@ public:
   GBool isNone() { return type == objNone; }
   GBool isUint() { return type == objUint; }
 
-  // Special type checking.
+  // Special type checking.  Atoms compare equal by pointer.
   GBool isName(const char *nameA)
-    { return type == objName && !strcmp(name, nameA); }
+    { return type == objName && (name == nameA || !strcmp(name, nameA)); }
   GBool isDict(const char *dictType);
   GBool isStream(char *dictType);
   GBool isCmd(const char *cmdA)
-    { return type == objCmd && !strcmp(cmd, cmdA); }
+    { return type == objCmd && (cmd == cmdA || !strcmp(cmd, cmdA)); }
 
   // Accessors.
   GBool getBool() { OBJECT_TYPE_CHECK(objBool); return booln; }
@@ -243,18 +258,19 @@ public:
 private:
 
   ObjType type;			// object type
+  GBool inArena;		// contents are allocated from an arena
   union {			// value for each type:
     GBool booln;		//   boolean
     int intg;			//   integer
     unsigned int uintg;		//   unsigned integer
     double real;		//   real
     GooString *string;		//   string
-    char *name;			//   name
+    char *name;			//   name (may be an atom)
     Array *array;		//   array
     Dict *dict;			//   dictionary
     Stream *stream;		//   stream
     Ref ref;			//   indirect reference
-    char *cmd;			//   command
+    char *cmd;			//   command (may be an atom)
   };
 
 #ifdef DEBUG_MEM
@@ -245,6 +245,15 @@ public:
   virtual void endActualText(GfxState * /*state*/) {}
 
   //----- image drawing
+
+  // How much can an image drawn with drawImage() be reduced before it
+  // is decoded?  Return n (1, 2, 4, or 8) to have it decoded at 1/n
+  // of its <width> x <height> size in each direction, if its stream
+  // allows that (see Stream::setImageScaleDenom()); drawImage() is
+  // then called with the reduced size.
+  virtual int getImageScaleDenom(GfxState * /*state*/,
+				 int /*width*/, int /*height*/) { return 1; }
+
   virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
 			     int width, int height, GBool invert, GBool interpolate,
 			     GBool inlineImg);
@@ -75,6 +75,12 @@
 #include "PDFDoc.h"
 #include "Hints.h"
 
+#if MULTITHREADED
+#  define pdfdocLocker()   MutexLocker locker(&mutex)
+#else
+#  define pdfdocLocker()
+#endif
+
 //------------------------------------------------------------------------
 
 #define headerSearchSize 1024	// read this many bytes at beginning of
@@ -94,6 +100,9 @@
 
 void PDFDoc::init()
 {
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
   ok = gFalse;
   errCode = errNone;
   fileName = NULL;
@@ -158,9 +167,16 @@ PDFDoc::PDFDoc(GooString *fileNameA, GooString *ownerPassword,
     return;
   }
 
-  // create stream
+  // create stream, reading from a memory mapping of the file if
+  // possible
   obj.initNull();
-  str = new FileStream(file, 0, gFalse, size, &obj);
+  str = NULL;
+  if (!globalParams || globalParams->getMapFiles()) {
+    str = MappedFileStream::create(file, &obj);
+  }
+  if (!str) {
+    str = new FileStream(file, 0, gFalse, size, &obj);
+  }
 
   ok = setup(ownerPassword, userPassword);
 }
@@ -342,6 +358,9 @@ PDFDoc::~PDFDoc() {
     gfree(fileNameU);
   }
 #endif
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
 }
 
 
@@ -516,6 +535,7 @@ void PDFDoc::processLinks(OutputDev *out, int page) {
 
 Linearization *PDFDoc::getLinearization()
 {
+  pdfdocLocker();
   if (!linearization) {
     linearization = new Linearization(str);
   }
@@ -597,6 +617,7 @@ GBool PDFDoc::getID(GooString *permanent_id, GooString *update_id) {
 
 Hints *PDFDoc::getHints()
 {
+  pdfdocLocker();
   if (!hints && isLinearized()) {
     hints = new Hints(str, getLinearization(), getXRef(), secHdlr);
   }
@@ -1453,6 +1474,7 @@ Guint PDFDoc::writePageObjects(OutStream *outStr, XRef *xRef, Guint numOffset)
 #ifndef DISABLE_OUTLINE
 Outline *PDFDoc::getOutline()
 {
+  pdfdocLocker();
   if (!outline) {
     // read outline
     outline = new Outline(catalog->getOutline(), xref);
@@ -1609,6 +1631,7 @@ Page *PDFDoc::parsePage(int page)
 
 Page *PDFDoc::getPage(int page)
 {
+  pdfdocLocker();
   if ((page < 1) || page > getNumPages()) return NULL;
 
   if (isLinearized()) {
@@ -38,6 +38,7 @@
 #endif
 
 #include <stdio.h>
+#include "poppler-config.h"
 #include "XRef.h"
 #include "Catalog.h"
 #include "Page.h"
@@ -317,6 +318,9 @@ private:
   int fopenErrno;
 
   Guint startXRefPos;		// offset of last xref table
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
 };
 
 #endif
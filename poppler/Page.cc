@@ -57,6 +57,12 @@
 #include "Catalog.h"
 #include "Form.h"
 
+#if MULTITHREADED
+#  define pageLocker()   MutexLocker locker(&mutex)
+#else
+#  define pageLocker()
+#endif
+
 //------------------------------------------------------------------------
 // PDFRectangle
 //------------------------------------------------------------------------
@@ -257,6 +263,9 @@ GBool PageAttrs::readBox(Dict *dict, const char *key, PDFRectangle *box) {
 Page::Page(PDFDoc *docA, int numA, Dict *pageDict, Ref pageRefA, PageAttrs *attrsA, Form *form) {
   Object tmp;
 	
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
   ok = gTrue;
   doc = docA;
   xref = doc->getXRef();
@@ -343,9 +352,13 @@ Page::~Page() {
   trans.free();
   thumb.free();
   actions.free();
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
 }
 
 Annots *Page::getAnnots() {
+  pageLocker();
   if (!annots) {
     Object obj;
     annots = new Annots(doc, num, getAnnots(&obj));
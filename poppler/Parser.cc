@@ -30,6 +30,9 @@
 #endif
 
 #include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include "goo/GooArena.h"
 #include "Object.h"
 #include "Array.h"
 #include "Dict.h"
@@ -48,6 +51,7 @@ Parser::Parser(XRef *xrefA, Lexer *lexerA, GBool allowStreamsA) {
   lexer = lexerA;
   inlineImg = 0;
   allowStreams = allowStreamsA;
+  arena = spareArena = NULL;
   lexer->getObj(&buf1);
   lexer->getObj(&buf2);
 }
@@ -56,6 +60,55 @@ Parser::~Parser() {
   buf1.free();
   buf2.free();
   delete lexer;
+  delete arena;
+  delete spareArena;
+}
+
+void Parser::enableArena() {
+  if (!arena) {
+    arena = new GooArena();
+    spareArena = new GooArena();
+    lexer->setArena(arena);
+  }
+}
+
+void Parser::resetArena() {
+  GooArena *a;
+
+  if (!arena) {
+    return;
+  }
+  // the two look-ahead tokens are still live: move them to the spare
+  // arena, which becomes the current one
+  spareArena->reset();
+  moveToSpareArena(&buf1);
+  moveToSpareArena(&buf2);
+  a = arena;
+  arena = spareArena;
+  spareArena = a;
+  lexer->setArena(arena);
+}
+
+void Parser::moveToSpareArena(Object *obj) {
+  Object obj2;
+
+  if (!obj->isInArena()) {
+    return;
+  }
+  // the lexer only returns strings, names and commands
+  if (obj->isString()) {
+    obj2.initArenaString(spareArena, obj->getString()->getCString(),
+			 obj->getString()->getLength());
+  } else if (obj->isName()) {
+    obj2.initArenaName(spareArena, obj->getName());
+  } else if (obj->isCmd()) {
+    obj2.initArenaCmd(spareArena, obj->getCmd());
+  } else {
+    obj->moveToHeap();
+    return;
+  }
+  obj->free();
+  *obj = obj2;
 }
 
 Object *Parser::getObj(Object *obj, int recursion)
@@ -74,7 +127,8 @@ Object *Parser::getObj(Object *obj, GBool simpleOnly,
   int num;
   DecryptStream *decrypt;
   GooString *s, *s2;
-  int c;
+  Guchar objKey[32], buf[256];
+  int objKeyLength, n;
 
   // refill buffer after inline image data
   if (inlineImg == 2) {
@@ -88,7 +142,11 @@ Object *Parser::getObj(Object *obj, GBool simpleOnly,
   // array
   if (!simpleOnly && likely(recursion < recursionLimit) && buf1.isCmd("[")) {
     shift();
-    obj->initArray(xref);
+    if (arena) {
+      obj->initArenaArray(xref, arena);
+    } else {
+      obj->initArray(xref);
+    }
     while (!buf1.isCmd("]") && !buf1.isEOF())
       obj->arrayAdd(getObj(&obj2, gFalse, fileKey, encAlgorithm, keyLength,
 			   objNum, objGen, recursion + 1));
@@ -109,14 +167,16 @@ Object *Parser::getObj(Object *obj, GBool simpleOnly,
 	shift();
       } else {
 	// buf1 might go away in shift(), so construct the key
-	key = copyString(buf1.getName());
+	key = copyName(buf1.getName());
 	shift();
 	if (buf1.isEOF() || buf1.isError()) {
-	  gfree(key);
+	  freeName(key);
 	  if (strict && buf1.isError()) goto err;
 	  break;
 	}
-	obj->dictAdd(key, getObj(&obj2, gFalse, fileKey, encAlgorithm, keyLength, objNum, objGen, recursion + 1));
+	getObj(&obj2, gFalse, fileKey, encAlgorithm, keyLength, objNum, objGen, recursion + 1);
+	obj2.moveToHeap();
+	obj->dictAdd(key, &obj2);
       }
     }
     if (buf1.isEOF()) {
@@ -155,13 +215,14 @@ Object *Parser::getObj(Object *obj, GBool simpleOnly,
     s = buf1.getString();
     s2 = new GooString();
     obj2.initNull();
+    objKeyLength = getObjectKey(fileKey, encAlgorithm, keyLength,
+				objNum, objGen, objKey);
     decrypt = new DecryptStream(new MemStream(s->getCString(), 0,
 					      s->getLength(), &obj2),
-				fileKey, encAlgorithm, keyLength,
-				objNum, objGen);
+				objKey, objKeyLength, encAlgorithm);
     decrypt->reset();
-    while ((c = decrypt->getChar()) != EOF) {
-      s2->append((char)c);
+    while ((n = decrypt->doGetChars(sizeof(buf), buf)) > 0) {
+      s2->append((char *)buf, n);
     }
     delete decrypt;
     obj->initString(s2);
@@ -193,7 +254,9 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
   Object obj;
   BaseStream *baseStr;
   Stream *str;
+  Guchar objKey[32];
   Guint pos, endPos, length;
+  int objKeyLength;
 
   // get stream start position
   lexer->skipToNextLine();
@@ -203,7 +266,8 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
   pos = str->getPos();
 
   // get length
-  dict->dictLookup("Length", &obj, recursion);
+  static const char *lengthAtom = atomLookup("Length");
+  dict->dictLookup(lengthAtom, &obj, recursion);
   if (obj.isInt()) {
     length = (Guint)obj.getInt();
     obj.free();
@@ -266,8 +330,9 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
 
   // handle decryption
   if (fileKey) {
-    str = new DecryptStream(str, fileKey, encAlgorithm, keyLength,
-			    objNum, objGen);
+    objKeyLength = getObjectKey(fileKey, encAlgorithm, keyLength,
+				objNum, objGen, objKey);
+    str = new DecryptStream(str, objKey, objKeyLength, encAlgorithm);
   }
 
   // get filters
@@ -276,6 +341,33 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
   return str;
 }
 
+#ifndef NDEBUG
+static GBool isXRefKey(XRef *xref, Guchar *fileKey,
+		       CryptAlgorithm encAlgorithm, int keyLength) {
+  Guchar *xrefKey;
+  CryptAlgorithm xrefAlgorithm;
+  int xrefKeyLength;
+
+  xref->getEncryptionParameters(&xrefKey, &xrefAlgorithm, &xrefKeyLength);
+  return encAlgorithm == xrefAlgorithm && keyLength == xrefKeyLength &&
+         !memcmp(fileKey, xrefKey, keyLength);
+}
+#endif
+
+// Objects fetched from an encrypted xref table are decrypted with its
+// file key, and their keys are cached there: the strings of an object
+// all use the same key.  The caller's key is then the xref's own.
+int Parser::getObjectKey(Guchar *fileKey, CryptAlgorithm encAlgorithm,
+			 int keyLength, int objNum, int objGen,
+			 Guchar *objKey) {
+  if (xref && xref->isEncrypted()) {
+    assert(isXRefKey(xref, fileKey, encAlgorithm, keyLength));
+    return xref->getObjectKey(objNum, objGen, objKey);
+  }
+  return Decrypt::makeObjectKey(encAlgorithm, fileKey, keyLength,
+				objNum, objGen, objKey);
+}
+
 void Parser::shift(int objNum) {
   if (inlineImg > 0) {
     if (inlineImg < 2) {
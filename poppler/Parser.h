@@ -54,6 +54,15 @@ public:
   
   Object *getObj(Object *obj, int recursion);
 
+  // Allocate the strings, names and arrays returned by getObj() from
+  // an arena rather than from the heap.  The objects are still
+  // released with Object::free(), which does not give the memory
+  // back; resetArena() does that, and may only be called once every
+  // object returned so far has been freed.  Dictionaries, and
+  // everything inside them, are always allocated on the heap.
+  void enableArena();
+  void resetArena();
+
   // Get stream.
   Stream *getStream() { return lexer->getStream(); }
 
@@ -67,12 +76,17 @@ private:
   GBool allowStreams;		// parse stream objects?
   Object buf1, buf2;		// next two tokens
   int inlineImg;		// set when inline image data is encountered
+  GooArena *arena;		// arena used by getObj(), or NULL
+  GooArena *spareArena;		// arena that resetArena() switches to
 
   Stream *makeStream(Object *dict, Guchar *fileKey,
 		     CryptAlgorithm encAlgorithm, int keyLength,
 		     int objNum, int objGen, int recursion,
 		     GBool strict);
+  int getObjectKey(Guchar *fileKey, CryptAlgorithm encAlgorithm,
+		   int keyLength, int objNum, int objGen, Guchar *objKey);
   void shift(int objNum = -1);
+  void moveToSpareArena(Object *obj);
 };
 
 #endif
@@ -52,6 +52,7 @@
 #include "GfxFont.h"
 #include "Page.h"
 #include "PDFDoc.h"
+#include "ImageCache.h"
 #include "Link.h"
 #include "FontEncodingTables.h"
 #include "fofi/FoFiTrueType.h"
@@ -1177,6 +1178,7 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
 		      colorMode != splashModeMono1;
   enableFreeTypeHinting = gFalse;
   enableSlightHinting = gFalse;
+  imageDownscaling = gTrue;
   setupScreenParams(72.0, 72.0);
   reverseVideo = reverseVideoA;
   if (paperColorA != NULL) {
@@ -2537,11 +2539,25 @@ GBool SplashOutputDev::imageMaskSrc(void *data, SplashColorPtr line) {
   SplashOutImageMaskData *imgMaskData = (SplashOutImageMaskData *)data;
   Guchar *p;
   SplashColorPtr q;
-  int x;
+  int *runs;
+  int n, val, x, i;
 
   if (imgMaskData->y == imgMaskData->height) {
     return gFalse;
   }
+
+  // fill the line a run at a time if the stream decodes runs
+  if ((n = imgMaskData->imgStr->getRunsLine(&runs, &val)) > 0) {
+    val ^= imgMaskData->invert;
+    for (i = 0, x = 0; i < n; ++i) {
+      memset(line + x, val, runs[i] - x);
+      x = runs[i];
+      val ^= 1;
+    }
+    ++imgMaskData->y;
+    return gTrue;
+  }
+
   if (!(p = imgMaskData->imgStr->getLine())) {
     return gFalse;
   }
@@ -2552,12 +2568,26 @@ GBool SplashOutputDev::imageMaskSrc(void *data, SplashColorPtr line) {
   return gTrue;
 }
 
+// Return a stream over the decoded data of image <ref> from the
+// document's image cache, or NULL if <str> has to be read instead.
+Stream *SplashOutputDev::getCachedImageStream(Object *ref, Stream *str,
+					      int width, int height,
+					      int nComps, int nBits,
+					      GBool inlineImg) {
+  if (inlineImg || !ref || !ref->isRef() || !doc) {
+    return NULL;
+  }
+  return doc->getXRef()->getImageCache()->getImageStream(
+	     ref->getRef(), str, width, height, nComps, nBits);
+}
+
 void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
 				    int width, int height, GBool invert,
 				    GBool interpolate, GBool inlineImg) {
   double *ctm;
   SplashCoord mat[6];
   SplashOutImageMaskData imgMaskData;
+  Stream *cachedStr;
 
   if (state->getFillColorSpace()->isNonMarking()) {
     return;
@@ -2576,7 +2606,9 @@ void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
   mat[4] = ctm[2] + ctm[4];
   mat[5] = ctm[3] + ctm[5];
 
-  imgMaskData.imgStr = new ImageStream(str, width, 1, 1);
+  cachedStr = getCachedImageStream(ref, str, width, height, 1, 1, inlineImg);
+  imgMaskData.imgStr = new ImageStream(cachedStr ? cachedStr : str,
+				       width, 1, 1);
   imgMaskData.imgStr->reset();
   imgMaskData.invert = invert ? 0 : 1;
   imgMaskData.width = width;
@@ -2594,7 +2626,11 @@ void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
   }
 
   delete imgMaskData.imgStr;
-  str->close();
+  if (cachedStr) {
+    delete cachedStr;
+  } else {
+    str->close();
+  }
 }
 
 void SplashOutputDev::setSoftMaskFromImageMask(GfxState *state,
@@ -2739,6 +2775,10 @@ GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
     switch (imgData->colorMode) {
     case splashModeMono1:
     case splashModeMono8:
+      if (imgData->colorMap->useCachedLines()) {
+	imgData->colorMap->getGrayLine(p, colorLine, imgData->width);
+	break;
+      }
       for (x = 0, q = colorLine; x < imgData->width; ++x, p += nComps) {
 	imgData->colorMap->getGray(p, &gray);
 	*q++ = colToByte(gray);
@@ -2746,6 +2786,10 @@ GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
       break;
     case splashModeRGB8:
     case splashModeBGR8:
+      if (imgData->colorMap->useCachedLines()) {
+	imgData->colorMap->getRGBLine(p, colorLine, imgData->width);
+	break;
+      }
       for (x = 0, q = colorLine; x < imgData->width; ++x, p += nComps) {
 	imgData->colorMap->getRGB(p, &rgb);
 	*q++ = colToByte(rgb.r);
@@ -2754,6 +2798,10 @@ GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
       }
       break;
     case splashModeXBGR8:
+      if (imgData->colorMap->useCachedLines()) {
+	imgData->colorMap->getRGBXLine(p, colorLine, imgData->width);
+	break;
+      }
       for (x = 0, q = colorLine; x < imgData->width; ++x, p += nComps) {
 	imgData->colorMap->getRGB(p, &rgb);
 	*q++ = colToByte(rgb.r);
@@ -2970,6 +3018,31 @@ GBool SplashOutputDev::tilingBitmapSrc(void *data, SplashColorPtr colorLine,
   return gTrue;
 }
 
+int SplashOutputDev::getImageScaleDenom(GfxState *state,
+					int width, int height) {
+  double *ctm;
+  double w, h;
+  int denom;
+
+  if (!imageDownscaling) {
+    return 1;
+  }
+
+  // size of the image on the bitmap: the lengths of the transformed
+  // unit square's sides
+  ctm = state->getCTM();
+  w = sqrt(ctm[0] * ctm[0] + ctm[1] * ctm[1]);
+  h = sqrt(ctm[2] * ctm[2] + ctm[3] * ctm[3]);
+
+  // reduce the image as long as it keeps at least one pixel per
+  // device pixel in both directions, so that Splash still has to
+  // scale it down
+  for (denom = 1;
+       denom < 8 && width >= 2 * denom * w && height >= 2 * denom * h;
+       denom *= 2) ;
+  return denom;
+}
+
 void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
 				int width, int height,
 				GfxImageColorMap *colorMap,
@@ -2980,6 +3053,7 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   SplashOutImageData imgData;
   SplashColorMode srcMode;
   SplashImageSource src;
+  Stream *cachedStr;
   GfxGray gray;
   GfxRGB rgb;
 #if SPLASH_CMYK
@@ -3000,7 +3074,10 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   mat[4] = ctm[2] + ctm[4];
   mat[5] = ctm[3] + ctm[5];
 
-  imgData.imgStr = new ImageStream(str, width,
+  cachedStr = getCachedImageStream(ref, str, width, height,
+				   colorMap->getNumPixelComps(),
+				   colorMap->getBits(), inlineImg);
+  imgData.imgStr = new ImageStream(cachedStr ? cachedStr : str, width,
 				   colorMap->getNumPixelComps(),
 				   colorMap->getBits());
   imgData.imgStr->reset();
@@ -3093,7 +3170,11 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
 
   gfree(imgData.lookup);
   delete imgData.imgStr;
-  str->close();
+  if (cachedStr) {
+    delete cachedStr;
+  } else {
+    str->close();
+  }
 }
 
 struct SplashOutMaskedImageData {
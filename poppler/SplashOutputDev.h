@@ -260,6 +260,7 @@ public:
   virtual void endTextObject(GfxState *state);
 
   //----- image drawing
+  virtual int getImageScaleDenom(GfxState *state, int width, int height);
   virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
 			     int width, int height, GBool invert,
 			     GBool interpolate, GBool inlineImg);
@@ -351,6 +352,11 @@ public:
 
   void setFreeTypeHinting(GBool enable, GBool enableSlightHinting);
 
+  // If <enable> is true (the default), images that are at least twice
+  // as large as their size on the bitmap are decoded at a reduced
+  // size, where the image format allows that.
+  void setImageDownscaling(GBool enable) { imageDownscaling = enable; }
+
 protected:
   void doUpdateFont(GfxState *state);
 
@@ -369,6 +375,9 @@ private:
 			  GBool dropEmptySubpaths);
   void drawType3Glyph(GfxState *state, T3FontCache *t3Font,
 		      T3FontCacheTag *tag, Guchar *data);
+  Stream *getCachedImageStream(Object *ref, Stream *str,
+			       int width, int height, int nComps, int nBits,
+			       GBool inlineImg);
   static GBool imageMaskSrc(void *data, SplashColorPtr line);
   static GBool imageSrc(void *data, SplashColorPtr colorLine,
 			Guchar *alphaLine);
@@ -389,6 +398,7 @@ private:
   GBool vectorAntialias;
   GBool enableFreeTypeHinting;
   GBool enableSlightHinting;
+  GBool imageDownscaling;
   GBool reverseVideo;		// reverse video mode
   SplashColor paperColor;	// paper color
   SplashScreenParams screenParams;
@@ -46,6 +46,12 @@
 #endif
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#if HAVE_MMAP && HAVE_SYS_MMAN_H
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
 #include "goo/gmem.h"
 #include "goo/gfile.h"
 #include "poppler-config.h"
@@ -57,6 +63,7 @@
 #include "JBIG2Stream.h"
 #include "Stream-CCITT.h"
 #include "CachedFile.h"
+#include "GlobalParams.h"
 
 #ifdef ENABLE_LIBJPEG
 #include "DCTStream.h"
@@ -90,9 +97,39 @@ static GBool setDJSYSFLAGS = gFalse;
 
 Stream::Stream() {
   ref = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 }
 
 Stream::~Stream() {
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+int Stream::incRef() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  ++ref;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return ref;
+}
+
+int Stream::decRef() {
+  int r;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  r = --ref;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return r;
 }
 
 void Stream::close() {
@@ -108,8 +145,9 @@ int Stream::getChars(int nChars, Guchar *buffer) {
   return 0;
 }
 
-void Stream::getRawChars(int nChars, int *buffer) {
+int Stream::getRawChars(int nChars, Guchar *buffer) {
   error(errInternal, -1, "Internal: called getRawChars() on non-predictor stream");
+  return 0;
 }
 
 char *Stream::getLine(char *buf, int size) {
@@ -138,21 +176,25 @@ GooString *Stream::getPSFilter(int psLevel, const char *indent) {
 }
 
 Stream *Stream::addFilters(Object *dict) {
+  static const char *filterAtom = atomLookup("Filter");
+  static const char *fAtom = atomLookup("F");
+  static const char *decodeParmsAtom = atomLookup("DecodeParms");
+  static const char *dpAtom = atomLookup("DP");
   Object obj, obj2;
   Object params, params2;
   Stream *str;
   int i;
 
   str = this;
-  dict->dictLookup("Filter", &obj);
+  dict->dictLookup(filterAtom, &obj);
   if (obj.isNull()) {
     obj.free();
-    dict->dictLookup("F", &obj);
+    dict->dictLookup(fAtom, &obj);
   }
-  dict->dictLookup("DecodeParms", &params);
+  dict->dictLookup(decodeParmsAtom, &params);
   if (params.isNull()) {
     params.free();
-    dict->dictLookup("DP", &params);
+    dict->dictLookup(dpAtom, &params);
   }
   if (obj.isName()) {
     str = makeFilter(obj.getName(), str, &params);
@@ -190,7 +232,7 @@ Stream *Stream::makeFilter(char *name, Stream *str, Object *params) {
   GBool endOfLine, byteAlign, endOfBlock, black;
   int columns, rows;
   int colorXform;
-  Object globals, obj;
+  Object globals, globalsRef, obj;
 
   if (!strcmp(name, "ASCIIHexDecode") || !strcmp(name, "AHx")) {
     str = new ASCIIHexStream(str);
@@ -306,13 +348,23 @@ Stream *Stream::makeFilter(char *name, Stream *str, Object *params) {
 	bits = obj.getInt();
       obj.free();
     }
+#ifdef ENABLE_ZLIB
+    if (!globalParams || globalParams->getFlateUseZlib()) {
+      str = new FlateZlibStream(str, pred, columns, colors, bits);
+    } else {
+      str = new FlateStream(str, pred, columns, colors, bits);
+    }
+#else
     str = new FlateStream(str, pred, columns, colors, bits);
+#endif
   } else if (!strcmp(name, "JBIG2Decode")) {
     if (params->isDict()) {
       params->dictLookup("JBIG2Globals", &globals);
+      params->dictLookupNF("JBIG2Globals", &globalsRef);
     }
-    str = new JBIG2Stream(str, &globals);
+    str = new JBIG2Stream(str, &globals, &globalsRef);
     globals.free();
+    globalsRef.free();
   } else if (!strcmp(name, "JPXDecode")) {
     str = new JPXStream(str);
   } else {
@@ -438,6 +490,8 @@ ImageStream::ImageStream(Stream *strA, int widthA, int nCompsA, int nBitsA) {
     imgLine = (Guchar *)gmallocn(imgLineSize, sizeof(Guchar));
   }
   imgIdx = nVals;
+  useRuns = nComps == 1 && nBits == 1 && str->hasGetRunsLine(width);
+  eofRuns[0] = width;
 }
 
 ImageStream::~ImageStream() {
@@ -476,7 +530,19 @@ Guchar *ImageStream::getLine() {
   int c;
   int i;
   Guchar *p;
- 
+  int *runs;
+  int n, x;
+
+  if (useRuns) {
+    n = getRunsLine(&runs, &c);
+    for (i = 0, x = 0; i < n; ++i) {
+      memset(imgLine + x, c, runs[i] - x);
+      x = runs[i];
+      c ^= 1;
+    }
+    return imgLine;
+  }
+
   int readChars = str->doGetChars(inputLineSize, inputLine);
   for ( ; readChars < inputLineSize; readChars++) inputLine[readChars] = EOF;
   if (nBits == 1) {
@@ -522,13 +588,166 @@ Guchar *ImageStream::getLine() {
 }
 
 void ImageStream::skipLine() {
-  str->doGetChars(inputLineSize, inputLine);
+  int *runs;
+  int firstVal;
+
+  if (useRuns) {
+    getRunsLine(&runs, &firstVal);
+  } else {
+    str->doGetChars(inputLineSize, inputLine);
+  }
+}
+
+int ImageStream::getRunsLine(int **runs, int *firstVal) {
+  int n;
+
+  if (!useRuns) {
+    return 0;
+  }
+  if (!(n = str->getRunsLine(runs, firstVal))) {
+    *runs = eofRuns;
+    *firstVal = 1;
+    n = 1;
+  }
+  return n;
 }
 
 //------------------------------------------------------------------------
 // StreamPredictor
 //------------------------------------------------------------------------
 
+// The PNG predictors are undone a line at a time by the functions
+// below, which decode the <n> bytes of <line> in place, given the
+// previous line <prev>.  The <bpp> bytes in front of both lines are
+// zeros.  The common pixel sizes have their own loops, which keep the
+// pixel to the left in registers, and the bytes of a machine word (or
+// of a 4-byte pixel) are added at once where they don't depend on each
+// other.
+
+#define predLow7Bits (~(Gulong)0 / 255 * 0x7f)
+#define predHighBit (~(Gulong)0 / 255 * 0x80)
+
+// bytewise sum (modulo 256) of <x> and <y>
+static inline Gulong predAddBytes(Gulong x, Gulong y) {
+  return ((x & predLow7Bits) + (y & predLow7Bits)) ^ ((x ^ y) & predHighBit);
+}
+
+// bytewise average (rounded down) of <x> and <y>
+static inline Gulong predAvgBytes(Gulong x, Gulong y) {
+  return (x & y) + (((x ^ y) >> 1) & predLow7Bits);
+}
+
+static void predPNGSub(Guchar *line, int bpp, int n) {
+  Guchar a0, a1, a2;
+  Guint p, q;
+  int i;
+
+  i = 0;
+  switch (bpp) {
+  case 1:
+    for (a0 = 0; i < n; ++i) {
+      a0 = line[i] = (Guchar)(line[i] + a0);
+    }
+    break;
+  case 3:
+    for (a0 = a1 = a2 = 0; i + 3 <= n; i += 3) {
+      a0 = line[i] = (Guchar)(line[i] + a0);
+      a1 = line[i + 1] = (Guchar)(line[i + 1] + a1);
+      a2 = line[i + 2] = (Guchar)(line[i + 2] + a2);
+    }
+    break;
+  case 4:
+    for (p = 0; i + 4 <= n; i += 4) {
+      memcpy(&q, line + i, 4);
+      p = (Guint)predAddBytes(q, p);
+      memcpy(line + i, &p, 4);
+    }
+    break;
+  }
+  // other pixel sizes, and a partial last pixel
+  for (; i < n; ++i) {
+    line[i] = (Guchar)(line[i] + line[i - bpp]);
+  }
+}
+
+static void predPNGUp(Guchar *line, Guchar *prev, int n) {
+  Gulong x, y;
+  int i;
+
+  for (i = 0; i + (int)sizeof(Gulong) <= n; i += sizeof(Gulong)) {
+    memcpy(&x, line + i, sizeof(Gulong));
+    memcpy(&y, prev + i, sizeof(Gulong));
+    x = predAddBytes(x, y);
+    memcpy(line + i, &x, sizeof(Gulong));
+  }
+  for (; i < n; ++i) {
+    line[i] = (Guchar)(line[i] + prev[i]);
+  }
+}
+
+static void predPNGAverage(Guchar *line, Guchar *prev, int bpp, int n) {
+  Guchar a0, a1, a2;
+  Guint p, q, u;
+  int i;
+
+  i = 0;
+  switch (bpp) {
+  case 1:
+    for (a0 = 0; i < n; ++i) {
+      a0 = line[i] = (Guchar)(line[i] + ((a0 + prev[i]) >> 1));
+    }
+    break;
+  case 3:
+    for (a0 = a1 = a2 = 0; i + 3 <= n; i += 3) {
+      a0 = line[i] = (Guchar)(line[i] + ((a0 + prev[i]) >> 1));
+      a1 = line[i + 1] = (Guchar)(line[i + 1] + ((a1 + prev[i + 1]) >> 1));
+      a2 = line[i + 2] = (Guchar)(line[i + 2] + ((a2 + prev[i + 2]) >> 1));
+    }
+    break;
+  case 4:
+    for (p = 0; i + 4 <= n; i += 4) {
+      memcpy(&q, line + i, 4);
+      memcpy(&u, prev + i, 4);
+      p = (Guint)predAddBytes(q, predAvgBytes(p, u));
+      memcpy(line + i, &p, 4);
+    }
+    break;
+  }
+  for (; i < n; ++i) {
+    line[i] = (Guchar)(line[i] + ((line[i - bpp] + prev[i]) >> 1));
+  }
+}
+
+// Paeth predictor for left <a>, up <b>, and upper left <c>
+static inline int predPaeth(int a, int b, int c) {
+  int pa, pb, pc, r;
+
+  // distances of a + b - c from a, b, and c
+  pa = abs(b - c);
+  pb = abs(a - c);
+  pc = abs(a + b - 2 * c);
+  // written as selects, which compile without branches
+  r = pb <= pc ? b : c;
+  return pa <= (pb <= pc ? pb : pc) ? a : r;
+}
+
+static void predPNGPaeth(Guchar *line, Guchar *prev, int bpp, int n) {
+  int a, b, c, i;
+
+  if (bpp == 1) {
+    for (a = c = 0, i = 0; i < n; ++i) {
+      b = prev[i];
+      a = line[i] = (Guchar)(line[i] + predPaeth(a, b, c));
+      c = b;
+    }
+  } else {
+    for (i = 0; i < n; ++i) {
+      line[i] = (Guchar)(line[i] + predPaeth(line[i - bpp], prev[i],
+					      prev[i - bpp]));
+    }
+  }
+}
+
 StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
 				 int widthA, int nCompsA, int nBitsA) {
   str = strA;
@@ -536,7 +755,7 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   width = widthA;
   nComps = nCompsA;
   nBits = nBitsA;
-  predLine = NULL;
+  predLine = prevLine = NULL;
   ok = gFalse;
 
   nVals = width * nComps;
@@ -551,6 +770,8 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   }
   predLine = (Guchar *)gmalloc(rowBytes);
   memset(predLine, 0, rowBytes);
+  prevLine = (Guchar *)gmalloc(rowBytes);
+  memset(prevLine, 0, rowBytes);
   predIdx = rowBytes;
 
   ok = gTrue;
@@ -558,6 +779,7 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
 
 StreamPredictor::~StreamPredictor() {
   gfree(predLine);
+  gfree(prevLine);
 }
 
 int StreamPredictor::lookChar() {
@@ -602,11 +824,10 @@ int StreamPredictor::getChars(int nChars, Guchar *buffer) {
 GBool StreamPredictor::getNextLine() {
   int curPred;
   Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
-  int left, up, upLeft, p, pa, pb, pc;
-  int c;
+  Guchar *line;
   Gulong inBuf, outBuf, bitMask;
   int inBits, outBits;
-  int i, j, k, kk;
+  int n, i, j, k, kk;
 
   // get PNG optimum predictor number
   if (predictor >= 10) {
@@ -618,61 +839,41 @@ GBool StreamPredictor::getNextLine() {
     curPred = predictor;
   }
 
-  // read the raw line, apply PNG (byte) predictor
-  int *rawCharLine = new int[rowBytes - pixBytes];
-  str->getRawChars(rowBytes - pixBytes, rawCharLine);
-  memset(upLeftBuf, 0, pixBytes + 1);
-  for (i = pixBytes; i < rowBytes; ++i) {
-    for (j = pixBytes; j > 0; --j) {
-      upLeftBuf[j] = upLeftBuf[j-1];
-    }
-    upLeftBuf[0] = predLine[i];
-    if ((c = rawCharLine[i - pixBytes]) == EOF) {
-      if (i > pixBytes) {
-	// this ought to return false, but some (broken) PDF files
-	// contain truncated image data, and Adobe apparently reads the
-	// last partial line
-	break;
-      }
-      delete[] rawCharLine;
-      return gFalse;
-    }
-    switch (curPred) {
-    case 11:			// PNG sub
-      predLine[i] = predLine[i - pixBytes] + (Guchar)c;
-      break;
-    case 12:			// PNG up
-      predLine[i] = predLine[i] + (Guchar)c;
-      break;
-    case 13:			// PNG average
-      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
-	            (Guchar)c;
-      break;
-    case 14:			// PNG Paeth
-      left = predLine[i - pixBytes];
-      up = predLine[i];
-      upLeft = upLeftBuf[pixBytes];
-      p = left + up - upLeft;
-      if ((pa = p - left) < 0)
-	pa = -pa;
-      if ((pb = p - up) < 0)
-	pb = -pb;
-      if ((pc = p - upLeft) < 0)
-	pc = -pc;
-      if (pa <= pb && pa <= pc)
-	predLine[i] = left + (Guchar)c;
-      else if (pb <= pc)
-	predLine[i] = up + (Guchar)c;
-      else
-	predLine[i] = upLeft + (Guchar)c;
-      break;
-    case 10:			// PNG none
-    default:			// no predictor or TIFF predictor
-      predLine[i] = (Guchar)c;
-      break;
-    }
+  // read the raw line over the older line, which then becomes the
+  // current one
+  line = prevLine;
+  if ((n = str->getRawChars(rowBytes - pixBytes, line + pixBytes)) == 0) {
+    return gFalse;
+  }
+  prevLine = predLine;
+  predLine = line;
+
+  // apply PNG (byte) predictor
+  switch (curPred) {
+  case 11:			// PNG sub
+    predPNGSub(predLine + pixBytes, pixBytes, n);
+    break;
+  case 12:			// PNG up
+    predPNGUp(predLine + pixBytes, prevLine + pixBytes, n);
+    break;
+  case 13:			// PNG average
+    predPNGAverage(predLine + pixBytes, prevLine + pixBytes, pixBytes, n);
+    break;
+  case 14:			// PNG Paeth
+    predPNGPaeth(predLine + pixBytes, prevLine + pixBytes, pixBytes, n);
+    break;
+  case 10:			// PNG none
+  default:			// no predictor or TIFF predictor
+    break;
+  }
+
+  // this ought to return false, but some (broken) PDF files contain
+  // truncated image data, and Adobe apparently reads the last partial
+  // line; the rest of it is left as it was in the previous line
+  if (n < rowBytes - pixBytes) {
+    memcpy(predLine + pixBytes + n, prevLine + pixBytes + n,
+	   rowBytes - pixBytes - n);
   }
-  delete[] rawCharLine;
 
   // apply TIFF (component) predictor
   if (predictor == 2) {
@@ -727,6 +928,70 @@ GBool StreamPredictor::getNextLine() {
 // FileStream
 //------------------------------------------------------------------------
 
+#if !HAVE_PREAD && MULTITHREADED
+// Without pread() the seek and the read have to be done atomically.
+class FileStreamReadLock {
+public:
+  FileStreamReadLock() { gInitMutex(&mutex); }
+  ~FileStreamReadLock() { gDestroyMutex(&mutex); }
+  GooMutex mutex;
+};
+
+static FileStreamReadLock fileStreamReadLock;
+#endif
+
+// Read up to <n> bytes at offset <pos> of <f>.  The FILE position is
+// not used, so this can be called for FileStreams sharing <f> from
+// several threads.
+static int fileStreamRead(FILE *f, Guint pos, char *buf, int n) {
+#if HAVE_PREAD
+  int fd, total;
+  ssize_t r;
+
+  fd = fileno(f);
+  total = 0;
+  while (total < n) {
+    r = pread(fd, buf + total, n - total, (off_t)pos + total);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      break;
+    }
+    total += (int)r;
+  }
+  return total;
+#else
+#if MULTITHREADED
+  MutexLocker locker(&fileStreamReadLock.mutex);
+#endif
+#if HAVE_FSEEKO
+  fseeko(f, pos, SEEK_SET);
+#elif HAVE_FSEEK64
+  fseek64(f, pos, SEEK_SET);
+#else
+  fseek(f, pos, SEEK_SET);
+#endif
+  return (int)fread(buf, 1, n, f);
+#endif
+}
+
+static Guint fileStreamSize(FILE *f) {
+#if !HAVE_PREAD && MULTITHREADED
+  MutexLocker locker(&fileStreamReadLock.mutex);
+#endif
+#if HAVE_FSEEKO
+  fseeko(f, 0, SEEK_END);
+  return (Guint)ftello(f);
+#elif HAVE_FSEEK64
+  fseek64(f, 0, SEEK_END);
+  return (Guint)ftell64(f);
+#else
+  fseek(f, 0, SEEK_END);
+  return (Guint)ftell(f);
+#endif
+}
+
 FileStream::FileStream(FILE *fA, Guint startA, GBool limitedA,
 		       Guint lengthA, Object *dictA):
     BaseStream(dictA, lengthA) {
@@ -736,8 +1001,6 @@ FileStream::FileStream(FILE *fA, Guint startA, GBool limitedA,
   length = lengthA;
   bufPtr = bufEnd = buf;
   bufPos = start;
-  savePos = 0;
-  saved = gFalse;
 }
 
 FileStream::~FileStream() {
@@ -750,32 +1013,11 @@ Stream *FileStream::makeSubStream(Guint startA, GBool limitedA,
 }
 
 void FileStream::reset() {
-#if HAVE_FSEEKO
-  savePos = (Guint)ftello(f);
-  fseeko(f, start, SEEK_SET);
-#elif HAVE_FSEEK64
-  savePos = (Guint)ftell64(f);
-  fseek64(f, start, SEEK_SET);
-#else
-  savePos = (Guint)ftell(f);
-  fseek(f, start, SEEK_SET);
-#endif
-  saved = gTrue;
   bufPtr = bufEnd = buf;
   bufPos = start;
 }
 
 void FileStream::close() {
-  if (saved) {
-#if HAVE_FSEEKO
-    fseeko(f, savePos, SEEK_SET);
-#elif HAVE_FSEEK64
-    fseek64(f, savePos, SEEK_SET);
-#else
-    fseek(f, savePos, SEEK_SET);
-#endif
-    saved = gFalse;
-  }
 }
 
 GBool FileStream::fillBuf() {
@@ -791,7 +1033,7 @@ GBool FileStream::fillBuf() {
   } else {
     n = fileStreamBufSize;
   }
-  n = fread(buf, 1, n, f);
+  n = fileStreamRead(f, bufPos, buf, n);
   bufEnd = buf + n;
   if (bufPtr >= bufEnd) {
     return gFalse;
@@ -799,41 +1041,57 @@ GBool FileStream::fillBuf() {
   return gTrue;
 }
 
+int FileStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd) {
+      // read large requests straight into <buffer>, in one call
+      if (nChars - n >= fileStreamBufSize) {
+	bufPos += bufEnd - buf;
+	bufPtr = bufEnd = buf;
+	m = nChars - n;
+	if (limited) {
+	  if (bufPos >= start + length) {
+	    break;
+	  }
+	  if ((Guint)m > start + length - bufPos) {
+	    m = start + length - bufPos;
+	  }
+	}
+	if ((m = fileStreamRead(f, bufPos, (char *)buffer + n, m)) <= 0) {
+	  break;
+	}
+	bufPos += m;
+	n += m;
+	continue;
+      }
+      if (!fillBuf()) {
+	break;
+      }
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 void FileStream::setPos(Guint pos, int dir) {
   Guint size;
 
   if (dir >= 0) {
-#if HAVE_FSEEKO
-    fseeko(f, pos, SEEK_SET);
-#elif HAVE_FSEEK64
-    fseek64(f, pos, SEEK_SET);
-#else
-    fseek(f, pos, SEEK_SET);
-#endif
     bufPos = pos;
   } else {
-#if HAVE_FSEEKO
-    fseeko(f, 0, SEEK_END);
-    size = (Guint)ftello(f);
-#elif HAVE_FSEEK64
-    fseek64(f, 0, SEEK_END);
-    size = (Guint)ftell64(f);
-#else
-    fseek(f, 0, SEEK_END);
-    size = (Guint)ftell(f);
-#endif
+    size = fileStreamSize(f);
     if (pos > size)
       pos = (Guint)size;
-#if HAVE_FSEEKO
-    fseeko(f, -(int)pos, SEEK_END);
-    bufPos = (Guint)ftello(f);
-#elif HAVE_FSEEK64
-    fseek64(f, -(int)pos, SEEK_END);
-    bufPos = (Guint)ftell64(f);
-#else
-    fseek(f, -(int)pos, SEEK_END);
-    bufPos = (Guint)ftell(f);
-#endif
+    bufPos = size - pos;
   }
   bufPtr = bufEnd = buf;
 }
@@ -858,8 +1116,6 @@ CachedFileStream::CachedFileStream(CachedFile *ccA, Guint startA,
   length = lengthA;
   bufPtr = bufEnd = buf;
   bufPos = start;
-  savePos = 0;
-  saved = gFalse;
 }
 
 CachedFileStream::~CachedFileStream()
@@ -877,20 +1133,12 @@ Stream *CachedFileStream::makeSubStream(Guint startA, GBool limitedA,
 
 void CachedFileStream::reset()
 {
-  savePos = (Guint)cc->tell();
-  cc->seek(start, SEEK_SET);
-
-  saved = gTrue;
   bufPtr = bufEnd = buf;
   bufPos = start;
 }
 
 void CachedFileStream::close()
 {
-  if (saved) {
-    cc->seek(savePos, SEEK_SET);
-    saved = gFalse;
-  }
 }
 
 GBool CachedFileStream::fillBuf()
@@ -907,7 +1155,7 @@ GBool CachedFileStream::fillBuf()
   } else {
     n = cachedStreamBufSize - (bufPos % cachedStreamBufSize);
   }
-  cc->read(buf, 1, n);
+  n = (int)cc->read(buf, 1, n, bufPos);
   bufEnd = buf + n;
   if (bufPtr >= bufEnd) {
     return gFalse;
@@ -915,22 +1163,41 @@ GBool CachedFileStream::fillBuf()
   return gTrue;
 }
 
+int CachedFileStream::getChars(int nChars, Guchar *buffer)
+{
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd) {
+      if (!fillBuf()) {
+	break;
+      }
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 void CachedFileStream::setPos(Guint pos, int dir)
 {
   Guint size;
 
   if (dir >= 0) {
-    cc->seek(pos, SEEK_SET);
     bufPos = pos;
   } else {
-    cc->seek(0, SEEK_END);
-    size = (Guint)cc->tell();
+    size = cc->getLength();
 
     if (pos > size)
       pos = (Guint)size;
 
-    cc->seek(-(int)pos, SEEK_END);
-    bufPos = (Guint)cc->tell();
+    bufPos = size - pos;
   }
 
   bufPtr = bufEnd = buf;
@@ -1006,7 +1273,7 @@ void MemStream::setPos(Guint pos, int dir) {
   if (dir >= 0) {
     i = pos;
   } else {
-    i = start + length - pos;
+    i = pos > length ? start : start + length - pos;
   }
   if (i < start) {
     i = start;
@@ -1022,6 +1289,61 @@ void MemStream::moveStart(int delta) {
   bufPtr = buf + start;
 }
 
+//------------------------------------------------------------------------
+// MappedFileStream
+//------------------------------------------------------------------------
+
+MappedFileStream *MappedFileStream::create(FILE *f, Object *dictA) {
+#if HAVE_MMAP && HAVE_SYS_MMAN_H
+  struct stat st;
+  void *p;
+
+  if (fstat(fileno(f), &st) < 0 || !S_ISREG(st.st_mode) ||
+      st.st_size <= 0 || st.st_size > INT_MAX) {
+    return NULL;
+  }
+  p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fileno(f), 0);
+  if (p == MAP_FAILED) {
+    return NULL;
+  }
+  return new MappedFileStream((char *)p, 0, (Guint)st.st_size,
+			      (Guint)st.st_size, dictA);
+#else
+  return NULL;
+#endif
+}
+
+MappedFileStream::MappedFileStream(char *mapA, Guint startA, Guint lengthA,
+				   Guint mapLenA, Object *dictA):
+    MemStream(mapA, startA, lengthA, dictA) {
+  map = mapA;
+  mapLen = mapLenA;
+}
+
+MappedFileStream::~MappedFileStream() {
+#if HAVE_MMAP && HAVE_SYS_MMAN_H
+  if (mapLen) {
+    munmap(map, mapLen);
+  }
+#endif
+}
+
+Stream *MappedFileStream::makeSubStream(Guint startA, GBool limited,
+					Guint lengthA, Object *dictA) {
+  Guint end, newLength;
+
+  end = getStart() + getLength();
+  if (startA > end) {
+    startA = end;
+  }
+  if (!limited || lengthA > end - startA) {
+    newLength = end - startA;
+  } else {
+    newLength = lengthA;
+  }
+  return new MappedFileStream(map, startA, newLength, 0, dictA);
+}
+
 //------------------------------------------------------------------------
 // EmbedStream
 //------------------------------------------------------------------------
@@ -1059,13 +1381,19 @@ int EmbedStream::lookChar() {
 }
 
 int EmbedStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
   if (nChars <= 0) {
     return 0;
   }
   if (limited && length < (Guint)nChars) {
     nChars = (int)length;
   }
-  return str->doGetChars(nChars, buffer);
+  n = str->doGetChars(nChars, buffer);
+  if (limited) {
+    length -= n;
+  }
+  return n;
 }
 
 void EmbedStream::setPos(Guint pos, int dir) {
@@ -1156,6 +1484,56 @@ int ASCIIHexStream::lookChar() {
   return buf;
 }
 
+static inline int asciiHexValue(int c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+// Pairs of hex digits are decoded straight from the underlying
+// stream's buffer, if it has one (see Stream::peekChars), so that
+// nothing past the '>' is consumed.  Anything else -- digits split by
+// whitespace or by the end of the buffer, the end of the data, and
+// errors -- goes through lookChar().
+int ASCIIHexStream::getChars(int nChars, Guchar *buffer) {
+  const Guchar *p;
+  int n, len, x1, x2, c, i;
+
+  n = 0;
+  while (n < nChars) {
+    if (buf == EOF && !eof && (p = str->peekChars(&len))) {
+      i = 0;
+      while (i + 1 < len && n < nChars) {
+	if (isspace(p[i])) {
+	  ++i;
+	  continue;
+	}
+	if ((x1 = asciiHexValue(p[i])) < 0 ||
+	    (x2 = asciiHexValue(p[i + 1])) < 0) {
+	  break;
+	}
+	buffer[n++] = (Guchar)((x1 << 4) | x2);
+	i += 2;
+      }
+      str->skipPeekedChars(i);
+      if (n == nChars) {
+	break;
+      }
+    }
+    if ((c = ASCIIHexStream::lookChar()) == EOF) {
+      break;
+    }
+    buffer[n++] = (Guchar)c;
+    buf = EOF;
+  }
+  return n;
+}
+
 GooString *ASCIIHexStream::getPSFilter(int psLevel, const char *indent) {
   GooString *s;
 
@@ -1237,6 +1615,73 @@ int ASCII85Stream::lookChar() {
   return b[index];
 }
 
+// Complete groups are decoded straight from the underlying stream's
+// buffer, if it has one (see Stream::peekChars), so that nothing past
+// the '~>' is consumed.  Groups split by whitespace or by the end of
+// the buffer, the end of the data, and a last partial group of output
+// go through lookChar().
+int ASCII85Stream::getChars(int nChars, Guchar *buffer) {
+  const Guchar *p;
+  Gulong t;
+  int i, len, j, k;
+
+  i = 0;
+  while (i < nChars) {
+    if (index >= n && !eof && (p = str->peekChars(&len))) {
+      j = 0;
+      while (nChars - i >= 4) {
+	while (j < len && Lexer::isSpace(p[j])) {
+	  ++j;
+	}
+	if (j < len && p[j] == 'z') {
+	  buffer[i] = buffer[i+1] = buffer[i+2] = buffer[i+3] = 0;
+	  i += 4;
+	  ++j;
+	  continue;
+	}
+	if (len - j < 5) {
+	  break;
+	}
+	for (k = 0; k < 5 && p[j+k] >= 0x21 && p[j+k] <= 0x21 + 84; ++k) ;
+	if (k < 5) {
+	  break;
+	}
+	t = 0;
+	for (k = 0; k < 5; ++k) {
+	  t = t * 85 + (p[j+k] - 0x21);
+	}
+	buffer[i] = (Guchar)(t >> 24);
+	buffer[i+1] = (Guchar)(t >> 16);
+	buffer[i+2] = (Guchar)(t >> 8);
+	buffer[i+3] = (Guchar)t;
+	i += 4;
+	j += 5;
+      }
+      str->skipPeekedChars(j);
+      if (i == nChars) {
+	break;
+      }
+    }
+    if (index >= n) {
+      if ((k = ASCII85Stream::lookChar()) == EOF) {
+	break;
+      }
+      // a single character before the end of the data decodes to no
+      // bytes, but getChar() still returns one
+      if (index >= n) {
+	buffer[i++] = (Guchar)k;
+	++index;
+	continue;
+      }
+    }
+    for (k = index; k < n && i < nChars; ++k) {
+      buffer[i++] = (Guchar)b[k];
+    }
+    index = k;
+  }
+  return i;
+}
+
 GooString *ASCII85Stream::getPSFilter(int psLevel, const char *indent) {
   GooString *s;
 
@@ -1313,21 +1758,20 @@ int LZWStream::lookChar() {
   return seqBuf[seqIndex];
 }
 
-void LZWStream::getRawChars(int nChars, int *buffer) {
-  for (int i = 0; i < nChars; ++i)
-    buffer[i] = doGetRawChar();
-}
-
 int LZWStream::getRawChar() {
   return doGetRawChar();
 }
 
 int LZWStream::getChars(int nChars, Guchar *buffer) {
-  int n, m;
-
   if (pred) {
     return pred->getChars(nChars, buffer);
   }
+  return getRawChars(nChars, buffer);
+}
+
+int LZWStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
   if (eof) {
     return 0;
   }
@@ -1540,8 +1984,10 @@ GBool RunLengthStream::fillBuf() {
   }
   if (c < 0x80) {
     n = c + 1;
-    for (i = 0; i < n; ++i)
-      buf[i] = (char)str->getChar();
+    // a truncated run is padded with (char)EOF, as when it was read a
+    // character at a time
+    for (i = str->doGetChars(n, (Guchar *)buf); i < n; ++i)
+      buf[i] = (char)EOF;
   } else {
     n = 0x101 - c;
     c = str->getChar();
@@ -1687,9 +2133,7 @@ inline void CCITTFaxStream::addPixelsNeg(int a1, int blackPixels) {
 }
 
 int CCITTFaxStream::lookChar() {
-  int code1, code2, code3;
-  int b1i, blackPixels, i, bits;
-  GBool gotEOL;
+  int bits;
 
   if (buf != EOF) {
     return buf;
@@ -1697,342 +2141,423 @@ int CCITTFaxStream::lookChar() {
 
   // read the next row
   if (outputBits == 0) {
-
-    // if at eof just return EOF
-    if (eof) {
+    if (!readRow()) {
       return EOF;
     }
 
-    err = gFalse;
-
-    // 2-D encoding
-    if (nextLine2D) {
-      for (i = 0; codingLine[i] < columns; ++i) {
-	refLine[i] = codingLine[i];
-      }
-      refLine[i++] = columns;
-      refLine[i] = columns;
-      codingLine[0] = 0;
-      a0i = 0;
-      b1i = 0;
-      blackPixels = 0;
-      // invariant:
-      // refLine[b1i-1] <= codingLine[a0i] < refLine[b1i] < refLine[b1i+1]
-      //                                                             <= columns
-      // exception at left edge:
-      //   codingLine[a0i = 0] = refLine[b1i = 0] = 0 is possible
-      // exception at right edge:
-      //   refLine[b1i] = refLine[b1i+1] = columns is possible
-      while (codingLine[a0i] < columns) {
-	code1 = getTwoDimCode();
-	switch (code1) {
-	case twoDimPass:
-	  if (likely(b1i + 1 < columns + 2)) {
-	    addPixels(refLine[b1i + 1], blackPixels);
-	    if (refLine[b1i + 1] < columns) {
-	      b1i += 2;
-	    }
+    // set up for output
+    if (codingLine[0] > 0) {
+      outputBits = codingLine[a0i = 0];
+    } else {
+      outputBits = codingLine[a0i = 1];
+    }
+  }
+
+  // get a byte
+  if (outputBits >= 8) {
+    buf = (a0i & 1) ? 0x00 : 0xff;
+    outputBits -= 8;
+    if (outputBits == 0 && codingLine[a0i] < columns) {
+      ++a0i;
+      outputBits = codingLine[a0i] - codingLine[a0i - 1];
+    }
+  } else {
+    bits = 8;
+    buf = 0;
+    do {
+      if (outputBits > bits) {
+	buf <<= bits;
+	if (!(a0i & 1)) {
+	  buf |= 0xff >> (8 - bits);
+	}
+	outputBits -= bits;
+	bits = 0;
+      } else {
+	buf <<= outputBits;
+	if (!(a0i & 1)) {
+	  buf |= 0xff >> (8 - outputBits);
+	}
+	bits -= outputBits;
+	outputBits = 0;
+	if (codingLine[a0i] < columns) {
+	  ++a0i;
+	  outputBits = codingLine[a0i] - codingLine[a0i - 1];
+	} else if (bits > 0) {
+	  buf <<= bits;
+	  bits = 0;
+	}
+      }
+    } while (bits);
+  }
+  if (black) {
+    buf ^= 0xff;
+  }
+  return buf;
+}
+
+// Whole rows are packed straight into <buffer> when they fit; partial
+// rows go through lookChar().
+int CCITTFaxStream::getChars(int nChars, Guchar *buffer) {
+  int rowBytes, n, c;
+
+  rowBytes = (columns + 7) >> 3;
+  n = 0;
+  while (n < nChars) {
+    if (buf == EOF && outputBits == 0 && nChars - n >= rowBytes) {
+      if (!readRow()) {
+	break;
+      }
+      packRow(buffer + n);
+      n += rowBytes;
+    } else {
+      if ((c = CCITTFaxStream::lookChar()) == EOF) {
+	break;
+      }
+      buffer[n++] = (Guchar)c;
+      buf = EOF;
+    }
+  }
+  return n;
+}
+
+// Pack the row in codingLine into <p>, in the same format that
+// lookChar() returns it: white pixels are 1 bits (0 bits with
+// BlackIs1), and the last byte is padded with 0 bits (1 bits).
+void CCITTFaxStream::packRow(Guchar *p) {
+  int rowBytes, x0, x1, i0, i1, i;
+
+  rowBytes = (columns + 7) >> 3;
+  memset(p, 0, rowBytes);
+  for (i = 0, x0 = 0; i <= a0i; i += 2) {
+    x1 = codingLine[i];
+    if (x0 < x1) {
+      i0 = x0 >> 3;
+      i1 = x1 >> 3;
+      if (i0 == i1) {
+	p[i0] |= (0xff >> (x0 & 7)) & (0xff00 >> (x1 & 7));
+      } else {
+	p[i0] |= 0xff >> (x0 & 7);
+	memset(p + i0 + 1, 0xff, i1 - i0 - 1);
+	if (x1 & 7) {
+	  p[i1] |= (0xff00 >> (x1 & 7)) & 0xff;
+	}
+      }
+    }
+    if (i == a0i) {
+      break;
+    }
+    x0 = codingLine[i + 1];
+  }
+  if (black) {
+    for (i = 0; i < rowBytes; ++i) {
+      p[i] ^= 0xff;
+    }
+  }
+}
+
+// Decode the next row into codingLine: pixels [0, codingLine[0]) are
+// white, [codingLine[0], codingLine[1]) black, and so on, up to
+// codingLine[a0i] = columns.  Returns false at the end of the stream.
+GBool CCITTFaxStream::readRow() {
+  int code1, code2, code3;
+  int b1i, blackPixels, i;
+  GBool gotEOL;
+
+  if (eof) {
+    return gFalse;
+  }
+
+  err = gFalse;
+
+  // 2-D encoding
+  if (nextLine2D) {
+    for (i = 0; codingLine[i] < columns; ++i) {
+      refLine[i] = codingLine[i];
+    }
+    refLine[i++] = columns;
+    refLine[i] = columns;
+    codingLine[0] = 0;
+    a0i = 0;
+    b1i = 0;
+    blackPixels = 0;
+    // invariant:
+    // refLine[b1i-1] <= codingLine[a0i] < refLine[b1i] < refLine[b1i+1]
+    //                                                             <= columns
+    // exception at left edge:
+    //   codingLine[a0i = 0] = refLine[b1i = 0] = 0 is possible
+    // exception at right edge:
+    //   refLine[b1i] = refLine[b1i+1] = columns is possible
+    while (codingLine[a0i] < columns) {
+      code1 = getTwoDimCode();
+      switch (code1) {
+      case twoDimPass:
+	if (likely(b1i + 1 < columns + 2)) {
+	  addPixels(refLine[b1i + 1], blackPixels);
+	  if (refLine[b1i + 1] < columns) {
+	    b1i += 2;
 	  }
-	  break;
-	case twoDimHoriz:
-	  code1 = code2 = 0;
-	  if (blackPixels) {
-	    do {
-	      code1 += code3 = getBlackCode();
-	    } while (code3 >= 64);
-	    do {
-	      code2 += code3 = getWhiteCode();
-	    } while (code3 >= 64);
-	  } else {
-	    do {
-	      code1 += code3 = getWhiteCode();
-	    } while (code3 >= 64);
-	    do {
-	      code2 += code3 = getBlackCode();
-	    } while (code3 >= 64);
+	}
+	break;
+      case twoDimHoriz:
+	code1 = code2 = 0;
+	if (blackPixels) {
+	  do {
+	    code1 += code3 = getBlackCode();
+	  } while (code3 >= 64);
+	  do {
+	    code2 += code3 = getWhiteCode();
+	  } while (code3 >= 64);
+	} else {
+	  do {
+	    code1 += code3 = getWhiteCode();
+	  } while (code3 >= 64);
+	  do {
+	    code2 += code3 = getBlackCode();
+	  } while (code3 >= 64);
+	}
+	addPixels(codingLine[a0i] + code1, blackPixels);
+	if (codingLine[a0i] < columns) {
+	  addPixels(codingLine[a0i] + code2, blackPixels ^ 1);
+	}
+	while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	  b1i += 2;
+	}
+	break;
+      case twoDimVertR3:
+	addPixels(refLine[b1i] + 3, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  ++b1i;
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
-	  addPixels(codingLine[a0i] + code1, blackPixels);
-	  if (codingLine[a0i] < columns) {
-	    addPixels(codingLine[a0i] + code2, blackPixels ^ 1);
+	}
+	break;
+      case twoDimVertR2:
+	addPixels(refLine[b1i] + 2, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  ++b1i;
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
+	}
+	break;
+      case twoDimVertR1:
+	addPixels(refLine[b1i] + 1, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  ++b1i;
 	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
 	    b1i += 2;
 	  }
-	  break;
-	case twoDimVertR3:
-	  addPixels(refLine[b1i] + 3, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
-	    ++b1i;
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
+	}
+	break;
+      case twoDimVert0:
+	addPixels(refLine[b1i], blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  ++b1i;
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
-	  break;
-	case twoDimVertR2:
-	  addPixels(refLine[b1i] + 2, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
+	}
+	break;
+      case twoDimVertL3:
+	addPixelsNeg(refLine[b1i] - 3, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  if (b1i > 0) {
+	    --b1i;
+	  } else {
 	    ++b1i;
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
 	  }
-	  break;
-	case twoDimVertR1:
-	  addPixels(refLine[b1i] + 1, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
-	    ++b1i;
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
-	  break;
-	case twoDimVert0:
-	  addPixels(refLine[b1i], blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
+	}
+	break;
+      case twoDimVertL2:
+	addPixelsNeg(refLine[b1i] - 2, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  if (b1i > 0) {
+	    --b1i;
+	  } else {
 	    ++b1i;
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
 	  }
-	  break;
-	case twoDimVertL3:
-	  addPixelsNeg(refLine[b1i] - 3, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
-	    if (b1i > 0) {
-	      --b1i;
-	    } else {
-	      ++b1i;
-	    }
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
-	  break;
-	case twoDimVertL2:
-	  addPixelsNeg(refLine[b1i] - 2, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
-	    if (b1i > 0) {
-	      --b1i;
-	    } else {
-	      ++b1i;
-	    }
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
+	}
+	break;
+      case twoDimVertL1:
+	addPixelsNeg(refLine[b1i] - 1, blackPixels);
+	blackPixels ^= 1;
+	if (codingLine[a0i] < columns) {
+	  if (b1i > 0) {
+	    --b1i;
+	  } else {
+	    ++b1i;
 	  }
-	  break;
-	case twoDimVertL1:
-	  addPixelsNeg(refLine[b1i] - 1, blackPixels);
-	  blackPixels ^= 1;
-	  if (codingLine[a0i] < columns) {
-	    if (b1i > 0) {
-	      --b1i;
-	    } else {
-	      ++b1i;
-	    }
-	    while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
-	      b1i += 2;
-	    }
+	  while (refLine[b1i] <= codingLine[a0i] && refLine[b1i] < columns) {
+	    b1i += 2;
 	  }
-	  break;
-	case EOF:
-	  addPixels(columns, 0);
-	  eof = gTrue;
-	  break;
-	default:
-	  error(errSyntaxError, getPos(),
-		"Bad 2D code {0:04x} in CCITTFax stream", code1);
-	  addPixels(columns, 0);
-	  err = gTrue;
-	  break;
 	}
+	break;
+      case EOF:
+	addPixels(columns, 0);
+	eof = gTrue;
+	break;
+      default:
+	error(errSyntaxError, getPos(),
+	      "Bad 2D code {0:04x} in CCITTFax stream", code1);
+	addPixels(columns, 0);
+	err = gTrue;
+	break;
       }
+    }
 
-    // 1-D encoding
-    } else {
-      codingLine[0] = 0;
-      a0i = 0;
-      blackPixels = 0;
-      while (codingLine[a0i] < columns) {
-	code1 = 0;
-	if (blackPixels) {
-	  do {
-	    code1 += code3 = getBlackCode();
-	  } while (code3 >= 64);
-	} else {
-	  do {
-	    code1 += code3 = getWhiteCode();
-	  } while (code3 >= 64);
-	}
-	addPixels(codingLine[a0i] + code1, blackPixels);
-	blackPixels ^= 1;
+  // 1-D encoding
+  } else {
+    codingLine[0] = 0;
+    a0i = 0;
+    blackPixels = 0;
+    while (codingLine[a0i] < columns) {
+      code1 = 0;
+      if (blackPixels) {
+	do {
+	  code1 += code3 = getBlackCode();
+	} while (code3 >= 64);
+      } else {
+	do {
+	  code1 += code3 = getWhiteCode();
+	} while (code3 >= 64);
       }
+      addPixels(codingLine[a0i] + code1, blackPixels);
+      blackPixels ^= 1;
     }
+  }
 
-    // check for end-of-line marker, skipping over any extra zero bits
-    // (if EncodedByteAlign is true and EndOfLine is false, there can
-    // be "false" EOL markers -- i.e., if the last n unused bits in
-    // row i are set to zero, and the first 11-n bits in row i+1
-    // happen to be zero -- so we don't look for EOL markers in this
-    // case)
-    gotEOL = gFalse;
-    if (!endOfBlock && row == rows - 1) {
-      eof = gTrue;
-    } else if (endOfLine || !byteAlign) {
-      code1 = lookBits(12);
-      if (endOfLine) {
-	while (code1 != EOF && code1 != 0x001) {
-	  eatBits(1);
-	  code1 = lookBits(12);
-	}
-      } else {
-	while (code1 == 0) {
-	  eatBits(1);
-	  code1 = lookBits(12);
-	}
+  // check for end-of-line marker, skipping over any extra zero bits
+  // (if EncodedByteAlign is true and EndOfLine is false, there can
+  // be "false" EOL markers -- i.e., if the last n unused bits in
+  // row i are set to zero, and the first 11-n bits in row i+1
+  // happen to be zero -- so we don't look for EOL markers in this
+  // case)
+  gotEOL = gFalse;
+  if (!endOfBlock && row == rows - 1) {
+    eof = gTrue;
+  } else if (endOfLine || !byteAlign) {
+    code1 = lookBits(12);
+    if (endOfLine) {
+      while (code1 != EOF && code1 != 0x001) {
+	eatBits(1);
+	code1 = lookBits(12);
       }
-      if (code1 == 0x001) {
-	eatBits(12);
-	gotEOL = gTrue;
+    } else {
+      while (code1 == 0) {
+	eatBits(1);
+	code1 = lookBits(12);
       }
     }
-
-    // byte-align the row
-    // (Adobe apparently doesn't do byte alignment after EOL markers
-    // -- I've seen CCITT image data streams in two different formats,
-    // both with the byteAlign flag set:
-    //   1. xx:x0:01:yy:yy
-    //   2. xx:00:1y:yy:yy
-    // where xx is the previous line, yy is the next line, and colons
-    // separate bytes.)
-    if (byteAlign && !gotEOL) {
-      inputBits &= ~7;
+    if (code1 == 0x001) {
+      eatBits(12);
+      gotEOL = gTrue;
     }
+  }
 
-    // check for end of stream
-    if (lookBits(1) == EOF) {
-      eof = gTrue;
-    }
+  // byte-align the row
+  // (Adobe apparently doesn't do byte alignment after EOL markers
+  // -- I've seen CCITT image data streams in two different formats,
+  // both with the byteAlign flag set:
+  //   1. xx:x0:01:yy:yy
+  //   2. xx:00:1y:yy:yy
+  // where xx is the previous line, yy is the next line, and colons
+  // separate bytes.)
+  if (byteAlign && !gotEOL) {
+    inputBits &= ~7;
+  }
 
-    // get 2D encoding tag
-    if (!eof && encoding > 0) {
-      nextLine2D = !lookBits(1);
-      eatBits(1);
-    }
+  // check for end of stream
+  if (lookBits(1) == EOF) {
+    eof = gTrue;
+  }
 
-    // check for end-of-block marker
-    if (endOfBlock && !endOfLine && byteAlign) {
-      // in this case, we didn't check for an EOL code above, so we
-      // need to check here
-      code1 = lookBits(24);
-      if (code1 == 0x001001) {
-	eatBits(12);
-	gotEOL = gTrue;
-      }
+  // get 2D encoding tag
+  if (!eof && encoding > 0) {
+    nextLine2D = !lookBits(1);
+    eatBits(1);
+  }
+
+  // check for end-of-block marker
+  if (endOfBlock && !endOfLine && byteAlign) {
+    // in this case, we didn't check for an EOL code above, so we
+    // need to check here
+    code1 = lookBits(24);
+    if (code1 == 0x001001) {
+      eatBits(12);
+      gotEOL = gTrue;
     }
-    if (endOfBlock && gotEOL) {
-      code1 = lookBits(12);
-      if (code1 == 0x001) {
-	eatBits(12);
-	if (encoding > 0) {
-	  lookBits(1);
-	  eatBits(1);
-	}
-	if (encoding >= 0) {
-	  for (i = 0; i < 4; ++i) {
-	    code1 = lookBits(12);
-	    if (code1 != 0x001) {
-	      error(errSyntaxError, getPos(),
-		    "Bad RTC code in CCITTFax stream");
-	    }
-	    eatBits(12);
-	    if (encoding > 0) {
-	      lookBits(1);
-	      eatBits(1);
-	    }
+  }
+  if (endOfBlock && gotEOL) {
+    code1 = lookBits(12);
+    if (code1 == 0x001) {
+      eatBits(12);
+      if (encoding > 0) {
+	lookBits(1);
+	eatBits(1);
+      }
+      if (encoding >= 0) {
+	for (i = 0; i < 4; ++i) {
+	  code1 = lookBits(12);
+	  if (code1 != 0x001) {
+	    error(errSyntaxError, getPos(),
+		  "Bad RTC code in CCITTFax stream");
+	  }
+	  eatBits(12);
+	  if (encoding > 0) {
+	    lookBits(1);
+	    eatBits(1);
 	  }
 	}
-	eof = gTrue;
       }
+      eof = gTrue;
+    }
 
-    // look for an end-of-line marker after an error -- we only do
-    // this if we know the stream contains end-of-line markers because
-    // the "just plow on" technique tends to work better otherwise
-    } else if (err && endOfLine) {
-      while (1) {
-	code1 = lookBits(13);
-	if (code1 == EOF) {
-	  eof = gTrue;
-	  return EOF;
-	}
-	if ((code1 >> 1) == 0x001) {
-	  break;
-	}
-	eatBits(1);
+  // look for an end-of-line marker after an error -- we only do
+  // this if we know the stream contains end-of-line markers because
+  // the "just plow on" technique tends to work better otherwise
+  } else if (err && endOfLine) {
+    while (1) {
+      code1 = lookBits(13);
+      if (code1 == EOF) {
+	eof = gTrue;
+	return gFalse;
       }
-      eatBits(12); 
-      if (encoding > 0) {
-	eatBits(1);
-	nextLine2D = !(code1 & 1);
+      if ((code1 >> 1) == 0x001) {
+	break;
       }
+      eatBits(1);
     }
-
-    // set up for output
-    if (codingLine[0] > 0) {
-      outputBits = codingLine[a0i = 0];
-    } else {
-      outputBits = codingLine[a0i = 1];
+    eatBits(12); 
+    if (encoding > 0) {
+      eatBits(1);
+      nextLine2D = !(code1 & 1);
     }
-
-    ++row;
   }
 
-  // get a byte
-  if (outputBits >= 8) {
-    buf = (a0i & 1) ? 0x00 : 0xff;
-    outputBits -= 8;
-    if (outputBits == 0 && codingLine[a0i] < columns) {
-      ++a0i;
-      outputBits = codingLine[a0i] - codingLine[a0i - 1];
-    }
-  } else {
-    bits = 8;
-    buf = 0;
-    do {
-      if (outputBits > bits) {
-	buf <<= bits;
-	if (!(a0i & 1)) {
-	  buf |= 0xff >> (8 - bits);
-	}
-	outputBits -= bits;
-	bits = 0;
-      } else {
-	buf <<= outputBits;
-	if (!(a0i & 1)) {
-	  buf |= 0xff >> (8 - outputBits);
-	}
-	bits -= outputBits;
-	outputBits = 0;
-	if (codingLine[a0i] < columns) {
-	  ++a0i;
-	  outputBits = codingLine[a0i] - codingLine[a0i - 1];
-	} else if (bits > 0) {
-	  buf <<= bits;
-	  bits = 0;
-	}
-      }
-    } while (bits);
-  }
-  if (black) {
-    buf ^= 0xff;
+  ++row;
+  return gTrue;
+}
+
+int CCITTFaxStream::getRunsLine(int **runs, int *firstVal) {
+  if (!readRow()) {
+    return 0;
   }
-  return buf;
+  *runs = codingLine;
+  *firstVal = black ? 0 : 1;
+  return a0i + 1;
 }
 
 short CCITTFaxStream::getTwoDimCode() {
@@ -2535,6 +3060,55 @@ int DCTStream::lookChar() {
   }
 }
 
+// Copy the rest of the current row of pixels at a time, instead of
+// going through getChar() for each component.
+int DCTStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  n = 0;
+  while (n < nChars && y < height) {
+    if (progressive || !interleaved) {
+      while (n < nChars && x < width) {
+	buffer[n++] = (Guchar)frameBuf[comp][y * bufWidth + x];
+	if (++comp == numComps) {
+	  comp = 0;
+	  ++x;
+	}
+      }
+      if (x == width) {
+	x = 0;
+	++y;
+      }
+    } else {
+      if (dy >= mcuHeight) {
+	if (!readMCURow()) {
+	  y = height;
+	  break;
+	}
+	comp = 0;
+	x = 0;
+	dy = 0;
+      }
+      while (n < nChars && x < width) {
+	buffer[n++] = rowBuf[comp][dy][x];
+	if (++comp == numComps) {
+	  comp = 0;
+	  ++x;
+	}
+      }
+      if (x == width) {
+	x = 0;
+	++y;
+	++dy;
+	if (y == height) {
+	  readTrailer();
+	}
+      }
+    }
+  }
+  return n;
+}
+
 void DCTStream::restart() {
   int i;
 
@@ -3735,7 +4309,6 @@ GBool DCTStream::isBinary(GBool last) {
 
 #endif
 
-#ifndef ENABLE_ZLIB
 //------------------------------------------------------------------------
 // FlateStream
 //------------------------------------------------------------------------
@@ -4327,7 +4900,7 @@ static FlateCode flateFixedLitCodeTabCodes[512] = {
 };
 
 FlateHuffmanTab FlateStream::fixedLitCodeTab = {
-  flateFixedLitCodeTabCodes, 9
+  flateFixedLitCodeTabCodes, 9, 9
 };
 
 static FlateCode flateFixedDistCodeTabCodes[32] = {
@@ -4366,7 +4939,7 @@ static FlateCode flateFixedDistCodeTabCodes[32] = {
 };
 
 FlateHuffmanTab FlateStream::fixedDistCodeTab = {
-  flateFixedDistCodeTabCodes, 5
+  flateFixedDistCodeTabCodes, 5, 5
 };
 
 FlateStream::FlateStream(Stream *strA, int predictor, int columns,
@@ -4449,14 +5022,33 @@ int FlateStream::getChar() {
 int FlateStream::getChars(int nChars, Guchar *buffer) {
   if (pred) {
     return pred->getChars(nChars, buffer);
-  } else {
-    for (int i = 0; i < nChars; ++i) {
-      const int c = doGetRawChar();
-      if (likely(c != EOF)) buffer[i] = c;
-      else return i;
+  }
+  return getRawChars(nChars, buffer);
+}
+
+int FlateStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (remain == 0) {
+      if (endOfBlock && eof) {
+	break;
+      }
+      readSome();
+      continue;
+    }
+    // copy up to the end of the circular buffer
+    m = remain < flateWindow - index ? remain : flateWindow - index;
+    if (m > nChars - n) {
+      m = nChars - n;
     }
-    return nChars;
+    memcpy(buffer + n, buf + index, m);
+    index = (index + m) & flateMask;
+    remain -= m;
+    n += m;
   }
+  return n;
 }
 
 int FlateStream::lookChar() {
@@ -4474,9 +5066,24 @@ int FlateStream::lookChar() {
   return c;
 }
 
-void FlateStream::getRawChars(int nChars, int *buffer) {
-  for (int i = 0; i < nChars; ++i)
-    buffer[i] = doGetRawChar();
+const Guchar *FlateStream::peekChars(int *len) {
+  if (pred) {
+    return NULL;
+  }
+  // decode ahead, so that the caller gets more than one code's worth
+  // of characters; the rest of the buffer keeps the history that
+  // matches are copied from
+  while (remain < flateDecodeSize && !(endOfBlock && eof)) {
+    readSome();
+  }
+  // the output buffer is circular: stop at its end
+  *len = remain < flateWindow - index ? remain : flateWindow - index;
+  return buf + index;
+}
+
+void FlateStream::skipPeekedChars(int n) {
+  index = (index + n) & flateMask;
+  remain -= n;
 }
 
 int FlateStream::getRawChar() {
@@ -4500,11 +5107,13 @@ GBool FlateStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
 
+// Decode codes (or part of an uncompressed block) until at least
+// flateDecodeSize characters are buffered or the block ends, appending
+// their output to the <remain> characters already in the buffer.
 void FlateStream::readSome() {
   int code1, code2;
   int len, dist;
-  int i, j, k;
-  int c;
+  int i, j, k, n;
 
   if (endOfBlock) {
     if (!startBlock())
@@ -4512,46 +5121,65 @@ void FlateStream::readSome() {
   }
 
   if (compressedBlock) {
-    if ((code1 = getHuffmanCodeWord(&litCodeTab)) == EOF)
-      goto err;
-    if (code1 < 256) {
-      buf[index] = code1;
-      remain = 1;
-    } else if (code1 == 256) {
-      endOfBlock = gTrue;
-      remain = 0;
-    } else {
-      code1 -= 257;
-      code2 = lengthDecode[code1].bits;
-      if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
-	goto err;
-      len = lengthDecode[code1].first + code2;
-      if ((code1 = getHuffmanCodeWord(&distCodeTab)) == EOF)
-	goto err;
-      code2 = distDecode[code1].bits;
-      if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
+    do {
+      if ((code1 = getHuffmanCodeWord(&litCodeTab)) == EOF)
 	goto err;
-      dist = distDecode[code1].first + code2;
-      i = index;
-      j = (index - dist) & flateMask;
-      for (k = 0; k < len; ++k) {
-	buf[i] = buf[j];
-	i = (i + 1) & flateMask;
-	j = (j + 1) & flateMask;
+      if (code1 < 256) {
+	buf[(index + remain) & flateMask] = code1;
+	++remain;
+      } else if (code1 == 256) {
+	endOfBlock = gTrue;
+	break;
+      } else {
+	code1 -= 257;
+	code2 = lengthDecode[code1].bits;
+	if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
+	  goto err;
+	len = lengthDecode[code1].first + code2;
+	if ((code1 = getHuffmanCodeWord(&distCodeTab)) == EOF)
+	  goto err;
+	code2 = distDecode[code1].bits;
+	if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
+	  goto err;
+	dist = distDecode[code1].first + code2;
+	i = (index + remain) & flateMask;
+	j = (i - dist) & flateMask;
+	if (dist >= len && dist <= flateWindow - len &&
+	    i + len <= flateWindow && j + len <= flateWindow) {
+	  // the match neither overlaps its copy nor wraps around
+	  memcpy(buf + i, buf + j, len);
+	} else {
+	  for (k = 0; k < len; ++k) {
+	    buf[i] = buf[j];
+	    i = (i + 1) & flateMask;
+	    j = (j + 1) & flateMask;
+	  }
+	}
+	remain += len;
       }
-      remain = len;
-    }
+    } while (remain < flateDecodeSize);
 
   } else {
-    len = (blockLen < flateWindow) ? blockLen : flateWindow;
-    for (i = 0, j = index; i < len; ++i, j = (j + 1) & flateMask) {
-      if ((c = str->getChar()) == EOF) {
+    len = (blockLen < flateWindow - remain) ? blockLen : flateWindow - remain;
+    j = (index + remain) & flateMask;
+    // the bit buffer may already hold the first characters
+    for (i = 0; i < len && codeSize >= 8; ++i) {
+      buf[j] = (Guchar)(codeBuf & 0xff);
+      codeBuf >>= 8;
+      codeSize -= 8;
+      j = (j + 1) & flateMask;
+    }
+    while (i < len) {
+      k = (len - i < flateWindow - j) ? len - i : flateWindow - j;
+      n = str->doGetChars(k, buf + j);
+      i += n;
+      j = (j + n) & flateMask;
+      if (n < k) {
 	endOfBlock = eof = gTrue;
 	break;
       }
-      buf[j] = c & 0xff;
     }
-    remain = i;
+    remain += i;
     blockLen -= len;
     if (blockLen == 0)
       endOfBlock = gTrue;
@@ -4562,12 +5190,10 @@ void FlateStream::readSome() {
 err:
   error(errSyntaxError, getPos(), "Unexpected end of file in flate stream");
   endOfBlock = eof = gTrue;
-  remain = 0;
 }
 
 GBool FlateStream::startBlock() {
   int blockHdr;
-  int c;
   int check;
 
   // free the code tables from the previous block
@@ -4586,25 +5212,18 @@ GBool FlateStream::startBlock() {
     eof = gTrue;
   blockHdr >>= 1;
 
-  // uncompressed block
+  // uncompressed block: it starts at the next byte boundary, which may
+  // be in the bit buffer
   if (blockHdr == 0) {
     compressedBlock = gFalse;
-    if ((c = str->getChar()) == EOF)
-      goto err;
-    blockLen = c & 0xff;
-    if ((c = str->getChar()) == EOF)
-      goto err;
-    blockLen |= (c & 0xff) << 8;
-    if ((c = str->getChar()) == EOF)
+    codeBuf >>= codeSize & 7;
+    codeSize &= ~7;
+    if ((blockLen = getCodeWord(16)) == EOF)
       goto err;
-    check = c & 0xff;
-    if ((c = str->getChar()) == EOF)
+    if ((check = getCodeWord(16)) == EOF)
       goto err;
-    check |= (c & 0xff) << 8;
     if (check != (~blockLen & 0xffff))
       error(errSyntaxError, getPos(), "Bad uncompressed block length in flate stream");
-    codeBuf = 0;
-    codeSize = 0;
 
   // compressed block with fixed codes
   } else if (blockHdr == 1) {
@@ -4635,8 +5254,10 @@ err:
 void FlateStream::loadFixedCodes() {
   litCodeTab.codes = fixedLitCodeTab.codes;
   litCodeTab.maxLen = fixedLitCodeTab.maxLen;
+  litCodeTab.lookupBits = fixedLitCodeTab.lookupBits;
   distCodeTab.codes = fixedDistCodeTab.codes;
   distCodeTab.maxLen = fixedDistCodeTab.maxLen;
+  distCodeTab.lookupBits = fixedDistCodeTab.lookupBits;
 }
 
 GBool FlateStream::readDynamicCodes() {
@@ -4742,7 +5363,9 @@ err:
 // Convert an array <lengths> of <n> lengths, in value order, into a
 // Huffman code lookup table.
 void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
-  int tabSize, len, code, code2, skip, val, i, t;
+  int subBits[1 << flateLookupBits];
+  FlateCode *sub;
+  int tabSize, len, code, code2, skip, val, i, t, p;
 
   // find max code length
   tab->maxLen = 0;
@@ -4751,18 +5374,62 @@ void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
       tab->maxLen = lengths[val];
     }
   }
+  tab->lookupBits = tab->maxLen < flateLookupBits ? tab->maxLen
+                                                  : flateLookupBits;
 
-  // allocate the table
-  tabSize = 1 << tab->maxLen;
-  tab->codes = (FlateCode *)gmallocn(tabSize, sizeof(FlateCode));
+  // find the size of the second level table under each first level
+  // entry, from the longest code that starts with it
+  tabSize = 1 << tab->lookupBits;
+  for (i = 0; i < tabSize; ++i) {
+    subBits[i] = 0;
+  }
+  code = 0;
+  for (len = 1; len <= tab->maxLen; ++len, code <<= 1) {
+    for (val = 0; val < n; ++val) {
+      if (lengths[val] == len) {
+	if (len > tab->lookupBits) {
+	  code2 = 0;
+	  t = code;
+	  for (i = 0; i < len; ++i) {
+	    code2 = (code2 << 1) | (t & 1);
+	    t >>= 1;
+	  }
+	  p = code2 & (tabSize - 1);
+	  if (len - tab->lookupBits > subBits[p]) {
+	    subBits[p] = len - tab->lookupBits;
+	  }
+	}
+	++code;
+      }
+    }
+  }
 
-  // clear the table
+  // allocate the table
+  t = tabSize;
   for (i = 0; i < tabSize; ++i) {
+    if (subBits[i]) {
+      t += 1 << subBits[i];
+    }
+  }
+  tab->codes = (FlateCode *)gmallocn(t, sizeof(FlateCode));
+
+  // clear the table, and link the second level tables
+  for (i = 0; i < t; ++i) {
     tab->codes[i].len = 0;
     tab->codes[i].val = 0;
   }
+  t = tabSize;
+  for (i = 0; i < tabSize; ++i) {
+    if (subBits[i]) {
+      tab->codes[i].len = (Gushort)(tab->lookupBits + subBits[i]);
+      tab->codes[i].val = (Gushort)t;
+      t += 1 << subBits[i];
+    }
+  }
 
-  // build the table
+  // build the table -- codes are filled in the same order as in a
+  // single table indexed by maxLen bits, so that invalid (over-
+  // subscribed) code lengths decode the same way
   for (len = 1, code = 0, skip = 2;
        len <= tab->maxLen;
        ++len, code <<= 1, skip <<= 1) {
@@ -4778,9 +5445,27 @@ void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
 	}
 
 	// fill in the table entries
-	for (i = code2; i < tabSize; i += skip) {
-	  tab->codes[i].len = (Gushort)len;
-	  tab->codes[i].val = (Gushort)val;
+	if (len <= tab->lookupBits) {
+	  for (i = code2; i < tabSize; i += skip) {
+	    if (tab->codes[i].len > tab->lookupBits) {
+	      sub = tab->codes + tab->codes[i].val;
+	      for (p = 0; p < (1 << subBits[i]); ++p) {
+		sub[p].len = (Gushort)len;
+		sub[p].val = (Gushort)val;
+	      }
+	    } else {
+	      tab->codes[i].len = (Gushort)len;
+	      tab->codes[i].val = (Gushort)val;
+	    }
+	  }
+	} else {
+	  p = code2 & (tabSize - 1);
+	  sub = tab->codes + tab->codes[p].val;
+	  for (i = code2 >> tab->lookupBits; i < (1 << subBits[p]);
+	       i += 1 << (len - tab->lookupBits)) {
+	    sub[i].len = (Gushort)len;
+	    sub[i].val = (Gushort)val;
+	  }
 	}
 
 	++code;
@@ -4789,41 +5474,36 @@ void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
   }
 }
 
-int FlateStream::getHuffmanCodeWord(FlateHuffmanTab *tab) {
-  FlateCode *code;
-  int c;
-
-  while (codeSize < tab->maxLen) {
-    if ((c = str->getChar()) == EOF) {
-      break;
-    }
-    codeBuf |= (c & 0xff) << codeSize;
-    codeSize += 8;
-  }
-  code = &tab->codes[codeBuf & ((1 << tab->maxLen) - 1)];
-  if (codeSize == 0 || codeSize < code->len || code->len == 0) {
-    return EOF;
-  }
-  codeBuf >>= code->len;
-  codeSize -= code->len;
-  return (int)code->val;
-}
-
-int FlateStream::getCodeWord(int bits) {
-  int c;
+// Add whole bytes from the underlying stream to the bit buffer until
+// it holds at least <bits> bits.  If the stream keeps its data in a
+// buffer, the bit buffer is filled up to nearly its full width at
+// once; otherwise bytes are read one at a time, so that nothing past
+// the end of the flate data is consumed (inline images are followed
+// by more content).  Returns false if the stream ends first.
+GBool FlateStream::fillCodeBuf(int bits) {
+  const Guchar *p;
+  int n, i, c;
 
   while (codeSize < bits) {
-    if ((c = str->getChar()) == EOF)
-      return EOF;
-    codeBuf |= (c & 0xff) << codeSize;
-    codeSize += 8;
+    if ((p = str->peekChars(&n))) {
+      if (n == 0) {
+	return gFalse;
+      }
+      for (i = 0; i < n && codeSize <= flateCodeBufBits - 8; ++i) {
+	codeBuf |= (Gulong)p[i] << codeSize;
+	codeSize += 8;
+      }
+      str->skipPeekedChars(i);
+    } else {
+      if ((c = str->getChar()) == EOF) {
+	return gFalse;
+      }
+      codeBuf |= (Gulong)(c & 0xff) << codeSize;
+      codeSize += 8;
+    }
   }
-  c = codeBuf & ((1 << bits) - 1);
-  codeBuf >>= bits;
-  codeSize -= bits;
-  return c;
+  return gTrue;
 }
-#endif
 
 //------------------------------------------------------------------------
 // EOFStream
@@ -39,6 +39,10 @@
 #include "goo/gtypes.h"
 #include "Object.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class BaseStream;
 class CachedFile;
 
@@ -97,8 +101,8 @@ public:
   virtual ~Stream();
 
   // Reference counting.
-  int incRef() { return ++ref; }
-  int decRef() { return --ref; }
+  int incRef();
+  int decRef();
 
   // Get kind of stream.
   virtual StreamKind getKind() = 0;
@@ -168,7 +172,11 @@ public:
   // Get next char from stream without using the predictor.
   // This is only used by StreamPredictor.
   virtual int getRawChar();
-  virtual void getRawChars(int nChars, int *buffer);
+
+  // Get up to <nChars> chars from stream without using the predictor,
+  // and return the number read (less than <nChars> only at the end of
+  // the stream).  This is only used by StreamPredictor.
+  virtual int getRawChars(int nChars, Guchar *buffer);
 
   // Get next char directly from stream source, without filtering it
   virtual int getUnfilteredChar () = 0;
@@ -212,9 +220,38 @@ public:
   virtual void getImageParams(int * /*bitsPerComponent*/,
 			      StreamColorSpaceMode * /*csMode*/) {}
 
+  // Ask an image stream to decode the image at 1/<denom> (2, 4, or 8)
+  // of its size in each direction, or (<denom> = 1) at full size, from
+  // the next reset() on.  Returns the reduction actually used, which
+  // is 1 for streams that can only decode the full image.
+  virtual int setImageScaleDenom(int /*denom*/) { return 1; }
+
   // Return the next stream in the "stack".
   virtual Stream *getNextStream() { return NULL; }
 
+  // Return a pointer to the next characters of the stream, without
+  // consuming them, and set *<len> to their number (0 at the end of
+  // the stream).  The characters stay valid until another function is
+  // called on the stream.  Returns NULL if the stream does not keep
+  // its data in a buffer.
+  virtual const Guchar *peekChars(int * /*len*/) { return NULL; }
+
+  // Consume the first <n> characters returned by peekChars().
+  virtual void skipPeekedChars(int /*n*/) {}
+
+  // Return true if the stream decodes rows of a 1-bit image <width>
+  // pixels wide as runs, so that getRunsLine() can be used to read it.
+  virtual GBool hasGetRunsLine(int /*width*/) { return gFalse; }
+
+  // Read the next row of the image as runs: set *<runs> to the x
+  // coordinates at which the sample value changes, ending with the
+  // width of the image, and *<firstVal> to the value (0 or 1) of the
+  // first run.  Returns the number of entries in *<runs>, or 0 at the
+  // end of the stream.  The runs stay valid until the stream is read
+  // again.  Rows must be read either all with getRunsLine() or all as
+  // characters.
+  virtual int getRunsLine(int ** /*runs*/, int * /*firstVal*/) { return 0; }
+
   // Add filters to this stream according to the parameters in <dict>.
   // Returns the new stream.
   Stream *addFilters(Object *dict);
@@ -226,6 +263,9 @@ private:
   Stream *makeFilter(char *name, Stream *str, Object *params);
 
   int ref;			// reference count
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
 };
 
 
@@ -312,6 +352,11 @@ public:
   virtual Guint getStart() = 0;
   virtual void moveStart(int delta) = 0;
 
+  // Returns true if substreams made by makeSubStream() can be read
+  // from several threads at once, i.e., if their reads don't go
+  // through a position shared with the other substreams.
+  virtual GBool canReadConcurrently() { return gFalse; }
+
 protected:
 
   Guint length;
@@ -379,6 +424,13 @@ public:
   // Skip an entire line from the image.
   void skipLine();
 
+  // For 1-bit, 1-component images whose stream decodes rows as runs
+  // (see Stream::getRunsLine), read the next line as runs -- past the
+  // end of the stream, lines are a single run of 1s, as with
+  // getLine().  Returns 0 for other images, which must be read with
+  // getLine().
+  int getRunsLine(int **runs, int *firstVal);
+
 private:
 
   Stream *str;			// base stream
@@ -390,6 +442,8 @@ private:
   Guchar *inputLine;		// input line buffer
   Guchar *imgLine;		// line buffer
   int imgIdx;			// current index in imgLine
+  GBool useRuns;		// true if lines are read as runs
+  int eofRuns[1];		// runs returned past the end of the stream
 };
 
 //------------------------------------------------------------------------
@@ -425,12 +479,19 @@ private:
   int pixBytes;			// bytes per pixel
   int rowBytes;			// bytes per line
   Guchar *predLine;		// line buffer
+  Guchar *prevLine;		// previous line (the two are swapped
+				//   for each line)
   int predIdx;			// current index in predLine
   GBool ok;
 };
 
 //------------------------------------------------------------------------
 // FileStream
+//
+// All FileStreams created from the same FILE (through makeSubStream)
+// read with positional reads and keep their own position, so they
+// never depend on, or disturb, the shared file position.  This makes
+// it safe to read from several of them concurrently.
 //------------------------------------------------------------------------
 
 #define fileStreamBufSize 256
@@ -454,6 +515,12 @@ public:
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
   virtual void moveStart(int delta);
+  virtual GBool canReadConcurrently() { return gTrue; }
+
+  virtual const Guchar *peekChars(int *len)
+    { *len = (bufPtr >= bufEnd && !fillBuf()) ? 0 : (int)(bufEnd - bufPtr);
+      return (Guchar *)bufPtr; }
+  virtual void skipPeekedChars(int n) { bufPtr += n; }
 
   virtual int getUnfilteredChar () { return getChar(); }
   virtual void unfilteredReset () { reset(); }
@@ -463,27 +530,7 @@ private:
   GBool fillBuf();
   
   virtual GBool hasGetChars() { return true; }
-  virtual int getChars(int nChars, Guchar *buffer)
-    {
-      int n, m;
-
-      n = 0;
-      while (n < nChars) {
-        if (bufPtr >= bufEnd) {
-          if (!fillBuf()) {
-            break;
-          }
-        }
-        m = (int)(bufEnd - bufPtr);
-        if (m > nChars - n) {
-          m = nChars - n;
-        }
-        memcpy(buffer + n, bufPtr, m);
-        bufPtr += m;
-        n += m;
-      }
-      return n;
-    }
+  virtual int getChars(int nChars, Guchar *buffer);
 
   FILE *f;
   Guint start;
@@ -492,12 +539,13 @@ private:
   char *bufPtr;
   char *bufEnd;
   Guint bufPos;
-  int savePos;
-  GBool saved;
 };
 
 //------------------------------------------------------------------------
 // CachedFileStream
+//
+// Like FileStream, each CachedFileStream keeps its own position and
+// reads from the CachedFile with positional reads.
 //------------------------------------------------------------------------
 
 #define cachedStreamBufSize 1024
@@ -521,12 +569,21 @@ public:
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
   virtual void moveStart(int delta);
+  virtual GBool canReadConcurrently() { return gTrue; }
+
+  virtual const Guchar *peekChars(int *len)
+    { *len = (bufPtr >= bufEnd && !fillBuf()) ? 0 : (int)(bufEnd - bufPtr);
+      return (Guchar *)bufPtr; }
+  virtual void skipPeekedChars(int n) { bufPtr += n; }
 
   virtual int getUnfilteredChar () { return getChar(); }
   virtual void unfilteredReset () { reset(); }
 
 private:
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   GBool fillBuf();
 
   CachedFile *cc;
@@ -536,8 +593,6 @@ private:
   char *bufPtr;
   char *bufEnd;
   Guint bufPos;
-  int savePos;
-  GBool saved;
 };
 
 
@@ -563,11 +618,16 @@ public:
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
   virtual void moveStart(int delta);
+  virtual GBool canReadConcurrently() { return gTrue; }
 
   //if needFree = true, the stream will delete buf when it is destroyed
   //otherwise it will not touch it. Default value is false
   virtual void setNeedFree (GBool val) { needFree = val; }
 
+  virtual const Guchar *peekChars(int *len)
+    { *len = (int)(bufEnd - bufPtr); return (Guchar *)bufPtr; }
+  virtual void skipPeekedChars(int n) { bufPtr += n; }
+
   virtual int getUnfilteredChar () { return getChar(); }
   virtual void unfilteredReset () { reset (); } 
 
@@ -583,6 +643,37 @@ private:
   GBool needFree;
 };
 
+//------------------------------------------------------------------------
+// MappedFileStream
+//
+// A MemStream on a file mapped in memory.  Reads don't copy or seek,
+// and sub streams are just ranges of the mapping, which can be read
+// from several threads.  The file must not be truncated while it is
+// mapped.
+//------------------------------------------------------------------------
+
+class MappedFileStream: public MemStream {
+public:
+
+  // Map the whole of <f> and return a stream on it, or NULL if <f> is
+  // not a regular file or can't be mapped.
+  static MappedFileStream *create(FILE *f, Object *dictA);
+
+  virtual ~MappedFileStream();
+  virtual Stream *makeSubStream(Guint start, GBool limited,
+				Guint lengthA, Object *dictA);
+  virtual StreamKind getKind() { return strFile; }
+
+private:
+
+  MappedFileStream(char *mapA, Guint startA, Guint lengthA,
+		   Guint mapLenA, Object *dictA);
+
+  char *map;
+  Guint mapLen;			// size of the mapping, or 0 in sub streams,
+				//   which don't own it
+};
+
 //------------------------------------------------------------------------
 // EmbedStream
 //
@@ -641,6 +732,9 @@ public:
 
 private:
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   int buf;
   GBool eof;
 };
@@ -664,6 +758,9 @@ public:
 
 private:
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   int c[5];
   int b[4];
   int index, n;
@@ -685,7 +782,7 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
-  virtual void getRawChars(int nChars, int *buffer);
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, const char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -781,12 +878,19 @@ public:
   virtual int lookChar();
   virtual GooString *getPSFilter(int psLevel, const char *indent);
   virtual GBool isBinary(GBool last = gTrue);
+  virtual GBool hasGetRunsLine(int width) { return width == columns; }
+  virtual int getRunsLine(int **runs, int *firstVal);
 
   virtual void unfilteredReset ();
 
 private:
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   void ccittReset(GBool unfiltered);
+  GBool readRow();
+  void packRow(Guchar *p);
   int encoding;			// 'K' parameter
   GBool endOfLine;		// 'EndOfLine' parameter
   GBool byteAlign;		// 'EncodedByteAlign' parameter
@@ -863,6 +967,9 @@ public:
 
 private:
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   void dctReset(GBool unfiltered);  
   GBool progressive;		// set if in progressive mode
   GBool interleaved;		// set if in interleaved mode
@@ -924,17 +1031,24 @@ private:
 
 #endif
 
-#ifndef ENABLE_ZLIB
 //------------------------------------------------------------------------
 // FlateStream
+//
+// The built-in Flate decoder.  If poppler is built with zlib,
+// FlateZlibStream (FlateStream.h) can be used instead -- see
+// GlobalParams::setFlateUseZlib().
 //------------------------------------------------------------------------
 
 #define flateWindow          32768    // buffer size
 #define flateMask            (flateWindow-1)
+#define flateDecodeSize       4096    // characters decoded at a time
 #define flateMaxHuffman         15    // max Huffman code length
 #define flateMaxCodeLenCodes    19    // max # code length codes
 #define flateMaxLitCodes       288    // max # literal codes
 #define flateMaxDistCodes       30    // max # distance codes
+#define flateLookupBits          9    // bits looked up in the first
+                                      //   level of a code table
+#define flateCodeBufBits     ((int)sizeof(Gulong) * 8)
 
 // Huffman code table entry
 struct FlateCode {
@@ -942,9 +1056,14 @@ struct FlateCode {
   Gushort val;			// value represented by this code
 };
 
+// Codes are looked up with their first <lookupBits> bits.  Codes that
+// are longer than that share a first level entry whose <len> is
+// <lookupBits> plus the number of bits looked up in a second level
+// table, and whose <val> is the index of that table in <codes>.
 struct FlateHuffmanTab {
   FlateCode *codes;
   int maxLen;
+  int lookupBits;
 };
 
 // Decoding info for length and distance code words
@@ -964,10 +1083,12 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
-  virtual void getRawChars(int nChars, int *buffer);
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, const char *indent);
   virtual GBool isBinary(GBool last = gTrue);
   virtual void unfilteredReset ();
+  virtual const Guchar *peekChars(int *len);
+  virtual void skipPeekedChars(int n);
 
 private:
   inline int doGetRawChar() {
@@ -984,6 +1105,39 @@ private:
     return c;
   }
 
+  inline int getHuffmanCodeWord(FlateHuffmanTab *tab) {
+    FlateCode *code;
+
+    // near the end of the stream, look up with the bits that are left
+    if (codeSize < tab->maxLen) {
+      fillCodeBuf(tab->maxLen);
+    }
+    code = &tab->codes[codeBuf & ((1 << tab->lookupBits) - 1)];
+    if (code->len > tab->lookupBits) {
+      code = &tab->codes[code->val +
+			 ((codeBuf >> tab->lookupBits) &
+			  ((1 << (code->len - tab->lookupBits)) - 1))];
+    }
+    if (codeSize < code->len || code->len == 0) {
+      return EOF;
+    }
+    codeBuf >>= code->len;
+    codeSize -= code->len;
+    return (int)code->val;
+  }
+
+  inline int getCodeWord(int bits) {
+    int c;
+
+    if (codeSize < bits && !fillCodeBuf(bits)) {
+      return EOF;
+    }
+    c = (int)(codeBuf & ((1 << bits) - 1));
+    codeBuf >>= bits;
+    codeSize -= bits;
+    return c;
+  }
+
   virtual GBool hasGetChars() { return true; }
   virtual int getChars(int nChars, Guchar *buffer);
 
@@ -991,7 +1145,7 @@ private:
   Guchar buf[flateWindow];	// output data buffer
   int index;			// current index into output buffer
   int remain;			// number valid bytes in output buffer
-  int codeBuf;			// input buffer
+  Gulong codeBuf;		// input buffer
   int codeSize;			// number of bits in input buffer
   int				// literal and distance code lengths
     codeLengths[flateMaxLitCodes + flateMaxDistCodes];
@@ -1018,10 +1172,8 @@ private:
   void loadFixedCodes();
   GBool readDynamicCodes();
   void compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab);
-  int getHuffmanCodeWord(FlateHuffmanTab *tab);
-  int getCodeWord(int bits);
+  GBool fillCodeBuf(int bits);
 };
-#endif
 
 //------------------------------------------------------------------------
 // EOFStream
@@ -40,6 +40,9 @@
 #include <ctype.h>
 #include <limits.h>
 #include "goo/gmem.h"
+#if MULTITHREADED
+#include "goo/GooThread.h"
+#endif
 #include "Object.h"
 #include "Stream.h"
 #include "Lexer.h"
@@ -47,8 +50,12 @@
 #include "Dict.h"
 #include "Error.h"
 #include "ErrorCodes.h"
+#include "GlobalParams.h"
 #include "XRef.h"
-#include "PopplerCache.h"
+#include "Decrypt.h"
+#include "ImageCache.h"
+#include "JBIG2Stream.h"
+#include "GfxFormCache.h"
 
 //------------------------------------------------------------------------
 // Permission bits
@@ -65,16 +72,26 @@
 #define permHighResPrint  (1<<11) // bit 12
 #define defPermFlags 0xfffc
 
+#if MULTITHREADED
+#  define xrefLocker()   MutexLocker locker(&mutex)
+#else
+#  define xrefLocker()
+#endif
+
 //------------------------------------------------------------------------
 // ObjectStream
 //------------------------------------------------------------------------
 
+static Guint objectSize(Object *obj);
+
+// An object stream is kept as its decoded data plus the position of
+// each object in it; objects are only parsed when they are fetched.
 class ObjectStream {
 public:
 
   // Create an object stream, using object number <objStrNum>,
   // generation 0.
-  ObjectStream(XRef *xref, int objStrNumA);
+  ObjectStream(XRef *xrefA, int objStrNumA);
 
   GBool isOk() { return ok; }
 
@@ -87,57 +104,43 @@ public:
   // object number <objNum>, generation 0.
   Object *getObject(int objIdx, int objNum, Object *obj);
 
+  // Return the estimated memory used by the decoded data, the index
+  // and the objects parsed so far.
+  Guint getBytes() { return bytes; }
+
 private:
 
+  XRef *xref;
   int objStrNum;		// object number of the object stream
   int nObjects;			// number of objects in the stream
-  Object *objs;			// the objects (length = nObjects)
+  char *buf;			// decoded stream data
+  Guint bufLen;
+  Guint *starts;		// position of each object in buf
+				//   (length = nObjects + 1)
   int *objNums;			// the object numbers (length = nObjects)
+  Object *objs;			// the objects parsed so far (objNone if
+				//   not parsed yet) (length = nObjects)
+  Guint bytes;
   GBool ok;
 };
 
-class ObjectStreamKey : public PopplerCacheKey
-{
-  public:
-    ObjectStreamKey(int num) : objStrNum(num)
-    {
-    }
-
-    bool operator==(const PopplerCacheKey &key) const
-    {
-      const ObjectStreamKey *k = static_cast<const ObjectStreamKey*>(&key);
-      return objStrNum == k->objStrNum;
-    }
-
-    const int objStrNum;
-};
-
-class ObjectStreamItem : public PopplerCacheItem
-{
-  public:
-    ObjectStreamItem(ObjectStream *objStr) : objStream(objStr)
-    {
-    }
-
-    ~ObjectStreamItem()
-    {
-      delete objStream;
-    }
-
-    ObjectStream *objStream;
-};
-
-ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
+ObjectStream::ObjectStream(XRef *xrefA, int objStrNumA) {
   Stream *str;
   Parser *parser;
   int *offsets;
   Object objStr, obj1, obj2;
-  int first, i;
+  Guint bufSize, objStart;
+  int first, n, i;
 
+  xref = xrefA;
   objStrNum = objStrNumA;
   nObjects = 0;
-  objs = NULL;
+  buf = NULL;
+  bufLen = 0;
+  starts = NULL;
   objNums = NULL;
+  objs = NULL;
+  bytes = sizeof(ObjectStream);
   ok = gFalse;
 
   if (!xref->fetch(objStrNum, 0, &objStr)->isStream()) {
@@ -171,14 +174,33 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
     error(errSyntaxError, -1, "Too many objects in an object stream");
     goto err1;
   }
+
+  // decode the whole stream
+  str = objStr.getStream();
+  str->reset();
+  bufSize = 0;
+  do {
+    if (bufLen == bufSize) {
+      if (bufSize > (Guint)INT_MAX / 2) {
+	error(errSyntaxError, -1, "Object stream is too large");
+	goto err1;
+      }
+      bufSize = bufSize ? 2 * bufSize : 16384;
+      buf = (char *)grealloc(buf, bufSize);
+    }
+    n = str->doGetChars(bufSize - bufLen, (Guchar *)buf + bufLen);
+    bufLen += n;
+  } while (n > 0);
+  str->close();
+
   objs = new Object[nObjects];
   objNums = (int *)gmallocn(nObjects, sizeof(int));
+  starts = (Guint *)gmallocn(nObjects + 1, sizeof(Guint));
   offsets = (int *)gmallocn(nObjects, sizeof(int));
 
   // parse the header: object numbers and offsets
-  objStr.streamReset();
   obj1.initNull();
-  str = new EmbedStream(objStr.getStream(), &obj1, gTrue, first);
+  str = new MemStream(buf, 0, (Guint)first < bufLen ? first : bufLen, &obj1);
   parser = new Parser(xref, new Lexer(xref, str), gFalse);
   for (i = 0; i < nObjects; ++i) {
     parser->getObj(&obj1);
@@ -201,32 +223,22 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
       goto err1;
     }
   }
-  while (str->getChar() != EOF) ;
   delete parser;
 
-  // skip to the first object - this shouldn't be necessary because
-  // the First key is supposed to be equal to offsets[0], but just in
-  // case...
-  for (i = first; i < offsets[0]; ++i) {
-    objStr.getStream()->getChar();
-  }
-
-  // parse the objects
+  // the objects start at the first one, which should be at <first>
+  // (the First key is supposed to be equal to offsets[0], but just in
+  // case...), and each one runs up to the next one
+  objStart = offsets[0] > first ? offsets[0] : first;
   for (i = 0; i < nObjects; ++i) {
-    obj1.initNull();
-    if (i == nObjects - 1) {
-      str = new EmbedStream(objStr.getStream(), &obj1, gFalse, 0);
-    } else {
-      str = new EmbedStream(objStr.getStream(), &obj1, gTrue,
-			    offsets[i+1] - offsets[i]);
+    starts[i] = objStart + (offsets[i] - offsets[0]);
+    if (starts[i] > bufLen) {
+      starts[i] = bufLen;
     }
-    parser = new Parser(xref, new Lexer(xref, str), gFalse);
-    parser->getObj(&objs[i]);
-    while (str->getChar() != EOF) ;
-    delete parser;
   }
-
+  starts[nObjects] = bufLen;
   gfree(offsets);
+
+  bytes += bufLen + nObjects * (sizeof(Object) + sizeof(int) + sizeof(Guint));
   ok = gTrue;
 
  err1:
@@ -243,15 +255,683 @@ ObjectStream::~ObjectStream() {
     delete[] objs;
   }
   gfree(objNums);
+  gfree(starts);
+  gfree(buf);
 }
 
 Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
+  Stream *str;
+  Parser *parser;
+  Object obj1;
+
   if (objIdx < 0 || objIdx >= nObjects || objNum != objNums[objIdx]) {
     return obj->initNull();
   }
+  if (objs[objIdx].isNone()) {
+    obj1.initNull();
+    str = new MemStream(buf, starts[objIdx],
+			starts[objIdx + 1] - starts[objIdx], &obj1);
+    parser = new Parser(xref, new Lexer(xref, str), gFalse);
+    parser->getObj(&objs[objIdx]);
+    delete parser;
+    bytes += objectSize(&objs[objIdx]);
+  }
   return objs[objIdx].copy(obj);
 }
 
+//------------------------------------------------------------------------
+// ObjectStreamCache
+//------------------------------------------------------------------------
+
+// Cache of object streams, keyed by object number.  The least
+// recently used object streams are dropped when the memory they hold
+// exceeds <maxBytes>; the most recently used one is always kept.
+// Callers must hold the XRef lock.
+
+#define objStrCacheHashSize 64	// must be a power of 2
+
+#define defaultObjStrCacheSize (4 * 1024 * 1024)
+
+struct ObjectStreamCacheEntry {
+  ObjectStream *objStr;
+  Guint bytes;			// memory of objStr, as last accounted for
+  ObjectStreamCacheEntry *prev;	// LRU list, most recently used first
+  ObjectStreamCacheEntry *next;
+  ObjectStreamCacheEntry *hashNext;
+};
+
+class ObjectStreamCache {
+public:
+
+  ObjectStreamCache(Guint maxBytesA);
+  ~ObjectStreamCache();
+
+  // Set the memory budget, dropping object streams if needed.
+  void setMaxBytes(Guint maxBytesA);
+
+  // Return object stream <num>, which becomes the most recently used
+  // one, or NULL if it is not in the cache.
+  ObjectStream *lookup(int num);
+
+  // Add <objStr> to the cache, as the most recently used object
+  // stream.
+  void put(ObjectStream *objStr);
+
+  // Account for the objects parsed from the most recently used object
+  // stream since it was added or last updated.
+  void update();
+
+private:
+
+  void evict();
+
+  ObjectStreamCacheEntry *hashTab[objStrCacheHashSize];
+  ObjectStreamCacheEntry *head;	// most recently used
+  ObjectStreamCacheEntry *tail;	// least recently used
+  Guint bytes;
+  Guint maxBytes;
+};
+
+ObjectStreamCache::ObjectStreamCache(Guint maxBytesA) {
+  memset(hashTab, 0, sizeof(hashTab));
+  head = tail = NULL;
+  bytes = 0;
+  maxBytes = maxBytesA;
+}
+
+ObjectStreamCache::~ObjectStreamCache() {
+  ObjectStreamCacheEntry *entry, *next;
+
+  for (entry = head; entry; entry = next) {
+    next = entry->next;
+    delete entry->objStr;
+    delete entry;
+  }
+}
+
+void ObjectStreamCache::setMaxBytes(Guint maxBytesA) {
+  maxBytes = maxBytesA;
+  evict();
+}
+
+ObjectStream *ObjectStreamCache::lookup(int num) {
+  ObjectStreamCacheEntry *entry;
+
+  for (entry = hashTab[num & (objStrCacheHashSize - 1)];
+       entry;
+       entry = entry->hashNext) {
+    if (entry->objStr->getObjStrNum() == num) {
+      break;
+    }
+  }
+  if (!entry) {
+    return NULL;
+  }
+  if (entry != head) {
+    entry->prev->next = entry->next;
+    if (entry->next) {
+      entry->next->prev = entry->prev;
+    } else {
+      tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = head;
+    head->prev = entry;
+    head = entry;
+  }
+  return entry->objStr;
+}
+
+void ObjectStreamCache::put(ObjectStream *objStr) {
+  ObjectStreamCacheEntry *entry;
+  int h;
+
+  entry = new ObjectStreamCacheEntry;
+  entry->objStr = objStr;
+  entry->bytes = objStr->getBytes();
+  h = objStr->getObjStrNum() & (objStrCacheHashSize - 1);
+  entry->hashNext = hashTab[h];
+  hashTab[h] = entry;
+  entry->prev = NULL;
+  entry->next = head;
+  if (head) {
+    head->prev = entry;
+  } else {
+    tail = entry;
+  }
+  head = entry;
+  bytes += entry->bytes;
+  evict();
+}
+
+void ObjectStreamCache::update() {
+  if (head && head->objStr->getBytes() != head->bytes) {
+    bytes += head->objStr->getBytes() - head->bytes;
+    head->bytes = head->objStr->getBytes();
+    evict();
+  }
+}
+
+void ObjectStreamCache::evict() {
+  ObjectStreamCacheEntry *entry, **p;
+
+  while (bytes > maxBytes && tail && tail != head) {
+    entry = tail;
+    tail = entry->prev;
+    tail->next = NULL;
+    for (p = &hashTab[entry->objStr->getObjStrNum() &
+		      (objStrCacheHashSize - 1)];
+	 *p != entry;
+	 p = &(*p)->hashNext) ;
+    *p = entry->hashNext;
+    bytes -= entry->bytes;
+    delete entry->objStr;
+    delete entry;
+  }
+}
+
+//------------------------------------------------------------------------
+// XRefObjectCache
+//------------------------------------------------------------------------
+
+// Cache of parsed dictionaries and arrays, keyed by object number.
+// The memory held by the cached objects is estimated, and the least
+// recently used objects are dropped when it exceeds <maxBytes>.
+// Callers must hold the XRef lock.
+
+struct XRefObjectCacheEntry {
+  int num, gen;
+  Object obj;
+  Guint bytes;			// estimated size of obj
+  XRefObjectCacheEntry *prev;	// LRU list, most recently used first
+  XRefObjectCacheEntry *next;
+  XRefObjectCacheEntry *hashNext;
+};
+
+class XRefObjectCache {
+public:
+
+  XRefObjectCache(Guint maxBytesA);
+  ~XRefObjectCache();
+
+  // Set the memory budget, dropping objects if needed.
+  void setMaxBytes(Guint maxBytesA);
+
+  // Copy the cached object <num>, <gen> to <obj>.  Returns false if
+  // it is not in the cache.
+  GBool lookup(int num, int gen, Object *obj);
+
+  // Add a copy of <obj> to the cache, replacing any previous object
+  // with the same number.
+  void put(int num, int gen, Object *obj);
+
+  // Drop object <num> from the cache.
+  void remove(int num);
+
+  // Drop all objects.
+  void clear();
+
+  // Return the estimated memory held by the cached objects.
+  Guint getBytes() { return bytes; }
+
+private:
+
+  XRefObjectCacheEntry *find(int num);
+  void unlink(XRefObjectCacheEntry *entry);
+  void evict();
+
+  XRefObjectCacheEntry **hashTab;
+  int hashSize;			// always a power of 2
+  int nEntries;
+  XRefObjectCacheEntry *head;	// most recently used
+  XRefObjectCacheEntry *tail;	// least recently used
+  Guint bytes;
+  Guint maxBytes;
+};
+
+// Rough estimate of the heap memory used by a parsed object.
+static Guint objectSize(Object *obj) {
+  Object obj1;
+  Guint n;
+  int i;
+
+  n = sizeof(Object);
+  switch (obj->getType()) {
+  case objString:
+    n += sizeof(GooString) + obj->getString()->getLength();
+    break;
+  case objName:
+    n += strlen(obj->getName()) + 1;
+    break;
+  case objArray:
+    n += sizeof(Array);
+    for (i = 0; i < obj->arrayGetLength(); ++i) {
+      n += objectSize(obj->arrayGetNF(i, &obj1));
+      obj1.free();
+    }
+    break;
+  case objDict:
+    n += sizeof(Dict);
+    for (i = 0; i < obj->dictGetLength(); ++i) {
+      n += sizeof(DictEntry) - sizeof(Object) +
+	   strlen(obj->dictGetKey(i)) + 1;
+      n += objectSize(obj->dictGetValNF(i, &obj1));
+      obj1.free();
+    }
+    break;
+  default:
+    break;
+  }
+  return n;
+}
+
+XRefObjectCache::XRefObjectCache(Guint maxBytesA) {
+  hashSize = 256;
+  hashTab = (XRefObjectCacheEntry **)gmallocn(hashSize,
+					      sizeof(XRefObjectCacheEntry *));
+  memset(hashTab, 0, hashSize * sizeof(XRefObjectCacheEntry *));
+  nEntries = 0;
+  head = tail = NULL;
+  bytes = 0;
+  maxBytes = maxBytesA;
+}
+
+XRefObjectCache::~XRefObjectCache() {
+  XRefObjectCacheEntry *entry, *next;
+
+  for (entry = head; entry; entry = next) {
+    next = entry->next;
+    entry->obj.free();
+    delete entry;
+  }
+  gfree(hashTab);
+}
+
+void XRefObjectCache::setMaxBytes(Guint maxBytesA) {
+  maxBytes = maxBytesA;
+  evict();
+}
+
+XRefObjectCacheEntry *XRefObjectCache::find(int num) {
+  XRefObjectCacheEntry *entry;
+
+  for (entry = hashTab[num & (hashSize - 1)]; entry; entry = entry->hashNext) {
+    if (entry->num == num) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+GBool XRefObjectCache::lookup(int num, int gen, Object *obj) {
+  XRefObjectCacheEntry *entry;
+
+  if (!(entry = find(num)) || entry->gen != gen) {
+    return gFalse;
+  }
+  if (entry != head) {
+    entry->prev->next = entry->next;
+    if (entry->next) {
+      entry->next->prev = entry->prev;
+    } else {
+      tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = head;
+    head->prev = entry;
+    head = entry;
+  }
+  entry->obj.copy(obj);
+  return gTrue;
+}
+
+void XRefObjectCache::put(int num, int gen, Object *obj) {
+  XRefObjectCacheEntry *entry, *next, **oldTab;
+  Guint objBytes;
+  int oldSize, h, i;
+
+  objBytes = sizeof(XRefObjectCacheEntry) + objectSize(obj);
+  if (objBytes > maxBytes) {
+    return;
+  }
+  remove(num);
+
+  // grow the hash table to keep the chains short
+  if (nEntries >= hashSize) {
+    oldTab = hashTab;
+    oldSize = hashSize;
+    hashSize *= 2;
+    hashTab = (XRefObjectCacheEntry **)gmallocn(hashSize,
+						sizeof(XRefObjectCacheEntry *));
+    memset(hashTab, 0, hashSize * sizeof(XRefObjectCacheEntry *));
+    for (i = 0; i < oldSize; ++i) {
+      for (entry = oldTab[i]; entry; entry = next) {
+	next = entry->hashNext;
+	h = entry->num & (hashSize - 1);
+	entry->hashNext = hashTab[h];
+	hashTab[h] = entry;
+      }
+    }
+    gfree(oldTab);
+  }
+
+  entry = new XRefObjectCacheEntry;
+  entry->num = num;
+  entry->gen = gen;
+  obj->copy(&entry->obj);
+  entry->bytes = objBytes;
+  h = num & (hashSize - 1);
+  entry->hashNext = hashTab[h];
+  hashTab[h] = entry;
+  entry->prev = NULL;
+  entry->next = head;
+  if (head) {
+    head->prev = entry;
+  } else {
+    tail = entry;
+  }
+  head = entry;
+  ++nEntries;
+  bytes += objBytes;
+  evict();
+}
+
+void XRefObjectCache::remove(int num) {
+  XRefObjectCacheEntry *entry;
+
+  if ((entry = find(num))) {
+    unlink(entry);
+  }
+}
+
+void XRefObjectCache::unlink(XRefObjectCacheEntry *entry) {
+  XRefObjectCacheEntry **p;
+
+  for (p = &hashTab[entry->num & (hashSize - 1)]; *p != entry;
+       p = &(*p)->hashNext) ;
+  *p = entry->hashNext;
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+  } else {
+    head = entry->next;
+  }
+  if (entry->next) {
+    entry->next->prev = entry->prev;
+  } else {
+    tail = entry->prev;
+  }
+  --nEntries;
+  bytes -= entry->bytes;
+  entry->obj.free();
+  delete entry;
+}
+
+void XRefObjectCache::clear() {
+  while (head) {
+    unlink(head);
+  }
+}
+
+void XRefObjectCache::evict() {
+  while (tail && bytes > maxBytes) {
+    unlink(tail);
+  }
+}
+
+//------------------------------------------------------------------------
+// XRefObjectKey
+//------------------------------------------------------------------------
+
+// The decryption keys of recently used objects, in a direct-mapped
+// table indexed by object number (see XRef::getObjectKey).
+
+#define objKeyCacheSize 256	// must be a power of 2
+
+struct XRefObjectKey {
+  int num, gen;			// object (num is -1 for an unused slot)
+  int length;			// length of key
+  Guchar key[32];
+};
+
+//------------------------------------------------------------------------
+// XRefSection
+//------------------------------------------------------------------------
+
+// A range of object numbers in an xref section.
+struct XRefSubsection {
+  int first;			// first object number
+  int n;			// number of entries
+  GBool inFile;			// if set, <pos> is the file offset of the
+				//   first (20-byte) table entry, else it
+				//   is the index of its row
+  Guint pos;
+};
+
+// An older xref section, which is indexed but not read into the
+// entries array (see XRef::indexXRefSections).  Table entries are
+// read one at a time from the file.  Xref streams, and tables whose
+// entries are not all 20 bytes long, are kept as rows of
+// w[0]+w[1]+w[2] bytes; xref streams are only decoded when one of
+// their entries is needed.
+struct XRefSection {
+  XRefSubsection *subs;		// subsections
+  int nSubs;			// number of subsections
+  int subsSize;			// size of <subs> array
+  int minNum, maxNum;		// the subsections cover object numbers
+				//   minNum <= num < maxNum
+  Object str;			// xref stream, until it is decoded
+  int w[3];			// field widths of the rows
+  Guchar *rows;			// rows
+  int nRows;			// number of rows
+  int rowsSize;			// size of <rows> array, in rows
+};
+
+static XRefSubsection *addXRefSubsection(XRefSection *section,
+					 int first, int n) {
+  XRefSubsection *sub;
+
+  if (section->nSubs == section->subsSize) {
+    section->subsSize = section->subsSize ? 2 * section->subsSize : 4;
+    section->subs = (XRefSubsection *)greallocn(section->subs,
+						section->subsSize,
+						sizeof(XRefSubsection));
+  }
+  sub = &section->subs[section->nSubs++];
+  sub->first = first;
+  sub->n = n;
+  sub->inFile = gFalse;
+  sub->pos = 0;
+  if (section->nSubs == 1 || first < section->minNum) {
+    section->minNum = first;
+  }
+  if (section->nSubs == 1 || first + n > section->maxNum) {
+    section->maxNum = first + n;
+  }
+  return sub;
+}
+
+// Find the subsection of <section> that has an entry for object
+// <num>, or return NULL.
+static XRefSubsection *findXRefSubsection(XRefSection *section, int num) {
+  XRefSubsection *sub;
+  int i;
+
+  if (num < section->minNum || num >= section->maxNum) {
+    return NULL;
+  }
+  for (i = 0; i < section->nSubs; ++i) {
+    sub = &section->subs[i];
+    if (num >= sub->first && num - sub->first < sub->n) {
+      return sub;
+    }
+  }
+  return NULL;
+}
+
+// Append a row to a table section.
+static void addXRefRow(XRefSection *section, int type, Guint offset,
+		       Guint gen) {
+  Guchar *p;
+
+  if (section->nRows == section->rowsSize) {
+    section->rowsSize = section->rowsSize ? 2 * section->rowsSize : 64;
+    section->rows = (Guchar *)greallocn(section->rows, section->rowsSize,
+					section->w[0] + section->w[1] +
+					  section->w[2]);
+  }
+  p = section->rows + (size_t)section->nRows++ *
+                      (section->w[0] + section->w[1] + section->w[2]);
+  p[0] = (Guchar)type;
+  p[1] = (Guchar)(offset >> 24);
+  p[2] = (Guchar)(offset >> 16);
+  p[3] = (Guchar)(offset >> 8);
+  p[4] = (Guchar)offset;
+  p[5] = (Guchar)(gen >> 24);
+  p[6] = (Guchar)(gen >> 16);
+  p[7] = (Guchar)(gen >> 8);
+  p[8] = (Guchar)gen;
+}
+
+// Read all the rows of an xref stream section.
+static GBool decodeXRefSection(XRefSection *section) {
+  Stream *xrefStr;
+  int rowSize, n;
+
+  rowSize = section->w[0] + section->w[1] + section->w[2];
+  section->rows = (Guchar *)gmallocn_checkoverflow(section->nRows, rowSize);
+  if (!section->rows && section->nRows > 0 && rowSize > 0) {
+    section->str.free();
+    section->nRows = 0;
+    return gFalse;
+  }
+  xrefStr = section->str.getStream();
+  xrefStr->reset();
+  n = rowSize ? xrefStr->doGetChars(section->nRows * rowSize, section->rows)
+              : 0;
+  xrefStr->close();
+  section->str.free();
+  if (rowSize && n != section->nRows * rowSize) {
+    section->nRows = n / rowSize;
+    return gFalse;
+  }
+  return gTrue;
+}
+
+static GBool getXRefRow(XRefSection *section, int row, XRefEntry *entry) {
+  Guchar *p;
+  Guint offset;
+  int type, gen, i;
+
+  if (row >= section->nRows) {
+    return gFalse;
+  }
+  p = section->rows + (size_t)row *
+                      (section->w[0] + section->w[1] + section->w[2]);
+  if (section->w[0] == 0) {
+    type = 1;
+  } else {
+    for (type = 0, i = 0; i < section->w[0]; ++i) {
+      type = (type << 8) + *p++;
+    }
+  }
+  for (offset = 0, i = 0; i < section->w[1]; ++i) {
+    offset = (offset << 8) + *p++;
+  }
+  for (gen = 0, i = 0; i < section->w[2]; ++i) {
+    gen = (gen << 8) + *p++;
+  }
+  switch (type) {
+  case 0:
+    entry->type = xrefEntryFree;
+    break;
+  case 1:
+    entry->type = xrefEntryUncompressed;
+    break;
+  case 2:
+    entry->type = xrefEntryCompressed;
+    break;
+  default:
+    return gFalse;
+  }
+  entry->offset = offset;
+  entry->gen = gen;
+  entry->obj.initNull();
+  entry->updated = false;
+  return gTrue;
+}
+
+// Skip white space in an xref table, and return the next character.
+static int lookXRefTableChar(Stream *s) {
+  int c;
+
+  while ((c = s->lookChar()) != EOF && Lexer::isSpace(c)) {
+    s->getChar();
+  }
+  return c;
+}
+
+static GBool getXRefTableInt(Stream *s, Guint *val) {
+  Guint x;
+  int c;
+
+  c = lookXRefTableChar(s);
+  if (c < '0' || c > '9') {
+    return gFalse;
+  }
+  x = 0;
+  do {
+    if (x > (0xffffffff - 9) / 10) {
+      return gFalse;
+    }
+    x = 10 * x + (c - '0');
+    s->getChar();
+    c = s->lookChar();
+  } while (c >= '0' && c <= '9');
+  *val = x;
+  return gTrue;
+}
+
+static GBool getXRefTableKeyword(Stream *s, const char *keyword) {
+  lookXRefTableChar(s);
+  for (; *keyword; ++keyword) {
+    if (s->getChar() != *keyword) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+// Parse a table entry in the standard 20-byte format,
+// "nnnnnnnnnn ggggg n" followed by a two-character end of line.
+static GBool parseXRefTableEntry(Guchar *buf, XRefEntry *entry) {
+  Guint offset;
+  int gen, i;
+
+  for (offset = 0, i = 0; i < 10; ++i) {
+    if (buf[i] < '0' || buf[i] > '9') {
+      return gFalse;
+    }
+    offset = 10 * offset + (buf[i] - '0');
+  }
+  for (gen = 0, i = 11; i < 16; ++i) {
+    if (buf[i] < '0' || buf[i] > '9') {
+      return gFalse;
+    }
+    gen = 10 * gen + (buf[i] - '0');
+  }
+  if (buf[10] != ' ' || buf[16] != ' ' ||
+      (buf[17] != 'n' && buf[17] != 'f') ||
+      !Lexer::isSpace(buf[18]) || !Lexer::isSpace(buf[19])) {
+    return gFalse;
+  }
+  entry->offset = offset;
+  entry->gen = gen;
+  entry->type = buf[17] == 'n' ? xrefEntryUncompressed : xrefEntryFree;
+  entry->obj.initNull();
+  entry->updated = false;
+  return gTrue;
+}
+
 //------------------------------------------------------------------------
 // XRef
 //------------------------------------------------------------------------
@@ -264,9 +944,29 @@ void XRef::init() {
   size = 0;
   streamEnds = NULL;
   streamEndsLen = 0;
-  objStrs = new PopplerCache(5);
+  objStrs = new ObjectStreamCache(defaultObjStrCacheSize);
+  objCache = NULL;
+  objCacheHits = objCacheMisses = 0;
   mainXRefEntriesOffset = 0;
   xRefStream = gFalse;
+  sections = NULL;
+  nSections = sectionsSize = 0;
+  tableStr = NULL;
+  tableStrPos = 0;
+  encrypted = gFalse;
+  objKeys = NULL;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+  imageCache = new ImageCache(globalParams ?
+			       globalParams->getImageCacheSize() : 0);
+  jbig2GlobalsCache = new JBIG2GlobalsCache(globalParams ?
+			    globalParams->getJBIG2GlobalsCacheSize() : 0);
+  formCache = new GfxFormCache(globalParams ?
+			       globalParams->getFormContentCacheSize() : 0);
+  if (globalParams) {
+    setObjectCacheSize(globalParams->getXRefObjectCacheSize());
+  }
 }
 
 XRef::XRef() {
@@ -370,9 +1070,20 @@ XRef::~XRef() {
   if (streamEnds) {
     gfree(streamEnds);
   }
+  freeXRefSections();
   if (objStrs) {
     delete objStrs;
   }
+  if (objCache) {
+    delete objCache;
+  }
+  delete imageCache;
+  delete jbig2GlobalsCache;
+  delete formCache;
+  gfree(objKeys);
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
 }
 
 int XRef::reserve(int newSize)
@@ -731,120 +1442,550 @@ GBool XRef::readXRefStreamSection(Stream *xrefStr, int *w, int first, int n) {
 	type = (type << 8) + c;
       }
     }
-    for (offset = 0, j = 0; j < w[1]; ++j) {
-      if ((c = xrefStr->getChar()) == EOF) {
-	return gFalse;
+    for (offset = 0, j = 0; j < w[1]; ++j) {
+      if ((c = xrefStr->getChar()) == EOF) {
+	return gFalse;
+      }
+      offset = (offset << 8) + c;
+    }
+    for (gen = 0, j = 0; j < w[2]; ++j) {
+      if ((c = xrefStr->getChar()) == EOF) {
+	return gFalse;
+      }
+      gen = (gen << 8) + c;
+    }
+    if (entries[i].offset == 0xffffffff) {
+      switch (type) {
+      case 0:
+	entries[i].offset = offset;
+	entries[i].gen = gen;
+	entries[i].type = xrefEntryFree;
+	break;
+      case 1:
+	entries[i].offset = offset;
+	entries[i].gen = gen;
+	entries[i].type = xrefEntryUncompressed;
+	break;
+      case 2:
+	entries[i].offset = offset;
+	entries[i].gen = gen;
+	entries[i].type = xrefEntryCompressed;
+	break;
+      default:
+	return gFalse;
+      }
+    }
+  }
+
+  return gTrue;
+}
+
+// Index the xref sections from <prevXRefOffset> back to the oldest
+// one.  Only their subsection headers (and the dictionaries of xref
+// streams) are read; the entries are read by lookupXRefSections when
+// they are needed.
+GBool XRef::indexXRefSections() {
+  std::vector<Guint> followedPrev;
+  Guint pos;
+  GBool more;
+
+  pos = prevXRefOffset;
+  do {
+    for (size_t j = 0; j < followedPrev.size(); j++) {
+      if (followedPrev.at(j) == pos) {
+        error(errSyntaxError, -1, "Circular XRef");
+        ok = gFalse;
+        return gFalse;
+      }
+    }
+    followedPrev.push_back(pos);
+
+    std::vector<Guint> followedXRefStm;
+    more = indexXRef(&pos, &followedXRefStm);
+  } while (ok && more);
+  return ok;
+}
+
+// Index one xref section, like readXRef.
+GBool XRef::indexXRef(Guint *pos, std::vector<Guint> *followedXRefStm) {
+  Stream *s;
+  Parser *parser;
+  Object obj, obj2;
+  Guint trailerPos, pos2;
+  GBool more;
+  int iSection;
+
+  iSection = addXRefSection();
+  obj.initNull();
+  s = str->makeSubStream(start + *pos, gFalse, 0, &obj);
+  s->reset();
+
+  // index an old-style xref table
+  if (lookXRefTableChar(s) == 'x') {
+    if (!getXRefTableKeyword(s, "xref") ||
+	!indexXRefTable(s, iSection, &trailerPos)) {
+      delete s;
+      goto err0;
+    }
+    delete s;
+
+    // read the trailer dictionary
+    obj.initNull();
+    parser = new Parser(NULL,
+	       new Lexer(NULL,
+		 str->makeSubStream(trailerPos, gFalse, 0, &obj)),
+	       gTrue);
+    if (!parser->getObj(&obj)->isDict()) {
+      goto err1;
+    }
+
+    // get the 'Prev' pointer
+    obj.getDict()->lookupNF("Prev", &obj2);
+    if (obj2.isInt() || obj2.isRef()) {
+      pos2 = obj2.isInt() ? (Guint)obj2.getInt() : (Guint)obj2.getRefNum();
+      if (pos2 != *pos) {
+	*pos = pos2;
+	more = gTrue;
+      } else {
+	error(errSyntaxWarning, -1, "Infinite loop in xref table");
+	more = gFalse;
+      }
+    } else {
+      more = gFalse;
+    }
+    obj2.free();
+
+    // check for an 'XRefStm' key
+    if (obj.getDict()->lookup("XRefStm", &obj2)->isInt()) {
+      pos2 = (Guint)obj2.getInt();
+      for (size_t i = 0; ok == gTrue && i < followedXRefStm->size(); ++i) {
+	if (followedXRefStm->at(i) == pos2) {
+	  ok = gFalse;
+	}
+      }
+      if (ok) {
+	followedXRefStm->push_back(pos2);
+	indexXRef(&pos2, followedXRefStm);
+      }
+      if (!ok) {
+	obj2.free();
+	goto err1;
+      }
+    }
+    obj2.free();
+
+  // index an xref stream
+  } else {
+    delete s;
+    obj.initNull();
+    parser = new Parser(NULL,
+	       new Lexer(NULL,
+		 str->makeSubStream(start + *pos, gFalse, 0, &obj)),
+	       gTrue);
+    if (!parser->getObj(&obj, gTrue)->isInt()) {
+      goto err1;
+    }
+    obj.free();
+    if (!parser->getObj(&obj, gTrue)->isInt()) {
+      goto err1;
+    }
+    obj.free();
+    if (!parser->getObj(&obj, gTrue)->isCmd("obj")) {
+      goto err1;
+    }
+    obj.free();
+    if (!parser->getObj(&obj)->isStream()) {
+      goto err1;
+    }
+    more = indexXRefStream(&obj, iSection, pos);
+  }
+
+  obj.free();
+  delete parser;
+  return more;
+
+ err1:
+  obj.free();
+  delete parser;
+ err0:
+  ok = gFalse;
+  return gFalse;
+}
+
+// Index the subsections of a table, up to its 'trailer' keyword.
+GBool XRef::indexXRefTable(Stream *s, int iSection, Guint *trailerPos) {
+  XRefSection *section;
+  XRefSubsection *sub;
+  Guint first, n, offset, gen, entryPos, i;
+  Guchar buf[20];
+  XRefEntry entry, firstEntry;
+  GBool regular;
+  int c, j;
+
+  section = &sections[iSection];
+  while (1) {
+    if (lookXRefTableChar(s) == 't') {
+      if (!getXRefTableKeyword(s, "trailer")) {
+	return gFalse;
+      }
+      *trailerPos = s->getPos();
+      return gTrue;
+    }
+    if (!getXRefTableInt(s, &first) || !getXRefTableInt(s, &n) ||
+	first > INT_MAX || n > INT_MAX - first) {
+      return gFalse;
+    }
+    if ((int)(first + n) > size) {
+      if (resize(first + n) != (int)(first + n)) {
+	error(errSyntaxError, -1, "Invalid 'obj' parameters'");
+	return gFalse;
+      }
+    }
+    sub = addXRefSubsection(section, first, n);
+    if (n == 0) {
+      continue;
+    }
+
+    // entries are normally 20 bytes long, so that they can be found
+    // without parsing the ones before: check the first and the last
+    lookXRefTableChar(s);
+    entryPos = s->getPos();
+    regular = gFalse;
+    firstEntry.type = xrefEntryNone;
+    if (n <= (0xffffffff - entryPos) / 20 &&
+	s->doGetChars(20, buf) == 20 && parseXRefTableEntry(buf, &entry)) {
+      firstEntry = entry;
+      s->setPos(entryPos + 20 * (n - 1));
+      regular = s->doGetChars(20, buf) == 20 &&
+	        parseXRefTableEntry(buf, &entry);
+    }
+    if (regular) {
+      sub->inFile = gTrue;
+      sub->pos = entryPos;
+    } else {
+      s->setPos(entryPos);
+      sub->pos = section->nRows;
+      for (i = 0; i < n; ++i) {
+	if (!getXRefTableInt(s, &offset) || !getXRefTableInt(s, &gen)) {
+	  return gFalse;
+	}
+	c = lookXRefTableChar(s);
+	if (c != 'n' && c != 'f') {
+	  return gFalse;
+	}
+	s->getChar();
+	addXRefRow(section, c == 'n' ? 1 : 0, offset, gen);
+	if (i == 0) {
+	  firstEntry.offset = offset;
+	  firstEntry.gen = (int)gen;
+	  firstEntry.type = c == 'n' ? xrefEntryUncompressed : xrefEntryFree;
+	}
+      }
+    }
+
+    // PDF files of patents from the IBM Intellectual Property
+    // Network have a bug: the xref table claims to start at 1
+    // instead of 0.  As in readXRefTable, this is only fixed up when
+    // no newer section has an entry for object 1.
+    if (first == 1 && firstEntry.type == xrefEntryFree &&
+	firstEntry.offset == 0 && firstEntry.gen == 65535 &&
+	entries[1].offset == 0xffffffff) {
+      for (j = 0; j < iSection; ++j) {
+	if (findXRefSubsection(&sections[j], 1)) {
+	  break;
+	}
+      }
+      if (j == iSection) {
+	sub->first = 0;
+	section->minNum = 0;
+      }
+    }
+  }
+}
+
+// Index the subsections of an xref stream, like readXRefStream.
+GBool XRef::indexXRefStream(Object *xrefStr, int iSection, Guint *pos) {
+  XRefSection *section;
+  Dict *dict;
+  GBool more;
+  Object obj, obj2, idx;
+  int newSize, first, n, i;
+
+  section = &sections[iSection];
+  dict = xrefStr->streamGetDict();
+
+  if (!dict->lookupNF("Size", &obj)->isInt()) {
+    goto err1;
+  }
+  newSize = obj.getInt();
+  obj.free();
+  if (newSize < 0) {
+    goto err1;
+  }
+
+  if (!dict->lookupNF("W", &obj)->isArray() ||
+      obj.arrayGetLength() < 3) {
+    goto err1;
+  }
+  for (i = 0; i < 3; ++i) {
+    if (!obj.arrayGet(i, &obj2)->isInt()) {
+      obj2.free();
+      goto err1;
+    }
+    section->w[i] = obj2.getInt();
+    obj2.free();
+    if (section->w[i] < 0 || section->w[i] > 4) {
+      goto err1;
+    }
+  }
+  obj.free();
+
+  dict->lookupNF("Index", &idx);
+  if (idx.isArray()) {
+    for (i = 0; i+1 < idx.arrayGetLength(); i += 2) {
+      if (!idx.arrayGet(i, &obj)->isInt()) {
+	idx.free();
+	goto err1;
+      }
+      first = obj.getInt();
+      obj.free();
+      if (!idx.arrayGet(i+1, &obj)->isInt()) {
+	idx.free();
+	goto err1;
+      }
+      n = obj.getInt();
+      obj.free();
+      if (first < 0 || n < 0 || first + n < 0 ||
+	  section->nRows + n < 0) {
+	idx.free();
+	goto err0;
+      }
+      addXRefSubsection(section, first, n)->pos = section->nRows;
+      section->nRows += n;
+      newSize = first + n > newSize ? first + n : newSize;
+    }
+  } else {
+    addXRefSubsection(section, 0, newSize);
+    section->nRows = newSize;
+  }
+  idx.free();
+  if (newSize > size) {
+    if (resize(newSize) != newSize) {
+      error(errSyntaxError, -1, "Invalid 'size' parameter");
+      goto err0;
+    }
+  }
+  xrefStr->copy(&section->str);
+
+  dict->lookupNF("Prev", &obj);
+  if (obj.isInt()) {
+    *pos = (Guint)obj.getInt();
+    more = gTrue;
+  } else {
+    more = gFalse;
+  }
+  obj.free();
+
+  return more;
+
+ err1:
+  obj.free();
+ err0:
+  ok = gFalse;
+  return gFalse;
+}
+
+// Look for entry <num> in the older xref sections, newest first.
+// Returns 1 if it was found, 0 if no section has it, and -1 if the
+// section that has it can't be read.
+int XRef::lookupXRefSections(int num, XRefEntry *entry) {
+  XRefSection *section;
+  XRefSubsection *sub;
+  Guchar buf[20];
+  Guint pos;
+  Object obj;
+  int i;
+
+  for (i = 0; i < nSections; ++i) {
+    section = &sections[i];
+    if (!(sub = findXRefSubsection(section, num))) {
+      continue;
+    }
+    if (!sub->inFile) {
+      if (section->str.isStream() && !decodeXRefSection(section)) {
+	error(errSyntaxError, -1, "Failed to read XRef stream");
       }
-      offset = (offset << 8) + c;
+      return getXRefRow(section, sub->pos + (num - sub->first), entry)
+	       ? 1 : -1;
     }
-    for (gen = 0, j = 0; j < w[2]; ++j) {
-      if ((c = xrefStr->getChar()) == EOF) {
-	return gFalse;
+
+    // entries are mostly looked up in order, so only seek when the
+    // entry is not just ahead
+    pos = sub->pos + 20 * (Guint)(num - sub->first);
+    if (!tableStr) {
+      obj.initNull();
+      tableStr = str->makeSubStream(start, gFalse, 0, &obj);
+      tableStr->reset();
+      tableStr->setPos(pos);
+    } else if (pos < tableStrPos || pos - tableStrPos > 4096) {
+      tableStr->setPos(pos);
+    } else {
+      while (tableStrPos < pos && tableStr->getChar() != EOF) {
+	++tableStrPos;
       }
-      gen = (gen << 8) + c;
     }
-    if (entries[i].offset == 0xffffffff) {
-      switch (type) {
-      case 0:
-	entries[i].offset = offset;
-	entries[i].gen = gen;
-	entries[i].type = xrefEntryFree;
-	break;
-      case 1:
-	entries[i].offset = offset;
-	entries[i].gen = gen;
-	entries[i].type = xrefEntryUncompressed;
-	break;
-      case 2:
-	entries[i].offset = offset;
-	entries[i].gen = gen;
-	entries[i].type = xrefEntryCompressed;
-	break;
-      default:
-	return gFalse;
-      }
+    tableStrPos = pos + 20;
+    if (tableStr->doGetChars(20, buf) != 20 ||
+	!parseXRefTableEntry(buf, entry)) {
+      tableStrPos = 0xffffffff;
+      error(errSyntaxError, -1, "Failed to parse XRef entry [{0:d}].", num);
+      return -1;
     }
+    return 1;
   }
+  return 0;
+}
 
-  return gTrue;
+int XRef::addXRefSection() {
+  XRefSection *section;
+
+  if (nSections == sectionsSize) {
+    sectionsSize = sectionsSize ? 2 * sectionsSize : 8;
+    sections = (XRefSection *)greallocn(sections, sectionsSize,
+					sizeof(XRefSection));
+  }
+  section = &sections[nSections];
+  section->subs = NULL;
+  section->nSubs = section->subsSize = 0;
+  section->minNum = section->maxNum = 0;
+  section->str.initNull();
+  // layout of the rows of tables
+  section->w[0] = 1;
+  section->w[1] = 4;
+  section->w[2] = 4;
+  section->rows = NULL;
+  section->nRows = section->rowsSize = 0;
+  return nSections++;
 }
 
-// Attempt to construct an xref table for a damaged file.
-GBool XRef::constructXRef(GBool *wasReconstructed) {
-  Parser *parser;
-  Object newTrailerDict, obj;
-  char buf[256];
+void XRef::freeXRefSections() {
+  int i;
+
+  for (i = 0; i < nSections; ++i) {
+    gfree(sections[i].subs);
+    sections[i].str.free();
+    gfree(sections[i].rows);
+  }
+  gfree(sections);
+  sections = NULL;
+  nSections = sectionsSize = 0;
+  if (tableStr) {
+    delete tableStr;
+    tableStr = NULL;
+  }
+}
+
+//------------------------------------------------------------------------
+// xref reconstruction
+//------------------------------------------------------------------------
+
+// The file is scanned in chunks of this size, in parallel, when
+// reconstructing the xref table of a damaged file.
+#define xrefScanChunkSize (8 * 1024 * 1024)
+
+// Size of the blocks read by the scan.
+#define xrefScanBufSize (256 * 1024)
+
+struct XRefScanObject {
+  int num;
+  int gen;
   Guint pos;
-  int num, gen;
-  int newSize;
-  int streamEndsSize;
-  char *p;
-  GBool gotRoot;
-  char* token = NULL;
-  bool oneCycle = true;
-  int offset = 0;
+};
 
-  gfree(entries);
-  capacity = 0;
-  size = 0;
-  entries = NULL;
+// What the reconstruction scan found in one chunk of the file.  A
+// chunk covers the lines that start between <start> and <end>, where
+// a line can only start after the end of line that follows each of
+// these positions (except at the beginning of the file): getLine()
+// always consumes '\n', so the next line starts right after it,
+// whatever came before.
+struct XRefScanChunk {
+  BaseStream *str;
+  Guint start, end;
+  GBool first, last;		// first and last chunks of the file
+  std::vector<XRefScanObject> objs;
+  std::vector<Guint> streamEnds;
+  std::vector<Guint> trailers;	// positions of trailer dictionaries
+};
 
-  gotRoot = gFalse;
-  streamEndsLen = streamEndsSize = 0;
+// Reads a chunk with large block reads.
+class XRefScanReader {
+public:
 
-  if (wasReconstructed)
-  {
-    *wasReconstructed = true;
+  XRefScanReader(BaseStream *str, Guint startA) {
+    Object obj;
+
+    obj.initNull();
+    s = str->makeSubStream(startA, gFalse, 0, &obj);
+    s->reset();
+    buf = (char *)gmalloc(xrefScanBufSize);
+    ptr = end = buf;
+    bufPos = startA;
   }
 
-  str->reset();
-  while (1) {
-    pos = str->getPos();
-    if (!str->getLine(buf, 256)) {
-      break;
-    }
-    p = buf;
+  ~XRefScanReader() {
+    gfree(buf);
+    delete s;
+  }
 
-    // skip whitespace
-    while (*p && Lexer::isSpace(*p & 0xff)) ++p;
+  int getChar()
+    { return (ptr < end || fill()) ? (*ptr++ & 0xff) : EOF; }
+  int lookChar()
+    { return (ptr < end || fill()) ? (*ptr & 0xff) : EOF; }
+  Guint getPos() { return bufPos + (Guint)(ptr - buf); }
 
-    oneCycle = true;
-    offset = 0;
+private:
 
-    while( ( token = strstr( p, "endobj" ) ) || oneCycle ) {
-      oneCycle = false;
+  GBool fill() {
+    bufPos += (Guint)(end - buf);
+    ptr = buf;
+    end = buf + s->doGetChars(xrefScanBufSize, (Guchar *)buf);
+    return ptr < end;
+  }
 
-      if( token ) {
-        oneCycle = true;
-        token[0] = '\0'; 
-        offset = token - p;
-      }
+  Stream *s;
+  char *buf, *ptr, *end;
+  Guint bufPos;			// position of buf[0]
+};
 
-      // got trailer dictionary
-      if (!strncmp(p, "trailer", 7)) {
-        obj.initNull();
-        parser = new Parser(NULL,
-		 new Lexer(NULL,
-		   str->makeSubStream(pos + 7, gFalse, 0, &obj)),
-		 gFalse);
-        parser->getObj(&newTrailerDict);
-        if (newTrailerDict.isDict()) {
-	  newTrailerDict.dictLookupNF("Root", &obj);
-	  if (obj.isRef()) {
-	    rootNum = obj.getRefNum();
-	    rootGen = obj.getRefGen();
-	    if (!trailerDict.isNone()) {
-	      trailerDict.free();
-	    }
-	    newTrailerDict.copy(&trailerDict);
-	    gotRoot = gTrue;
-	  }
-	  obj.free();
-        }
-        newTrailerDict.free();
-        delete parser;
+// Look for objects, 'trailer' and 'endstream' in one line (of up to
+// 255 characters) starting at <pos>.
+static void scanXRefLine(char *buf, Guint pos, XRefScanChunk *chunk) {
+  XRefScanObject obj;
+  char *p;
+  char* token = NULL;
+  bool oneCycle = true;
+  int offset = 0;
+  int num, gen;
+
+  p = buf;
+
+  // skip whitespace
+  while (*p && Lexer::isSpace(*p & 0xff)) ++p;
+
+  while( ( token = strstr( p, "endobj" ) ) || oneCycle ) {
+    oneCycle = false;
 
-      // look for object
+    if( token ) {
+      oneCycle = true;
+      token[0] = '\0';
+      offset = token - p;
+    }
+
+    // got trailer dictionary
+    if (!strncmp(p, "trailer", 7)) {
+      chunk->trailers.push_back(pos + 7);
+
+    // look for object
     } else if (isdigit(*p & 0xff)) {
       num = atoi(p);
       if (num > 0) {
@@ -865,51 +2006,238 @@ GBool XRef::constructXRef(GBool *wasReconstructed) {
 		++p;
 	      } while (*p && isspace(*p & 0xff));
 	      if (!strncmp(p, "obj", 3)) {
-		if (num >= size) {
-		  newSize = (num + 1 + 255) & ~255;
-		  if (newSize < 0) {
-		    error(errSyntaxError, -1, "Bad object number");
-		    return gFalse;
-		  }
-		    if (resize(newSize) != newSize) {
-		      error(errSyntaxError, -1, "Invalid 'obj' parameters");
-		      return gFalse;
-		    }
-		  }
-		  if (entries[num].type == xrefEntryFree ||
-		      gen >= entries[num].gen) {
-		    entries[num].offset = pos - start;
-		    entries[num].gen = gen;
-		    entries[num].type = xrefEntryUncompressed;
-		}
-	        }
+		obj.num = num;
+		obj.gen = gen;
+		obj.pos = pos;
+		chunk->objs.push_back(obj);
 	      }
 	    }
 	  }
-        }
+	}
+      }
 
-      } else if (!strncmp(p, "endstream", 9)) {
-        if (streamEndsLen == streamEndsSize) {
-	  streamEndsSize += 64;
-          if (streamEndsSize >= INT_MAX / (int)sizeof(int)) {
-            error(errSyntaxError, -1, "Invalid 'endstream' parameter.");
-            return gFalse;
-          }
-	  streamEnds = (Guint *)greallocn(streamEnds,
-					streamEndsSize, sizeof(Guint));
-        }
-        streamEnds[streamEndsLen++] = pos;
+    } else if (!strncmp(p, "endstream", 9)) {
+      chunk->streamEnds.push_back(pos);
+    }
+    if( token ) {
+      p = token + 6;// strlen( "endobj" ) = 6
+      pos += offset + 6;// strlen( "endobj" ) = 6
+      while (*p && Lexer::isSpace(*p & 0xff)) {
+	++p;
+	++pos;
       }
-      if( token ) {
-        p = token + 6;// strlen( "endobj" ) = 6
-        pos += offset + 6;// strlen( "endobj" ) = 6
-        while (*p && Lexer::isSpace(*p & 0xff)) {
-          ++p;
-          ++pos;
-        }
+    }
+  }
+}
+
+// Scan one chunk, splitting it into lines like Stream::getLine does.
+static void scanXRefChunk(XRefScanChunk *chunk) {
+  XRefScanReader reader(chunk->str, chunk->start);
+  char buf[256];
+  Guint pos;
+  GBool done;
+  int c, i;
+
+  // skip the end of the line that started in the previous chunk
+  if (!chunk->first) {
+    while ((c = reader.getChar()) != EOF && c != '\n') ;
+  }
+
+  done = gFalse;
+  while (!done && reader.lookChar() != EOF) {
+    pos = reader.getPos();
+    for (i = 0; i < 255; ++i) {
+      c = reader.getChar();
+      if (c == EOF || c == '\n') {
+	break;
+      }
+      if (c == '\r') {
+	if ((c = reader.lookChar()) == '\n') {
+	  reader.getChar();
+	}
+	break;
+      }
+      buf[i] = c;
+    }
+    buf[i] = '\0';
+    // the line that ends with the first '\n' at or after <end> is the
+    // last one of the chunk
+    if (c == '\n' && !chunk->last && reader.getPos() > chunk->end) {
+      done = gTrue;
+    }
+    scanXRefLine(buf, pos, chunk);
+  }
+}
+
+#if MULTITHREADED
+struct XRefScanJob {
+  XRefScanChunk *chunks;
+  int nChunks;
+  int nextChunk;		// next chunk to scan
+  GooMutex mutex;
+};
+
+static GooThreadResult GOO_THREAD_CALL scanXRefChunks(void *data) {
+  XRefScanJob *job = (XRefScanJob *)data;
+  int i;
+
+  while (1) {
+    gLockMutex(&job->mutex);
+    i = job->nextChunk++;
+    gUnlockMutex(&job->mutex);
+    if (i >= job->nChunks) {
+      break;
+    }
+    scanXRefChunk(&job->chunks[i]);
+  }
+  return 0;
+}
+#endif
+
+// Attempt to construct an xref table for a damaged file.  The file is
+// scanned in chunks, in parallel if the base stream can be read
+// concurrently, and the results are merged in file order, so that the
+// table is the same as with a sequential scan.
+GBool XRef::constructXRef(GBool *wasReconstructed) {
+  XRefScanChunk *chunks;
+  Parser *parser;
+  Object newTrailerDict, obj;
+  Guint length;
+  int nChunks, nStreamEnds, num, gen, newSize, i;
+  size_t j;
+  GBool gotRoot;
+
+  gfree(entries);
+  capacity = 0;
+  size = 0;
+  entries = NULL;
+
+  gotRoot = gFalse;
+  streamEndsLen = 0;
+
+  if (wasReconstructed)
+  {
+    *wasReconstructed = true;
+  }
+
+  // split the file into chunks
+  length = str->getLength();
+  nChunks = length / xrefScanChunkSize + 1;
+  chunks = new XRefScanChunk[nChunks];
+  for (i = 0; i < nChunks; ++i) {
+    chunks[i].str = str;
+    chunks[i].start = str->getStart() + i * xrefScanChunkSize;
+    chunks[i].end = chunks[i].start + xrefScanChunkSize;
+    chunks[i].first = i == 0;
+    chunks[i].last = i == nChunks - 1;
+  }
+
+  // scan them
+#if MULTITHREADED
+  XRefScanJob job;
+  GooThread *threads;
+  int nThreads;
+
+  job.chunks = chunks;
+  job.nChunks = nChunks;
+  job.nextChunk = 0;
+  gInitMutex(&job.mutex);
+  // streams whose substreams share a read position (e.g., a GInputStream
+  // from the glib frontend) are scanned serially
+  nThreads = str->canReadConcurrently() ? gGetNumProcessors() : 1;
+  if (nThreads > nChunks) {
+    nThreads = nChunks;
+  }
+  threads = new GooThread[nThreads];
+  for (i = 1; i < nThreads; ++i) {
+    if (!gCreateThread(&threads[i], &scanXRefChunks, &job)) {
+      break;
+    }
+  }
+  nThreads = i;
+  scanXRefChunks(&job);
+  for (i = 1; i < nThreads; ++i) {
+    gJoinThread(threads[i]);
+  }
+  delete[] threads;
+  gDestroyMutex(&job.mutex);
+#else
+  for (i = 0; i < nChunks; ++i) {
+    scanXRefChunk(&chunks[i]);
+  }
+#endif
+
+  // merge the objects in file order: later ones win
+  nStreamEnds = 0;
+  for (i = 0; i < nChunks; ++i) {
+    for (j = 0; j < chunks[i].objs.size(); ++j) {
+      num = chunks[i].objs[j].num;
+      gen = chunks[i].objs[j].gen;
+      if (num >= size) {
+	newSize = (num + 1 + 255) & ~255;
+	if (newSize < 0) {
+	  error(errSyntaxError, -1, "Bad object number");
+	  delete[] chunks;
+	  return gFalse;
+	}
+	if (resize(newSize) != newSize) {
+	  error(errSyntaxError, -1, "Invalid 'obj' parameters");
+	  delete[] chunks;
+	  return gFalse;
+	}
+      }
+      if (entries[num].type == xrefEntryFree ||
+	  gen >= entries[num].gen) {
+	entries[num].offset = chunks[i].objs[j].pos - start;
+	entries[num].gen = gen;
+	entries[num].type = xrefEntryUncompressed;
+      }
+    }
+    nStreamEnds += (int)chunks[i].streamEnds.size();
+    if (nStreamEnds < 0 || nStreamEnds >= INT_MAX / (int)sizeof(int)) {
+      error(errSyntaxError, -1, "Invalid 'endstream' parameter.");
+      delete[] chunks;
+      return gFalse;
+    }
+  }
+
+  // 'endstream' positions, in file order
+  gfree(streamEnds);
+  streamEnds = (Guint *)gmallocn(nStreamEnds, sizeof(Guint));
+  for (i = 0; i < nChunks; ++i) {
+    for (j = 0; j < chunks[i].streamEnds.size(); ++j) {
+      streamEnds[streamEndsLen++] = chunks[i].streamEnds[j];
+    }
+  }
+
+  // use the last trailer dictionary with a catalog
+  for (i = nChunks - 1; i >= 0 && !gotRoot; --i) {
+    for (j = chunks[i].trailers.size(); j > 0 && !gotRoot; --j) {
+      obj.initNull();
+      parser = new Parser(NULL,
+		 new Lexer(NULL,
+		   str->makeSubStream(chunks[i].trailers[j - 1], gFalse, 0,
+				      &obj)),
+		 gFalse);
+      parser->getObj(&newTrailerDict);
+      if (newTrailerDict.isDict()) {
+	newTrailerDict.dictLookupNF("Root", &obj);
+	if (obj.isRef()) {
+	  rootNum = obj.getRefNum();
+	  rootGen = obj.getRefGen();
+	  if (!trailerDict.isNone()) {
+	    trailerDict.free();
+	  }
+	  newTrailerDict.copy(&trailerDict);
+	  gotRoot = gTrue;
+	}
+	obj.free();
       }
+      newTrailerDict.free();
+      delete parser;
     }
   }
+  delete[] chunks;
 
   if (gotRoot)
     return gTrue;
@@ -938,6 +2266,39 @@ void XRef::setEncryption(int permFlagsA, GBool ownerPasswordOkA,
   encVersion = encVersionA;
   encRevision = encRevisionA;
   encAlgorithm = encAlgorithmA;
+  gfree(objKeys);
+  objKeys = NULL;
+
+  // objects fetched so far were not decrypted
+  if (objCache) {
+    objCache->clear();
+  }
+  imageCache->clear();
+  jbig2GlobalsCache->clear();
+  formCache->clear();
+}
+
+int XRef::getObjectKey(int num, int gen, Guchar *objKey) {
+  XRefObjectKey *k;
+  int i;
+
+  xrefLocker();
+  if (!objKeys) {
+    objKeys = (XRefObjectKey *)gmallocn(objKeyCacheSize,
+					sizeof(XRefObjectKey));
+    for (i = 0; i < objKeyCacheSize; ++i) {
+      objKeys[i].num = -1;
+    }
+  }
+  k = &objKeys[num & (objKeyCacheSize - 1)];
+  if (k->num != num || k->gen != gen) {
+    k->length = Decrypt::makeObjectKey(encAlgorithm, fileKey, keyLength,
+				       num, gen, k->key);
+    k->num = num;
+    k->gen = gen;
+  }
+  memcpy(objKey, k->key, k->length);
+  return k->length;
 }
 
 GBool XRef::okToPrint(GBool ignoreOwnerPW) {
@@ -990,118 +2351,169 @@ Object *XRef::fetch(int num, int gen, Object *obj, int recursion) {
   XRefEntry *e;
   Parser *parser;
   Object obj1, obj2, obj3;
+  Guint offset;
 
-  // check for bogus ref - this can happen in corrupted PDF files
-  if (num < 0 || num >= size) {
-    goto err;
-  }
+  // look up the entry and deal with updated and compressed objects
+  // while holding the lock; uncompressed objects are parsed after
+  // releasing it
+  {
+    xrefLocker();
 
-  e = getEntry(num);
-  if(!e->obj.isNull ()) { //check for updated object
-    obj = e->obj.copy(obj);
-    return obj;
-  }
+    // check for bogus ref - this can happen in corrupted PDF files
+    if (num < 0 || num >= size) {
+      return obj->initNull();
+    }
 
-  switch (e->type) {
+    e = getEntry(num);
+    if(!e->obj.isNull ()) { //check for updated object
+      obj = e->obj.copy(obj);
+      return obj;
+    }
 
-  case xrefEntryUncompressed:
-    if (e->gen != gen) {
-      goto err;
+    if (objCache) {
+      if (objCache->lookup(num, gen, obj)) {
+	++objCacheHits;
+	return obj;
+      }
+      ++objCacheMisses;
     }
-    obj1.initNull();
-    parser = new Parser(this,
-	       new Lexer(this,
-		 str->makeSubStream(start + e->offset, gFalse, 0, &obj1)),
-	       gTrue);
-    parser->getObj(&obj1, recursion);
-    parser->getObj(&obj2, recursion);
-    parser->getObj(&obj3, recursion);
-    if (!obj1.isInt() || obj1.getInt() != num ||
-	!obj2.isInt() || obj2.getInt() != gen ||
-	!obj3.isCmd("obj")) {
-      // some buggy pdf have obj1234 for ints that represent 1234
-      // try to recover here
-      if (obj1.isInt() && obj1.getInt() == num &&
-	  obj2.isInt() && obj2.getInt() == gen &&
-	  obj3.isCmd()) {
-	char *cmd = obj3.getCmd();
-	if (strlen(cmd) > 3 &&
-	    cmd[0] == 'o' &&
-	    cmd[1] == 'b' &&
-	    cmd[2] == 'j') {
-	  char *end_ptr;
-	  long longNumber = strtol(cmd + 3, &end_ptr, 0);
-	  if (longNumber <= INT_MAX && longNumber >= INT_MIN && *end_ptr == '\0') {
-	    int number = longNumber;
-	    error(errSyntaxWarning, -1, "Cmd was not obj but {0:s}, assuming the creator meant obj {1:d}", cmd, number);
-	    obj->initInt(number);
-	    obj1.free();
-	    obj2.free();
-	    obj3.free();
-	    delete parser;
-	    break;
-	  }
+
+    if (e->type == xrefEntryCompressed) {
+      fetchCompressed(e, num, obj);
+      if (objCache && (obj->isDict() || obj->isArray())) {
+	objCache->put(num, gen, obj);
+      }
+      return obj;
+    }
+
+    if (e->type != xrefEntryUncompressed || e->gen != gen) {
+      return obj->initNull();
+    }
+    offset = e->offset;
+  }
+
+  obj1.initNull();
+  parser = new Parser(this,
+	     new Lexer(this,
+	       str->makeSubStream(start + offset, gFalse, 0, &obj1)),
+	     gTrue);
+  parser->getObj(&obj1, recursion);
+  parser->getObj(&obj2, recursion);
+  parser->getObj(&obj3, recursion);
+  if (!obj1.isInt() || obj1.getInt() != num ||
+      !obj2.isInt() || obj2.getInt() != gen ||
+      !obj3.isCmd("obj")) {
+    // some buggy pdf have obj1234 for ints that represent 1234
+    // try to recover here
+    if (obj1.isInt() && obj1.getInt() == num &&
+	obj2.isInt() && obj2.getInt() == gen &&
+	obj3.isCmd()) {
+      char *cmd = obj3.getCmd();
+      if (strlen(cmd) > 3 &&
+	  cmd[0] == 'o' &&
+	  cmd[1] == 'b' &&
+	  cmd[2] == 'j') {
+	char *end_ptr;
+	long longNumber = strtol(cmd + 3, &end_ptr, 0);
+	if (longNumber <= INT_MAX && longNumber >= INT_MIN && *end_ptr == '\0') {
+	  int number = longNumber;
+	  error(errSyntaxWarning, -1, "Cmd was not obj but {0:s}, assuming the creator meant obj {1:d}", cmd, number);
+	  obj->initInt(number);
+	  obj1.free();
+	  obj2.free();
+	  obj3.free();
+	  delete parser;
+	  return obj;
 	}
       }
-      obj1.free();
-      obj2.free();
-      obj3.free();
-      delete parser;
-      goto err;
     }
-    parser->getObj(obj, gFalse, encrypted ? fileKey : (Guchar *)NULL,
-		   encAlgorithm, keyLength, num, gen, recursion);
     obj1.free();
     obj2.free();
     obj3.free();
     delete parser;
-    break;
+    return obj->initNull();
+  }
+  parser->getObj(obj, gFalse, encrypted ? fileKey : (Guchar *)NULL,
+		 encAlgorithm, keyLength, num, gen, recursion);
+  obj1.free();
+  obj2.free();
+  obj3.free();
+  delete parser;
 
-  case xrefEntryCompressed:
-  {
-#if 0 // Adobe apparently ignores the generation number on compressed objects
-    if (gen != 0) {
-      goto err;
-    }
-#endif
-    if (e->offset >= (Guint)size ||
-	entries[e->offset].type != xrefEntryUncompressed) {
-      error(errSyntaxError, -1, "Invalid object stream");
-      goto err;
-    }
-
-    ObjectStream *objStr = NULL;
-    ObjectStreamKey key(e->offset);
-    PopplerCacheItem *item = objStrs->lookup(key);
-    if (item) {
-      ObjectStreamItem *it = static_cast<ObjectStreamItem *>(item);
-      objStr = it->objStream;
-    }
-
-    if (!objStr) {
-      objStr = new ObjectStream(this, e->offset);
-      if (!objStr->isOk()) {
-	delete objStr;
-	objStr = NULL;
-	goto err;
-      } else {
-	ObjectStreamKey *newkey = new ObjectStreamKey(e->offset);
-	ObjectStreamItem *newitem = new ObjectStreamItem(objStr);
-	objStrs->put(newkey, newitem);
+  // the entry may have been modified while the lock was released
+  if (obj->isDict() || obj->isArray()) {
+    xrefLocker();
+    if (objCache) {
+      e = getEntry(num);
+      if (e->obj.isNull() && e->type == xrefEntryUncompressed &&
+	  e->offset == offset && e->gen == gen) {
+	objCache->put(num, gen, obj);
       }
     }
-    objStr->getObject(e->gen, num, obj);
   }
-  break;
+  return obj;
+}
+
+void XRef::setObjectCacheSize(Guint maxBytes) {
+  xrefLocker();
+  if (maxBytes == 0) {
+    if (objCache) {
+      delete objCache;
+      objCache = NULL;
+    }
+  } else if (objCache) {
+    objCache->setMaxBytes(maxBytes);
+  } else {
+    objCache = new XRefObjectCache(maxBytes);
+  }
+}
 
-  default:
-    goto err;
+void XRef::setObjectStreamCacheSize(Guint maxBytes) {
+  xrefLocker();
+  objStrs->setMaxBytes(maxBytes);
+}
+
+void XRef::getObjectCacheStats(Guint *hits, Guint *misses, Guint *bytes) {
+  xrefLocker();
+  *hits = objCacheHits;
+  *misses = objCacheMisses;
+  *bytes = objCache ? objCache->getBytes() : 0;
+}
+
+// Fetch an object from an object stream.  The caller must hold the
+// lock: the object stream cache is shared.
+Object *XRef::fetchCompressed(XRefEntry *e, int num, Object *obj) {
+#if 0 // Adobe apparently ignores the generation number on compressed objects
+  if (gen != 0) {
+    return obj->initNull();
+  }
+#endif
+  // e may point into entries, which can be reallocated while the
+  // object stream is being loaded
+  Guint objStrNum = e->offset;
+  int objIdx = e->gen;
+
+  // the entry of the object stream may be in an older xref section
+  // than the one of the object
+  if (objStrNum >= (Guint)size ||
+      getEntry(objStrNum)->type != xrefEntryUncompressed) {
+    error(errSyntaxError, -1, "Invalid object stream");
+    return obj->initNull();
   }
-  
-  return obj;
 
- err:
-  return obj->initNull();
+  ObjectStream *objStr = objStrs->lookup(objStrNum);
+  if (!objStr) {
+    objStr = new ObjectStream(this, objStrNum);
+    if (!objStr->isOk()) {
+      delete objStr;
+      return obj->initNull();
+    }
+    objStrs->put(objStr);
+  }
+  objStr->getObject(objIdx, num, obj);
+  // the object may just have been parsed
+  objStrs->update();
+  return obj;
 }
 
 Object *XRef::getDocInfo(Object *obj) {
@@ -1116,6 +2528,7 @@ Object *XRef::getDocInfoNF(Object *obj) {
 GBool XRef::getStreamEnd(Guint streamStart, Guint *streamEnd) {
   int a, b, m;
 
+  xrefLocker();
   if (streamEndsLen == 0 ||
       streamStart > streamEnds[streamEndsLen - 1]) {
     return gFalse;
@@ -1158,6 +2571,7 @@ int XRef::getNumEntry(Guint offset)
 }
 
 void XRef::add(int num, int gen, Guint offs, GBool used) {
+  xrefLocker();
   if (num >= size) {
     if (num >= capacity) {
       entries = (XRefEntry *)greallocn(entries, num + 1, sizeof(XRefEntry));
@@ -1173,6 +2587,12 @@ void XRef::add(int num, int gen, Guint offs, GBool used) {
     size = num + 1;
   }
   XRefEntry *e = getEntry(num);
+  if (objCache) {
+    objCache->remove(num);
+  }
+  imageCache->remove(num);
+  jbig2GlobalsCache->remove(num);
+  formCache->remove(num);
   e->gen = gen;
   e->obj.initNull ();
   e->updated = false;
@@ -1186,17 +2606,25 @@ void XRef::add(int num, int gen, Guint offs, GBool used) {
 }
 
 void XRef::setModifiedObject (Object* o, Ref r) {
+  xrefLocker();
   if (r.num < 0 || r.num >= size) {
     error(errInternal, -1,"XRef::setModifiedObject on unknown ref: {0:d}, {1:d}\n", r.num, r.gen);
     return;
   }
   XRefEntry *e = getEntry(r.num);
+  if (objCache) {
+    objCache->remove(r.num);
+  }
+  imageCache->remove(r.num);
+  jbig2GlobalsCache->remove(r.num);
+  formCache->remove(r.num);
   e->obj.free();
   o->copy(&(e->obj));
   e->updated = true;
 }
 
 Ref XRef::addIndirectObject (Object* o) {
+  xrefLocker();
   int entryIndexToUse = -1;
   for (int i = 1; entryIndexToUse == -1 && i < size; ++i) {
     XRefEntry *e = getEntry(i, false /* complainIfMissing */);
@@ -1227,6 +2655,7 @@ Ref XRef::addIndirectObject (Object* o) {
 }
 
 void XRef::removeIndirectObject(Ref r) {
+  xrefLocker();
   if (r.num < 0 || r.num >= size) {
     error(errInternal, -1,"XRef::removeIndirectObject on unknown ref: {0:d}, {1:d}\n", r.num, r.gen);
     return;
@@ -1234,6 +2663,12 @@ void XRef::removeIndirectObject(Ref r) {
   XRefEntry *e = getEntry(r.num);
   if (e->type == xrefEntryFree)
     return;
+  if (objCache) {
+    objCache->remove(r.num);
+  }
+  imageCache->remove(r.num);
+  jbig2GlobalsCache->remove(r.num);
+  formCache->remove(r.num);
   e->obj.free();
   e->type = xrefEntryFree;
   e->gen++;
@@ -1373,6 +2808,8 @@ GBool XRef::parseEntry(Guint offset, XRefEntry *entry)
 
 XRefEntry *XRef::getEntry(int i, GBool complainIfMissing)
 {
+  xrefLocker();
+
   if (entries[i].type == xrefEntryNone) {
 
     if ((!xRefStream) && mainXRefEntriesOffset) {
@@ -1380,39 +2817,22 @@ XRefEntry *XRef::getEntry(int i, GBool complainIfMissing)
         error(errSyntaxError, -1, "Failed to parse XRef entry [{0:d}].", i);
       }
     } else {
-      std::vector<Guint> followedPrev;
-      while (prevXRefOffset && entries[i].type == xrefEntryNone) {
-        bool followed = false;
-        for (size_t j = 0; j < followedPrev.size(); j++) {
-          if (followedPrev.at(j) == prevXRefOffset) {
-            followed = true;
-            break;
-          }
+      // look the entry up in the older sections, which are indexed
+      // the first time an entry is missing from the newest one
+      if (prevXRefOffset) {
+        if (!sections) {
+          indexXRefSections();
         }
-        if (followed) {
-          error(errSyntaxError, -1, "Circular XRef");
-          if (!(ok = constructXRef(NULL))) {
+
+        // if there was a problem with the xref table, or if none of
+        // its sections has the entry, try to reconstruct it
+        if (!ok || lookupXRefSections(i, &entries[i]) <= 0) {
+          freeXRefSections();
+          prevXRefOffset = 0;
+          GBool wasReconstructed = false;
+          if (!(ok = constructXRef(&wasReconstructed))) {
             errCode = errDamaged;
           }
-          break;
-        }
-
-        followedPrev.push_back (prevXRefOffset);
-
-        std::vector<Guint> followedXRefStm;
-        if (!readXRef(&prevXRefOffset, &followedXRefStm)) {
-            prevXRefOffset = 0;
-        }
-
-        // if there was a problem with the xref table,
-        // try to reconstruct it
-        if (!ok || (!prevXRefOffset && entries[i].type == xrefEntryNone)) {
-           GBool wasReconstructed = false;
-           if (!(ok = constructXRef(&wasReconstructed))) {
-               errCode = errDamaged;
-               break;
-           }
-           break;
         }
       }
       
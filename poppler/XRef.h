@@ -34,15 +34,26 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
 #include "goo/gtypes.h"
 #include "Object.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 #include <vector>
 
 class Dict;
 class Stream;
 class Parser;
-class PopplerCache;
+class ObjectStreamCache;
+class XRefObjectCache;
+class ImageCache;
+class GfxFormCache;
+class JBIG2GlobalsCache;
+struct XRefSection;
+struct XRefObjectKey;
 
 //------------------------------------------------------------------------
 // XRef
@@ -94,6 +105,17 @@ public:
   // Is the file encrypted?
   GBool isEncrypted() { return encrypted; }
 
+  // Get the encryption parameters.
+  void getEncryptionParameters(Guchar **fileKeyA, CryptAlgorithm *encAlgorithmA,
+			       int *keyLengthA)
+    { *fileKeyA = fileKey; *encAlgorithmA = encAlgorithm;
+      *keyLengthA = keyLength; }
+
+  // Set <objKey> (which must have space for 32 bytes) to the
+  // decryption key of object <num>, <gen>, and return its length.
+  // The keys of recently used objects are cached.
+  int getObjectKey(int num, int gen, Guchar *objKey);
+
   // Check various permissions.
   GBool okToPrint(GBool ignoreOwnerPW = gFalse);
   GBool okToPrintHighRes(GBool ignoreOwnerPW = gFalse);
@@ -108,9 +130,41 @@ public:
   // Get catalog object.
   Object *getCatalog(Object *obj) { return fetch(rootNum, rootGen, obj); }
 
-  // Fetch an indirect reference.
+  // Fetch an indirect reference.  This can be called concurrently
+  // from several threads: the xref entries and the object stream
+  // cache are protected by a lock, and objects are parsed from a
+  // private sub stream of the file.
   Object *fetch(int num, int gen, Object *obj, int recursion = 0);
 
+  // Keep up to <maxBytes> (estimated) of dictionaries and arrays
+  // returned by fetch() so that they are not parsed again; zero
+  // disables the cache.  Cached objects are shared with every caller
+  // that fetches them, so they must not be modified in place without
+  // calling setModifiedObject().
+  void setObjectCacheSize(Guint maxBytes);
+
+  // Keep up to <maxBytes> (estimated) of decoded object streams, and
+  // of the objects parsed from them (4 MB by default).  The most
+  // recently used object stream is kept even if it is larger.
+  void setObjectStreamCacheSize(Guint maxBytes);
+
+  // Return the number of cache hits and misses in fetch(), and the
+  // estimated memory currently held by the cache.
+  void getObjectCacheStats(Guint *hits, Guint *misses, Guint *bytes);
+
+  // Return the document's cache of decoded image data, which output
+  // devices can read images from.  Its initial size is set by
+  // GlobalParams::setImageCacheSize().
+  ImageCache *getImageCache() { return imageCache; }
+
+  // Return the document's cache of decoded JBIG2 globals streams.  Its
+  // initial size is set by GlobalParams::setJBIG2GlobalsCacheSize().
+  JBIG2GlobalsCache *getJBIG2GlobalsCache() { return jbig2GlobalsCache; }
+
+  // Return the document's cache of tokenized Form XObject content.  Its
+  // initial size is set by GlobalParams::setFormContentCacheSize().
+  GfxFormCache *getFormCache() { return formCache; }
+
   // Return the document's Info dictionary (if any).
   Object *getDocInfo(Object *obj);
   Object *getDocInfoNF(Object *obj);
@@ -159,7 +213,13 @@ private:
   Guint *streamEnds;		// 'endstream' positions - only used in
 				//   damaged files
   int streamEndsLen;		// number of valid entries in streamEnds
-  PopplerCache *objStrs;	// cached object streams
+  ObjectStreamCache *objStrs;	// cached object streams
+  XRefObjectCache *objCache;	// cached parsed objects (may be NULL)
+  Guint objCacheHits;		// number of fetches served by objCache
+  Guint objCacheMisses;		// number of fetches not in objCache
+  ImageCache *imageCache;	// cached decoded images
+  JBIG2GlobalsCache *jbig2GlobalsCache; // cached decoded JBIG2 globals
+  GfxFormCache *formCache;	// cached tokenized forms
   GBool encrypted;		// true if file is encrypted
   int encRevision;		
   int encVersion;		// encryption algorithm
@@ -167,10 +227,22 @@ private:
   int keyLength;		// length of key, in bytes
   int permFlags;		// permission bits
   Guchar fileKey[32];		// file decryption key
+  XRefObjectKey *objKeys;	// cached object keys (allocated on
+				//   first use)
   GBool ownerPasswordOk;	// true if owner password is correct
   Guint prevXRefOffset;		// position of prev XRef section (= next to read)
+  XRefSection *sections;	// sections from prevXRefOffset on, newest
+				//   first, indexed on the first miss in
+				//   getEntry
+  int nSections;		// number of sections
+  int sectionsSize;		// size of <sections> array
+  Stream *tableStr;		// stream used to read their table entries
+  Guint tableStrPos;		// position of <tableStr>
   Guint mainXRefEntriesOffset;	// offset of entries in main XRef table
   GBool xRefStream;		// true if last XRef section is a stream
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
 
   void init();
   int reserve(int newSize);
@@ -180,8 +252,16 @@ private:
   GBool readXRefTable(Parser *parser, Guint *pos, std::vector<Guint> *followedXRefStm);
   GBool readXRefStreamSection(Stream *xrefStr, int *w, int first, int n);
   GBool readXRefStream(Stream *xrefStr, Guint *pos);
+  GBool indexXRefSections();
+  GBool indexXRef(Guint *pos, std::vector<Guint> *followedXRefStm);
+  GBool indexXRefTable(Stream *s, int iSection, Guint *trailerPos);
+  GBool indexXRefStream(Object *xrefStr, int iSection, Guint *pos);
+  int lookupXRefSections(int num, XRefEntry *entry);
+  int addXRefSection();
+  void freeXRefSections();
   GBool constructXRef(GBool *wasReconstructed);
   GBool parseEntry(Guint offset, XRefEntry *entry);
+  Object *fetchCompressed(XRefEntry *e, int num, Object *obj);
 
   class XRefWriter {
   public:
@@ -74,7 +74,7 @@
 #cmakedefine ENABLE_LIBPNG 1
 #endif
 
-/* Use zlib instead of builtin zlib decoder. */
+/* Build the zlib based Flate decoder. */
 #ifndef ENABLE_ZLIB
 #cmakedefine ENABLE_ZLIB 1
 #endif
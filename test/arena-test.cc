@@ -0,0 +1,198 @@
+//========================================================================
+//
+// arena-test.cc
+//
+// Checks that interpreting a content stream does not hold on to the
+// operand arena across a run of operands with no operator: a page
+// made of a long sequence of "/Name (string)" pairs is drawn, and the
+// heap must not grow with the length of its content stream.  Returns
+// non-zero on failure.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "Error.h"
+#include "Object.h"
+#include "Stream.h"
+#include "PDFDoc.h"
+#include "OutputDev.h"
+
+#ifdef __GLIBC__
+
+#include <malloc.h>
+
+//------------------------------------------------------------------------
+// heap usage tracking
+//------------------------------------------------------------------------
+
+static size_t liveBytes = 0;
+static size_t peakBytes = 0;
+
+// track the bytes held by the process, including the ones allocated
+// by operator new, by interposing the glibc allocator entry points
+
+extern "C" {
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void __libc_free(void *p);
+
+static void *track(void *p) {
+  if (p) {
+    liveBytes += malloc_usable_size(p);
+    if (liveBytes > peakBytes) {
+      peakBytes = liveBytes;
+    }
+  }
+  return p;
+}
+
+void *malloc(size_t size) {
+  return track(__libc_malloc(size));
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  return track(__libc_calloc(nmemb, size));
+}
+
+void *realloc(void *p, size_t size) {
+  size_t oldSize;
+  void *q;
+
+  oldSize = p ? malloc_usable_size(p) : 0;
+  q = __libc_realloc(p, size);
+  if (q || !size) {
+    liveBytes -= oldSize;
+  }
+  return track(q);
+}
+
+void free(void *p) {
+  if (p) {
+    liveBytes -= malloc_usable_size(p);
+  }
+  __libc_free(p);
+}
+
+}
+
+//------------------------------------------------------------------------
+
+// output device that draws nothing
+class NullOutputDev: public OutputDev {
+public:
+
+  virtual GBool upsideDown() { return gTrue; }
+  virtual GBool useDrawChar() { return gFalse; }
+  virtual GBool interpretType3Chars() { return gFalse; }
+};
+
+// Build a one-page document whose content stream is <nPairs> name and
+// string operands, with no operator.
+static GooString *makeDoc(int nPairs, int *contentLength) {
+  GooString *pdf, *contents;
+  int offsets[5];
+  int i;
+
+  contents = new GooString();
+  for (i = 0; i < nPairs; ++i) {
+    contents->appendf("/Operand{0:d} (string {0:d}) ", i);
+  }
+  *contentLength = contents->getLength();
+
+  pdf = new GooString("%PDF-1.4\n");
+  offsets[1] = pdf->getLength();
+  pdf->append("1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+  offsets[2] = pdf->getLength();
+  pdf->append("2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\n"
+	      "endobj\n");
+  offsets[3] = pdf->getLength();
+  pdf->append("3 0 obj\n<< /Type /Page /Parent 2 0 R "
+	      "/MediaBox [0 0 10 10] /Contents 4 0 R >>\nendobj\n");
+  offsets[4] = pdf->getLength();
+  pdf->appendf("4 0 obj\n<< /Length {0:d} >>\nstream\n",
+	       contents->getLength());
+  pdf->append(contents);
+  pdf->append("\nendstream\nendobj\n");
+  delete contents;
+  i = pdf->getLength();
+  pdf->append("xref\n0 5\n0000000000 65535 f \n");
+  for (int j = 1; j < 5; ++j) {
+    pdf->appendf("{0:010d} 00000 n \n", offsets[j]);
+  }
+  pdf->appendf("trailer\n<< /Size 5 /Root 1 0 R >>\nstartxref\n{0:d}\n", i);
+  pdf->append("%EOF\n");
+  return pdf;
+}
+
+// Draw the page and return the peak heap growth while doing so.
+static long drawGrowth(int nPairs, int *contentLength) {
+  GooString *pdf;
+  PDFDoc *doc;
+  NullOutputDev *out;
+  Object obj;
+  size_t base;
+
+  pdf = makeDoc(nPairs, contentLength);
+  obj.initNull();
+  doc = new PDFDoc(new MemStream(pdf->getCString(), 0, pdf->getLength(),
+				 &obj));
+  if (!doc->isOk() || doc->getNumPages() != 1) {
+    delete doc;
+    delete pdf;
+    return -1;
+  }
+  doc->getPage(1);
+  out = new NullOutputDev();
+  base = peakBytes = liveBytes;
+  doc->displayPage(out, 1, 72, 72, 0, gFalse, gTrue, gFalse);
+  delete out;
+  delete doc;
+  delete pdf;
+  return (long)(peakBytes - base);
+}
+
+int main(int argc, char *argv[]) {
+  long growth;
+  int contentLength, nFailed;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+
+  nFailed = 0;
+  // the operands of a single operator are a few hundred bytes at most:
+  // the heap should not grow by more than a small fraction of a
+  // content stream of several megabytes
+  growth = drawGrowth(200000, &contentLength);
+  if (growth < 0) {
+    printf("FAILED: could not load the test document\n");
+    ++nFailed;
+  } else {
+    printf("%d byte content stream, heap grew by %ld bytes\n",
+	   contentLength, growth);
+    if (growth > contentLength / 16) {
+      printf("FAILED: operands with no operator are kept in memory\n");
+      ++nFailed;
+    }
+  }
+
+  delete globalParams;
+  return nFailed ? 1 : 0;
+}
+
+#else
+
+int main(int argc, char *argv[]) {
+  printf("heap tracking needs glibc, skipped\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,279 @@
+//========================================================================
+//
+// decrypt-test.cc
+//
+// Checks DecryptStream against known answers: RC4 data, and AES-128
+// and AES-256 data in CBC mode with PKCS#5 padding, encrypted with an
+// independent implementation, is decrypted a character at a time and
+// in blocks of several sizes.  Returns non-zero if any case fails.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "Object.h"
+#include "Stream.h"
+#include "Decrypt.h"
+
+//------------------------------------------------------------------------
+
+struct DecryptTestCase {
+  const char *name;
+  CryptAlgorithm algo;
+  const char *fileKey;		// hex
+  int objNum, objGen;
+  const char *plain;		// expected output
+  int plainLen;
+  const char *data;		// hex: IV (for AES) followed by the
+				//   ciphertext
+};
+
+static const char *text = "The quick brown fox jumps over the lazy dog";
+static const char *paddedText =
+  "The quick brown fox jumps over the lazy dog\x05\x05\x05\x05\x05";
+
+static const DecryptTestCase testCases[] = {
+  { "AES-128, 43 bytes", cryptAES,
+    "000102030405060708090a0b0c0d0e0f", 12, 0, text, 43,
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf5000708b01199bc376352f8475c041c7"
+    "88fb5db386c1437680b49c8836c3d8b9e026c680c485003904239aa33608c819" },
+  { "AES-128, 16 bytes", cryptAES,
+    "000102030405060708090a0b0c0d0e0f", 12, 0, text, 16,
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf5000708b01199bc376352f8475c041c7"
+    "1489371a83262616a23fd37608f43a54" },
+  { "AES-128, empty", cryptAES,
+    "000102030405060708090a0b0c0d0e0f", 12, 0, text, 0,
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf44314516c20a75d57d0a91921c845606" },
+  // a partial block after the last whole one is dropped, and the
+  // padding of the whole block is then kept
+  { "AES-128, partial last block", cryptAES,
+    "000102030405060708090a0b0c0d0e0f", 12, 0, paddedText, 48,
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf5000708b01199bc376352f8475c041c7"
+    "88fb5db386c1437680b49c8836c3d8b9e026c680c485003904239aa33608c819"
+    "010203" },
+  // a 40-bit file key still gives a 128-bit object key
+  { "AES-128, 40-bit file key, 43 bytes", cryptAES,
+    "3a7105c29e", 12, 0, text, 43,
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf81fad6f858dba1e04ddcbcfe601bbcdf"
+    "bbad1c08f9d8bc512f7108159bac0503fea34881ec0077b8df27d45c14778567" },
+  { "AES-128, 40-bit file key, 32 bytes", cryptAES,
+    "3a7105c29e", 12, 0, text, 32,
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf81fad6f858dba1e04ddcbcfe601bbcdf"
+    "bbad1c08f9d8bc512f7108159bac05039c76741d7c3ca6d702a35a908ff22b79" },
+  // FIPS-197 C.3 example vector, with a zero IV
+  { "AES-256, FIPS-197", cryptAES256,
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+    0, 0, "\x00\x11\x22\x33\x44\x55\x66\x77\x88\x99\xaa\xbb\xcc\xdd\xee\xff",
+    16,
+    "000000000000000000000000000000008ea2b7ca516745bfeafc49904b496089"
+    "56423350859cf424d4459534a8f5aaf2" },
+  { "AES-256, 43 bytes", cryptAES256,
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+    12, 0, text, 43,
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf64bac78bf92341822f9cb229d5199006"
+    "d90c3bab4f7eaa663a51e8c75086e82cabdf122926fa3b24d4f3c9bafa5236b6" },
+  { "RC4, 40-bit key", cryptRC4,
+    "3a7105c29e", 12, 0, text, 43,
+    "65a190dca532dbf80df13ec4de46f7b4daaf2e622735b384e3b21f3e2f0de176"
+    "c24ec55eabc69a9a5d50cc" },
+  { "RC4, 128-bit key", cryptRC4,
+    "000102030405060708090a0b0c0d0e0f", 12, 0, text, 43,
+    "4b7bb6ceae09e6e8dd5dc7edfc326fa4798daefe25a060f3e6bad7589e1d1649"
+    "60fb63d8746b8242f083ee" },
+};
+
+#define nTestCases ((int)(sizeof(testCases) / sizeof(testCases[0])))
+
+// Streams several times longer than decryptStreamBufSize, so that
+// large reads are decrypted straight into the caller's buffer.  The
+// data is <dataLen> generated bytes (see genByte), then <lastBlock>,
+// then <tailLen> more generated bytes.  For AES, <lastBlock> is
+// encrypted to give valid padding after the generated blocks.  The
+// output is checked against its length and MD5 digest.
+struct DecryptLongTestCase {
+  const char *name;
+  CryptAlgorithm algo;
+  const char *fileKey;		// hex
+  int objNum, objGen;
+  int dataLen;
+  const char *lastBlock;	// hex
+  int tailLen;
+  int plainLen;			// expected output length
+  const char *plainMD5;		// hex
+};
+
+static const DecryptLongTestCase longTestCases[] = {
+  { "AES-128, 10 KB", cryptAES,
+    "000102030405060708090a0b0c0d0e0f", 12, 0,
+    10256, "ec8a415f64794001491db00e1d6292e2", 0,
+    10251, "d8fc32a87b98b03685b274077526a782" },
+  { "AES-128, 10 KB, partial last block", cryptAES,
+    "000102030405060708090a0b0c0d0e0f", 12, 0,
+    10256, "ec8a415f64794001491db00e1d6292e2", 7,
+    10256, "46bca0bdd3fe8afa96a50265da2b8ccf" },
+  { "AES-256, 10 KB", cryptAES256,
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+    12, 0, 10256, "b41cf45ef22e9471b51b0b3bbc202770", 0,
+    10251, "978432593086d607d7f7d18e52768bb9" },
+  { "AES-256, 10 KB, partial last block", cryptAES256,
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+    12, 0, 10256, "b41cf45ef22e9471b51b0b3bbc202770", 7,
+    10256, "836653cb06976f905f2d9e15bceaa3c7" },
+  { "RC4, 10 KB", cryptRC4,
+    "3a7105c29e", 12, 0, 10000, "", 0,
+    10000, "afa32071b6a9e9410ccfa1e0a64a5f58" },
+};
+
+#define nLongTestCases \
+  ((int)(sizeof(longTestCases) / sizeof(longTestCases[0])))
+
+// How the output is read: <first> characters with getChar, then the
+// rest <chunk> bytes at a time with getChars, or a character at a time
+// if <chunk> is zero.
+struct ReadPlan {
+  int first;
+  int chunk;
+};
+
+static const ReadPlan readPlans[] = {
+  { 0, 0 }, { 0, 1 }, { 0, 7 }, { 0, 16 }, { 0, 33 },
+  { 0, decryptStreamBufSize }, { 0, 3 * decryptStreamBufSize },
+  { 5, decryptStreamBufSize }, { 100, decryptStreamBufSize + 1 },
+};
+
+#define nReadPlans ((int)(sizeof(readPlans) / sizeof(readPlans[0])))
+
+static int hexToBytes(const char *hex, char *buf) {
+  int n, c, i;
+
+  for (n = 0; hex[2 * n]; ++n) {
+    c = 0;
+    for (i = 0; i < 2; ++i) {
+      c <<= 4;
+      c |= hex[2 * n + i] <= '9' ? hex[2 * n + i] - '0'
+	                         : hex[2 * n + i] - 'a' + 10;
+    }
+    buf[n] = (char)c;
+  }
+  return n;
+}
+
+static char genByte(int i) {
+  return (char)(i * 167 + (i >> 7));
+}
+
+// Decrypt the <dataLen> bytes at <data> as an object encrypted with
+// <fileKeyHex>, reading the output as <plan> says.  Returns the output
+// in a buffer of <outSize> bytes, which the caller frees, and its
+// length in <outLen>.
+static Guchar *decryptData(CryptAlgorithm algo, const char *fileKeyHex,
+			   int objNum, int objGen, char *data, int dataLen,
+			   const ReadPlan *plan, int outSize, int *outLen) {
+  Guchar fileKey[32];
+  Guchar *out;
+  DecryptStream *str;
+  Object obj;
+  int keyLength, n, m, c;
+
+  keyLength = hexToBytes(fileKeyHex, (char *)fileKey);
+  obj.initNull();
+  str = new DecryptStream(new MemStream(data, 0, dataLen, &obj),
+			  fileKey, algo, keyLength, objNum, objGen);
+  str->reset();
+  out = (Guchar *)gmalloc(outSize);
+  n = 0;
+  while (n < outSize && (plan->chunk == 0 || n < plan->first) &&
+	 (c = str->getChar()) != EOF) {
+    out[n++] = (Guchar)c;
+  }
+  if (plan->chunk > 0) {
+    while (n < outSize &&
+	   (m = str->doGetChars(plan->chunk < outSize - n
+				  ? plan->chunk : outSize - n,
+				out + n)) > 0) {
+      n += m;
+    }
+  }
+  delete str;
+  *outLen = n;
+  return out;
+}
+
+static GBool runCase(const DecryptTestCase *tc, const ReadPlan *plan) {
+  char data[256];
+  Guchar *out;
+  int dataLength, n;
+  GBool ok;
+
+  dataLength = hexToBytes(tc->data, data);
+  out = decryptData(tc->algo, tc->fileKey, tc->objNum, tc->objGen,
+		    data, dataLength, plan, 256, &n);
+  ok = n == tc->plainLen && !memcmp(out, tc->plain, n);
+  gfree(out);
+  return ok;
+}
+
+static GBool runLongCase(const DecryptLongTestCase *tc,
+			 const ReadPlan *plan) {
+  char *data;
+  char md5Hex[33];
+  Guchar digest[16];
+  Guchar *out;
+  int dataLength, n, i;
+
+  data = (char *)gmalloc(tc->dataLen + 16 + tc->tailLen);
+  for (i = 0; i < tc->dataLen; ++i) {
+    data[i] = genByte(i);
+  }
+  dataLength = tc->dataLen + hexToBytes(tc->lastBlock, data + tc->dataLen);
+  for (i = 0; i < tc->tailLen; ++i) {
+    data[dataLength++] = genByte(tc->dataLen + i);
+  }
+  out = decryptData(tc->algo, tc->fileKey, tc->objNum, tc->objGen,
+		    data, dataLength, plan, dataLength + 16, &n);
+  md5(out, n, digest);
+  for (i = 0; i < 16; ++i) {
+    sprintf(md5Hex + 2 * i, "%02x", digest[i]);
+  }
+  gfree(out);
+  gfree(data);
+  return n == tc->plainLen && !strcmp(md5Hex, tc->plainMD5);
+}
+
+static void printFailure(const char *name, const ReadPlan *plan) {
+  if (plan->chunk) {
+    printf("FAILED: %s, getChar %d, then getChars %d\n",
+	   name, plan->first, plan->chunk);
+  } else {
+    printf("FAILED: %s, getChar\n", name);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int nFailed, i, j;
+
+  nFailed = 0;
+  for (i = 0; i < nTestCases; ++i) {
+    for (j = 0; j < nReadPlans; ++j) {
+      if (!runCase(&testCases[i], &readPlans[j])) {
+	printFailure(testCases[i].name, &readPlans[j]);
+	++nFailed;
+      }
+    }
+  }
+  for (i = 0; i < nLongTestCases; ++i) {
+    for (j = 0; j < nReadPlans; ++j) {
+      if (!runLongCase(&longTestCases[i], &readPlans[j])) {
+	printFailure(longTestCases[i].name, &readPlans[j]);
+	++nFailed;
+      }
+    }
+  }
+  printf("%d cases, %d failed\n", nTestCases + nLongTestCases, nFailed);
+  return nFailed ? 1 : 0;
+}
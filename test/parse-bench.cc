@@ -0,0 +1,342 @@
+//========================================================================
+//
+// parse-bench.cc
+//
+// Measures the time and the number of heap allocations needed to
+// open a document and load its first page, to
+// parse every object of a document and to tokenize the content
+// streams of all its pages (with and without an operand arena, and
+// from memory to time the lexer alone) and
+// to interpret them (with and without the form content cache), and
+// the time taken by dictionary lookups on common keys.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "goo/GooString.h"
+#include "goo/GooArena.h"
+#include "GlobalParams.h"
+#include "Error.h"
+#include "Object.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Stream.h"
+#include "Page.h"
+#include "Catalog.h"
+#include "PDFDoc.h"
+#include "XRef.h"
+#include "GfxFormCache.h"
+#include "OutputDev.h"
+
+//------------------------------------------------------------------------
+// allocation counting
+//------------------------------------------------------------------------
+
+static unsigned long nAllocs = 0;
+
+#ifdef __GLIBC__
+
+// count every malloc made by the process, including the ones made
+// by operator new, by interposing the glibc allocator entry points
+
+extern "C" {
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void __libc_free(void *p);
+
+void *malloc(size_t size) {
+  ++nAllocs;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  ++nAllocs;
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *p, size_t size) {
+  if (!p) {
+    ++nAllocs;
+  }
+  return __libc_realloc(p, size);
+}
+
+void free(void *p) {
+  __libc_free(p);
+}
+
+}
+
+#define canCountAllocs gTrue
+#else
+#define canCountAllocs gFalse
+#endif
+
+//------------------------------------------------------------------------
+
+// output device that draws nothing, to measure the interpreter alone
+class NullOutputDev: public OutputDev {
+public:
+
+  virtual GBool upsideDown() { return gTrue; }
+  virtual GBool useDrawChar() { return gFalse; }
+  virtual GBool interpretType3Chars() { return gFalse; }
+};
+
+//------------------------------------------------------------------------
+
+static double getTime() {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void report(const char *what, int count, const char *unit,
+		   unsigned long allocs, double time) {
+  printf("%-18s %9d %-8s", what, count, unit);
+  if (canCountAllocs) {
+    printf(" %10lu allocs (%.2f per %s)", allocs,
+	   count ? (double)allocs / count : 0.0, unit);
+  }
+  printf(" %9.2f ms\n", time);
+}
+
+int main(int argc, char *argv[]) {
+  static const char *keys[] = {
+    "Type", "Subtype", "Filter", "Length", "Resources", "Font", "XObject"
+  };
+  const char *atoms[sizeof(keys) / sizeof(keys[0])];
+  PDFDoc *doc, *doc2;
+  XRef *xref;
+  Object obj, objs[64];
+  Parser *parser;
+  Lexer *lexer;
+  GooArena arena;
+  unsigned long allocs0;
+  Guint formCacheSize;
+  double t0;
+  int repeat, nObjs, nTokens, nLookups, r, i, j, k, pg;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s PDF-FILE [REPEAT]\n", argv[0]);
+    return 1;
+  }
+  repeat = argc > 2 ? atoi(argv[2]) : 5;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+
+  doc = new PDFDoc(new GooString(argv[1]));
+  if (!doc->isOk()) {
+    fprintf(stderr, "Error loading document\n");
+    delete doc;
+    delete globalParams;
+    return 1;
+  }
+  xref = doc->getXRef();
+  for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+    doc->getPage(pg);
+  }
+
+  // open the document again and load its first page
+  allocs0 = nAllocs;
+  t0 = getTime();
+  for (r = 0; r < repeat; ++r) {
+    doc2 = new PDFDoc(new GooString(argv[1]));
+    if (doc2->getNumPages() > 0) {
+      doc2->getPage(1)->getContents(&obj);
+      obj.free();
+    }
+    delete doc2;
+  }
+  report("open", repeat, "docs", nAllocs - allocs0, getTime() - t0);
+
+  // fetch every object
+  allocs0 = nAllocs;
+  t0 = getTime();
+  nObjs = 0;
+  for (r = 0; r < repeat; ++r) {
+    for (i = 0; i < xref->getNumObjects(); ++i) {
+      xref->fetch(i, xref->getEntry(i, gFalse)->gen, &obj);
+      if (!obj.isNull()) {
+	++nObjs;
+      }
+      obj.free();
+    }
+  }
+  report("objects", nObjs, "objects", nAllocs - allocs0, getTime() - t0);
+
+  // tokenize the content streams
+  allocs0 = nAllocs;
+  t0 = getTime();
+  nTokens = 0;
+  for (r = 0; r < repeat; ++r) {
+    for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+      doc->getPage(pg)->getContents(&obj);
+      if (obj.isStream() || obj.isArray()) {
+	parser = new Parser(xref, new Lexer(xref, &obj), gFalse);
+	for (parser->getObj(&objs[0]); !objs[0].isEOF();
+	     parser->getObj(&objs[0])) {
+	  ++nTokens;
+	  objs[0].free();
+	}
+	delete parser;
+      }
+      obj.free();
+    }
+  }
+  report("content streams", nTokens, "tokens", nAllocs - allocs0,
+	 getTime() - t0);
+
+  // same, with the operands allocated from an arena
+  allocs0 = nAllocs;
+  t0 = getTime();
+  nTokens = 0;
+  for (r = 0; r < repeat; ++r) {
+    for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+      doc->getPage(pg)->getContents(&obj);
+      if (obj.isStream() || obj.isArray()) {
+	parser = new Parser(xref, new Lexer(xref, &obj), gFalse);
+	parser->enableArena();
+	for (parser->getObj(&objs[0]); !objs[0].isEOF();
+	     parser->getObj(&objs[0])) {
+	  ++nTokens;
+	  if (objs[0].isCmd()) {
+	    objs[0].free();
+	    parser->resetArena();
+	  } else {
+	    objs[0].free();
+	  }
+	}
+	delete parser;
+      }
+      obj.free();
+    }
+  }
+  report("arena operands", nTokens, "tokens", nAllocs - allocs0,
+	 getTime() - t0);
+
+  // lex the decoded content streams, from memory
+  GooString **contents = new GooString*[doc->getNumPages()];
+  for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+    contents[pg - 1] = new GooString();
+    doc->getPage(pg)->getContents(&obj);
+    for (i = 0; i < (obj.isArray() ? obj.arrayGetLength() : 1); ++i) {
+      if (obj.isArray()) {
+	obj.arrayGet(i, &objs[0]);
+      } else {
+	obj.copy(&objs[0]);
+      }
+      if (objs[0].isStream()) {
+	objs[0].getStream()->fillGooString(contents[pg - 1]);
+	contents[pg - 1]->append('\n');
+      }
+      objs[0].free();
+    }
+    obj.free();
+  }
+  allocs0 = nAllocs;
+  t0 = getTime();
+  nTokens = 0;
+  for (r = 0; r < repeat; ++r) {
+    for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+      obj.initNull();
+      lexer = new Lexer(xref, new MemStream(contents[pg - 1]->getCString(), 0,
+					    contents[pg - 1]->getLength(),
+					    &obj));
+      lexer->setArena(&arena);
+      for (lexer->getObj(&objs[0]); !objs[0].isEOF();
+	   lexer->getObj(&objs[0])) {
+	++nTokens;
+	objs[0].free();
+	arena.reset();
+      }
+      delete lexer;
+    }
+  }
+  report("lexer", nTokens, "tokens", nAllocs - allocs0, getTime() - t0);
+  for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+    delete contents[pg - 1];
+  }
+  delete[] contents;
+
+  // run the content streams through Gfx, without and with the form
+  // content cache
+  NullOutputDev *out = new NullOutputDev();
+  for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+    doc->displayPage(out, pg, 72, 72, 0, gFalse, gTrue, gFalse);
+  }
+  formCacheSize = globalParams->getFormContentCacheSize();
+  for (k = 0; k < 2; ++k) {
+    xref->getFormCache()->setMaxBytes(k ? 1024 * 1024 : 0);
+    allocs0 = nAllocs;
+    t0 = getTime();
+    for (r = 0; r < repeat; ++r) {
+      for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+	doc->displayPage(out, pg, 72, 72, 0, gFalse, gTrue, gFalse);
+      }
+    }
+    report(k ? "interpreter" : "interp, no forms",
+	   repeat * doc->getNumPages(), "pages",
+	   nAllocs - allocs0, getTime() - t0);
+  }
+  xref->getFormCache()->setMaxBytes(formCacheSize);
+  delete out;
+
+  // look up common keys in (up to 64 of) the dictionaries
+  for (i = 0, j = 0; i < xref->getNumObjects() && j < 64; ++i) {
+    xref->fetch(i, xref->getEntry(i, gFalse)->gen, &objs[j]);
+    if (objs[j].isDict()) {
+      ++j;
+    } else {
+      objs[j].free();
+    }
+  }
+  allocs0 = nAllocs;
+  t0 = getTime();
+  nLookups = 0;
+  for (r = 0; r < repeat * 1000; ++r) {
+    for (k = 0; k < j; ++k) {
+      for (i = 0; i < (int)(sizeof(keys) / sizeof(keys[0])); ++i) {
+	objs[k].getDict()->hasKey(keys[i]);
+	++nLookups;
+      }
+    }
+  }
+  report("dict lookups", nLookups, "lookups", nAllocs - allocs0,
+	 getTime() - t0);
+
+  // same lookups, with the keys passed as atoms
+  for (i = 0; i < (int)(sizeof(keys) / sizeof(keys[0])); ++i) {
+    atoms[i] = atomLookup(keys[i]);
+  }
+  allocs0 = nAllocs;
+  t0 = getTime();
+  nLookups = 0;
+  for (r = 0; r < repeat * 1000; ++r) {
+    for (k = 0; k < j; ++k) {
+      for (i = 0; i < (int)(sizeof(keys) / sizeof(keys[0])); ++i) {
+	objs[k].getDict()->hasKey(atoms[i]);
+	++nLookups;
+      }
+    }
+  }
+  report("atom dict lookups", nLookups, "lookups", nAllocs - allocs0,
+	 getTime() - t0);
+  for (k = 0; k < j; ++k) {
+    objs[k].free();
+  }
+
+  delete doc;
+  delete globalParams;
+  return 0;
+}
@@ -0,0 +1,264 @@
+//========================================================================
+//
+// stream-bench.cc
+//
+// Measures the decoding throughput of the streams of a set of
+// documents, for each kind of (outermost) filter, reading both a
+// block and a character at a time, and checks that both ways decode
+// the same data.  Flate streams are also decoded with the zlib based
+// decoder, if poppler was built with zlib, and checked against the
+// output of the built-in decoder.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "Error.h"
+#include "Object.h"
+#include "Stream.h"
+#include "PDFDoc.h"
+#include "XRef.h"
+
+//------------------------------------------------------------------------
+
+#define nStreamKinds (strWeird + 1)
+
+static const char *kindNames[nStreamKinds] = {
+  "File",
+  "CachedFile",
+  "ASCIIHex",
+  "ASCII85",
+  "LZW",
+  "RunLength",
+  "CCITTFax",
+  "DCT",
+  "Flate",
+  "JBIG2",
+  "JPX",
+  "unfiltered"
+};
+
+struct BenchStats {
+  int count;			// number of streams
+  double bytes;			// decoded bytes (one pass)
+  double time[2];		// best times, getChars and getChar, in ms
+  int mismatches;		// streams decoded differently by the two
+  int backendMismatches;	// streams decoded differently by the
+				//   built-in and zlib Flate decoders
+};
+
+static double getTime() {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void report(const char *what, BenchStats *stats) {
+  int k;
+
+  for (k = 0; k < 2; ++k) {
+    printf("%-12s %-8s %6d streams %12.0f bytes %9.2f ms",
+	   what, k == 0 ? "getChars" : "getChar",
+	   stats->count, stats->bytes, stats->time[k]);
+    if (stats->time[k] > 0) {
+      printf(" %9.2f MB/s", stats->bytes / (stats->time[k] * 1000.0));
+    }
+    printf("\n");
+  }
+  if (stats->mismatches) {
+    printf("%-12s %d streams decoded differently by getChars and getChar\n",
+	   what, stats->mismatches);
+  }
+  if (stats->backendMismatches) {
+    printf("%-12s %d streams decoded differently by the built-in decoder\n",
+	   what, stats->backendMismatches);
+  }
+}
+
+// Decode the streams, a block at a time if <bulk> is set, or else a
+// character at a time.  Returns the number of decoded bytes, and sets
+// sums[i] to a checksum of the data of stream i.
+static double decodeAll(Object *objs, int nObjs, GBool bulk,
+			Guint *sums) {
+  Guchar buf[4096];
+  Stream *str;
+  double bytes;
+  Guint sum;
+  int n, c, i, j;
+
+  bytes = 0;
+  for (i = 0; i < nObjs; ++i) {
+    str = objs[i].getStream();
+    str->reset();
+    sum = 0;
+    if (bulk) {
+      while ((n = str->doGetChars(sizeof(buf), buf)) > 0) {
+	for (j = 0; j < n; ++j) {
+	  sum = sum * 31 + buf[j];
+	}
+	bytes += n;
+      }
+    } else {
+      while ((c = str->getChar()) != EOF) {
+	sum = sum * 31 + c;
+	bytes += 1;
+      }
+    }
+    str->close();
+    sums[i] = sum;
+  }
+  return bytes;
+}
+
+// Time the decoding of <objs> (best of <repeat> runs for each access
+// pattern), and add the results to <stats>.  If <refSums> is given,
+// the data is also checked against these checksums of the same
+// streams.  Returns the checksums of the streams, which the caller
+// frees, or NULL if there are none.
+static Guint *bench(Object *objs, int nObjs, int repeat, BenchStats *stats,
+		    Guint *refSums) {
+  Guint *sums[2];
+  double bytes, t0, t, best;
+  int k, r, i;
+
+  if (nObjs == 0) {
+    return NULL;
+  }
+  sums[0] = (Guint *)gmallocn(nObjs, sizeof(Guint));
+  sums[1] = (Guint *)gmallocn(nObjs, sizeof(Guint));
+  bytes = 0;
+  for (k = 0; k < 2; ++k) {
+    best = 0;
+    for (r = 0; r < repeat; ++r) {
+      t0 = getTime();
+      bytes = decodeAll(objs, nObjs, k == 0, sums[k]);
+      t = getTime() - t0;
+      if (r == 0 || t < best) {
+	best = t;
+      }
+    }
+    stats->time[k] += best;
+  }
+  stats->count += nObjs;
+  stats->bytes += bytes;
+  for (i = 0; i < nObjs; ++i) {
+    if (sums[0][i] != sums[1][i]) {
+      ++stats->mismatches;
+    }
+    if (refSums && sums[0][i] != refSums[i]) {
+      ++stats->backendMismatches;
+    }
+  }
+  gfree(sums[1]);
+  return sums[0];
+}
+
+// Fetch the streams of <xref> whose outermost filter is <kind>.
+static int fetchStreams(XRef *xref, int kind, Object *objs) {
+  Object obj;
+  int nObjs, i;
+
+  nObjs = 0;
+  for (i = 0; i < xref->getNumObjects(); ++i) {
+    xref->fetch(i, xref->getEntry(i, gFalse)->gen, &obj);
+    if (obj.isStream() && obj.getStream()->getKind() == kind) {
+      objs[nObjs++] = obj;
+    } else {
+      obj.free();
+    }
+  }
+  return nObjs;
+}
+
+static void freeStreams(Object *objs, int nObjs) {
+  int i;
+
+  for (i = 0; i < nObjs; ++i) {
+    objs[i].free();
+  }
+}
+
+int main(int argc, char *argv[]) {
+  BenchStats stats[nStreamKinds], zlibStats;
+  PDFDoc *doc;
+  XRef *xref;
+  Object *objs;
+  Guint *sums, *flateSums;
+  int repeat, firstFile, nObjs, kind, f;
+
+  repeat = 5;
+  firstFile = 1;
+  if (argc > 2 && !strcmp(argv[1], "-r")) {
+    repeat = atoi(argv[2]);
+    firstFile = 3;
+  }
+  if (firstFile >= argc || repeat < 1) {
+    fprintf(stderr, "usage: %s [-r REPEAT] PDF-FILE...\n", argv[0]);
+    return 1;
+  }
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+
+  memset(stats, 0, sizeof(stats));
+  memset(&zlibStats, 0, sizeof(zlibStats));
+  for (f = firstFile; f < argc; ++f) {
+    doc = new PDFDoc(new GooString(argv[f]));
+    if (!doc->isOk()) {
+      fprintf(stderr, "Error loading document %s\n", argv[f]);
+      delete doc;
+      continue;
+    }
+    xref = doc->getXRef();
+    objs = new Object[xref->getNumObjects()];
+
+    // the Flate decoder is picked when a stream object is fetched, so
+    // the streams are fetched again for each kind
+    globalParams->setFlateUseZlib(gFalse);
+    flateSums = NULL;
+    for (kind = 0; kind < nStreamKinds; ++kind) {
+      nObjs = fetchStreams(xref, kind, objs);
+      sums = bench(objs, nObjs, repeat, &stats[kind], NULL);
+      freeStreams(objs, nObjs);
+      if (kind == strFlate) {
+	flateSums = sums;
+      } else {
+	gfree(sums);
+      }
+    }
+#ifdef ENABLE_ZLIB
+    // the same streams are fetched, in the same order, so they can be
+    // checked against the output of the built-in decoder
+    globalParams->setFlateUseZlib(gTrue);
+    nObjs = fetchStreams(xref, strFlate, objs);
+    gfree(bench(objs, nObjs, repeat, &zlibStats, flateSums));
+    freeStreams(objs, nObjs);
+#endif
+    gfree(flateSums);
+
+    delete[] objs;
+    delete doc;
+  }
+
+  for (kind = 0; kind < nStreamKinds; ++kind) {
+    if (stats[kind].count) {
+      report(kindNames[kind], &stats[kind]);
+    }
+  }
+  if (zlibStats.count) {
+    report("Flate(zlib)", &zlibStats);
+  }
+
+  delete globalParams;
+  return zlibStats.backendMismatches ? 1 : 0;
+}
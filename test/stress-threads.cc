@@ -0,0 +1,175 @@
+//========================================================================
+//
+// stress-threads.cc
+//
+// Renders the pages of one PDFDoc from several threads at the same
+// time and checks that every page comes out identical to a serial
+// render of the same document.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "Error.h"
+#include "PDFDoc.h"
+#include "ImageCache.h"
+#include "GfxFormCache.h"
+#include "SplashOutputDev.h"
+#include "splash/SplashBitmap.h"
+#include "splash/SplashTypes.h"
+
+struct RenderJob {
+  PDFDoc *doc;
+  double resolution;
+  int firstPage;		// first page rendered by this job
+  int pageStep;			// distance between the pages of this job
+  int iterations;		// number of passes over the pages
+  Guint *sums;			// checksum of each page (index = page - 1)
+  int mismatches;		// pages that differ from a previous pass
+};
+
+static Guint checksumBitmap(SplashBitmap *bitmap) {
+  SplashColorPtr p;
+  Guint sum;
+  int y, x, n;
+
+  // FNV-1a over the rows, skipping any row padding
+  sum = 2166136261U;
+  n = bitmap->getWidth() * 3;
+  for (y = 0; y < bitmap->getHeight(); ++y) {
+    p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    for (x = 0; x < n; ++x) {
+      sum = (sum ^ p[x]) * 16777619U;
+    }
+  }
+  return sum;
+}
+
+static void *renderPages(void *data) {
+  RenderJob *job = (RenderJob *)data;
+  SplashOutputDev *out;
+  SplashColor paperColor;
+  Guint sum;
+  int iter, pg;
+
+  paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+  out = new SplashOutputDev(splashModeRGB8, 4, gFalse, paperColor);
+  out->startDoc(job->doc);
+  for (iter = 0; iter < job->iterations; ++iter) {
+    for (pg = job->firstPage; pg <= job->doc->getNumPages();
+	 pg += job->pageStep) {
+      job->doc->displayPage(out, pg, job->resolution, job->resolution,
+			    0, gFalse, gTrue, gFalse);
+      sum = checksumBitmap(out->getBitmap());
+      if (iter == 0) {
+	job->sums[pg - 1] = sum;
+      } else if (job->sums[pg - 1] != sum) {
+	++job->mismatches;
+      }
+    }
+  }
+  delete out;
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  PDFDoc *doc;
+  RenderJob serialJob, *jobs;
+  pthread_t *threads;
+  Guint *serialSums, *threadSums;
+  Guint hits, misses, cacheBytes, imageHits, imageBytes;
+  Guint formHits, formBytes;
+  int nThreads, iterations, nPages, failed, i;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s PDF-FILE [THREADS [ITERATIONS]]\n", argv[0]);
+    return 1;
+  }
+  nThreads = argc > 2 ? atoi(argv[2]) : 4;
+  iterations = argc > 3 ? atoi(argv[3]) : 2;
+  if (nThreads < 1 || iterations < 1) {
+    fprintf(stderr, "THREADS and ITERATIONS must be positive\n");
+    return 1;
+  }
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+
+  doc = new PDFDoc(new GooString(argv[1]));
+  if (!doc->isOk()) {
+    fprintf(stderr, "Error loading document\n");
+    delete doc;
+    delete globalParams;
+    return 1;
+  }
+  nPages = doc->getNumPages();
+
+  // reference pass, from a separate document so that the threaded
+  // pass starts with cold caches, and without the image cache
+  PDFDoc *refDoc = new PDFDoc(new GooString(argv[1]));
+  refDoc->getXRef()->getImageCache()->setMaxBytes(0);
+  serialSums = (Guint *)gmallocn(nPages, sizeof(Guint));
+  serialJob.doc = refDoc;
+  serialJob.resolution = 36;
+  serialJob.firstPage = 1;
+  serialJob.pageStep = 1;
+  serialJob.iterations = 1;
+  serialJob.sums = serialSums;
+  serialJob.mismatches = 0;
+  renderPages(&serialJob);
+  delete refDoc;
+
+  // threaded pass: thread i renders pages i+1, i+1+nThreads, ...
+  // with the parsed-object, image and form caches shared between the
+  // threads
+  doc->getXRef()->setObjectCacheSize(1024 * 1024);
+  doc->getXRef()->getFormCache()->setMaxBytes(1024 * 1024);
+  threadSums = (Guint *)gmallocn(nPages, sizeof(Guint));
+  jobs = new RenderJob[nThreads];
+  threads = new pthread_t[nThreads];
+  for (i = 0; i < nThreads; ++i) {
+    jobs[i].doc = doc;
+    jobs[i].resolution = 36;
+    jobs[i].firstPage = i + 1;
+    jobs[i].pageStep = nThreads;
+    jobs[i].iterations = iterations;
+    jobs[i].sums = threadSums;
+    jobs[i].mismatches = 0;
+    pthread_create(&threads[i], NULL, &renderPages, &jobs[i]);
+  }
+  failed = 0;
+  for (i = 0; i < nThreads; ++i) {
+    pthread_join(threads[i], NULL);
+    failed += jobs[i].mismatches;
+  }
+
+  for (i = 0; i < nPages; ++i) {
+    if (threadSums[i] != serialSums[i]) {
+      fprintf(stderr, "page %d differs from the serial render\n", i + 1);
+      ++failed;
+    }
+  }
+  doc->getXRef()->getObjectCacheStats(&hits, &misses, &cacheBytes);
+  doc->getXRef()->getImageCache()->getStats(&imageHits, &imageBytes);
+  doc->getXRef()->getFormCache()->getStats(&formHits, &formBytes);
+  printf("%d pages, %d threads, %d iterations, object cache %u hits %u misses, image cache %u hits, form cache %u hits: %s\n",
+	 nPages, nThreads, iterations, hits, misses, imageHits, formHits,
+	 failed ? "FAILED" : "ok");
+
+  delete[] threads;
+  delete[] jobs;
+  gfree(threadSums);
+  gfree(serialSums);
+  delete doc;
+  delete globalParams;
+  return failed ? 1 : 0;
+}